@@ -0,0 +1,343 @@
+#include "inventory.h"
+
+// ---------------- Benchmarks ----------------
+// Times the core operations against synthetic catalogs of growing size and
+// prints one CSV row per (operation, size), so runs from different releases
+// can be diffed or plotted. Everything runs inside a scratch directory
+// (the store files use fixed names), and each size starts from a freshly
+// generated catalog written through journalCheckpoint.
+//
+// Columns: op, products, rounds, ops per round, best and median round time
+// in ms, and ns per op for the best round.
+
+#define BENCH_DIR "bench_data"
+#define BENCH_MAX_ROUNDS 15
+#define BENCH_LOOKUPS 200000        // searchProduct calls per round
+#define BENCH_TXNS 20000            // processSale / processPurchase calls per round
+#define BENCH_LOG_LINES 20000       // logActivity calls per round
+#define BENCH_DELETES 10000         // deleteProduct calls (at most a tenth of the catalog)
+
+const long long benchSizes[] = { 100, 1000, 10000, 100000, 1000000, 10000000 };
+
+unsigned long long benchRng = 0x9E3779B97F4A7C15ULL;
+
+Inventory* store = NULL;     // Lives in the scratch directory
+
+unsigned int benchRandom() {
+    benchRng ^= benchRng << 13;
+    benchRng ^= benchRng >> 7;
+    benchRng ^= benchRng << 17;
+    return (unsigned int)(benchRng >> 32);
+}
+
+// Fills the store with `count` products: ids 1..count, names built from a
+// small vocabulary (so searches have realistic hit rates), random stock,
+// prices and types. Same seed, same catalog.
+int benchGenerate(int count, unsigned long long seed) {
+    static const char* materials[] = { "Steel", "Copper", "Aluminium", "Brass", "Nylon", "Rubber", "Carbon", "Glass" };
+    static const char* parts[] = { "Bolt", "Gear", "Valve", "Panel", "Bearing", "Shaft", "Bracket", "Housing", "Spring", "Washer" };
+
+    benchRng = seed | 1;
+    releaseInventory(store);
+    store->productCount = 0;
+    if (!reserveInventory(store, count)) return 0;
+    rebuildIndex(store, 0);
+    for (int i = 0; i < count; i++) {
+        Product p;
+        memset(&p, 0, sizeof(p));
+        p.id = i + 1;
+        snprintf(p.name, sizeof(p.name), "%s %s %d",
+                 materials[benchRandom() % 8], parts[benchRandom() % 10], (int)(benchRandom() % 1000));
+        p.quantity = (int)(benchRandom() % 1000);
+        p.price = (float)(benchRandom() % 50000) / 100.0f + 0.5f;
+        p.type = benchRandom() % 3 == 0 ? FINISHED_GOOD : RAW_MATERIAL;
+        p.reorderLevel = LOW_STOCK_THRESHOLD;
+        if (storeAppend(store, &p) < 0) return 0;
+    }
+    alertRebuild(store);
+    statsRebuild(store);
+    return 1;
+}
+
+int doubleCompare(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+void benchReport(const char* op, int products, double* roundMs, int rounds, long long opsPerRound) {
+    qsort(roundMs, (size_t)rounds, sizeof(double), doubleCompare);
+    double best = roundMs[0];
+    double median = roundMs[rounds / 2];
+    printf("%s,%d,%d,%lld,%.3f,%.3f,%.1f\n", op, products, rounds, opsPerRound,
+           best, median, best * 1e6 / (double)(opsPerRound > 0 ? opsPerRound : 1));
+    fflush(stdout);
+}
+
+// Fewer rounds for the operations that touch the whole catalog.
+int benchRounds(int requested, int products) {
+    int rounds = requested;
+    if (products >= 1000000 && rounds > 3) rounds = 3;
+    return rounds;
+}
+
+volatile long long benchSink;   // Keeps lookups from being optimized away
+
+// The Product Columns scans done directly on the store, for comparison.
+int aosLowStock(int* out) {
+    int found = 0;
+    for (int i = 0; i < store->productCount; i++) {
+        if (store->products[i].quantity < store->products[i].reorderLevel) out[found++] = i;
+    }
+    return found;
+}
+
+void aosQtySumMax(long long* sum, int* max) {
+    long long total = 0;
+    int best = store->productCount > 0 ? store->products[0].quantity : 0;
+    for (int i = 0; i < store->productCount; i++) {
+        total += store->products[i].quantity;
+        if (store->products[i].quantity > best) best = store->products[i].quantity;
+    }
+    *sum = total;
+    *max = best;
+}
+
+void aosValuation(long long units[2], long long valueCents[2]) {
+    units[0] = units[1] = valueCents[0] = valueCents[1] = 0;
+    for (int i = 0; i < store->productCount; i++) {
+        const Product* p = &store->products[i];
+        int t = p->type == RAW_MATERIAL ? 0 : 1;
+        units[t] += p->quantity;
+        valueCents[t] += (long long)p->quantity * (long long)(p->price * 100.0f + (p->price < 0 ? -0.5f : 0.5f));
+    }
+}
+
+// Each scan over the store layout and over its columnar copy; the results
+// must agree.
+void benchScans(int count, int rounds) {
+    double ms[BENCH_MAX_ROUNDS];
+    ProductColumns cols;
+    double start = nowMs();
+    int built = columnsBuild(store, &cols);
+    ms[0] = nowMs() - start;
+    int* hits = malloc(((size_t)count + 1) * sizeof(int));
+    if (!built || hits == NULL) {
+        fprintf(stderr, "out of memory building columns at %d products\n", count);
+        columnsFree(&cols);
+        free(hits);
+        return;
+    }
+    benchReport("columnsBuild", count, ms, 1, count);
+
+    int lowA = 0, lowB = 0;
+    for (int r = 0; r < rounds; r++) {
+        start = nowMs();
+        lowA = aosLowStock(hits);
+        ms[r] = nowMs() - start;
+    }
+    benchReport("lowStockScan_rows", count, ms, rounds, count);
+    for (int r = 0; r < rounds; r++) {
+        start = nowMs();
+        lowB = columnsLowStock(&cols, hits);
+        ms[r] = nowMs() - start;
+    }
+    benchReport("lowStockScan_columns", count, ms, rounds, count);
+
+    long long sumA = 0, sumB = 0;
+    int maxA = 0, maxB = 0;
+    for (int r = 0; r < rounds; r++) {
+        start = nowMs();
+        aosQtySumMax(&sumA, &maxA);
+        ms[r] = nowMs() - start;
+    }
+    benchReport("qtySumMax_rows", count, ms, rounds, count);
+    for (int r = 0; r < rounds; r++) {
+        start = nowMs();
+        columnsQtySumMax(&cols, &sumB, &maxB);
+        ms[r] = nowMs() - start;
+    }
+    benchReport("qtySumMax_columns", count, ms, rounds, count);
+
+    long long unitsA[2], valueA[2], unitsB[2], valueB[2];
+    for (int r = 0; r < rounds; r++) {
+        start = nowMs();
+        aosValuation(unitsA, valueA);
+        ms[r] = nowMs() - start;
+    }
+    benchReport("valuation_rows", count, ms, rounds, count);
+    for (int r = 0; r < rounds; r++) {
+        start = nowMs();
+        columnsValuation(&cols, unitsB, valueB);
+        ms[r] = nowMs() - start;
+    }
+    benchReport("valuation_columns", count, ms, rounds, count);
+
+    if (lowA != lowB || sumA != sumB || maxA != maxB || memcmp(unitsA, unitsB, sizeof(unitsA)) != 0 ||
+        memcmp(valueA, valueB, sizeof(valueA)) != 0) {
+        fprintf(stderr, "column scans disagree with the store at %d products!\n", count);
+    }
+    benchSink = lowB + sumB + maxB;
+    columnsFree(&cols);
+    free(hits);
+}
+
+void benchSize(int count, int requestedRounds) {
+    double ms[BENCH_MAX_ROUNDS];
+    int rounds = benchRounds(requestedRounds, count);
+
+    fprintf(stderr, "generating %d products\n", count);
+    if (!benchGenerate(count, 12345 + (unsigned long long)count)) {
+        fprintf(stderr, "out of memory at %d products\n", count);
+        return;
+    }
+    journalCheckpoint(store);
+
+    for (int r = 0; r < rounds; r++) {
+        double start = nowMs();
+        saveInventory(store);
+        ms[r] = nowMs() - start;
+    }
+    benchReport("saveInventory", count, ms, rounds, count);
+
+    for (int r = 0; r < rounds; r++) {
+        double start = nowMs();
+        loadInventory(store);
+        ms[r] = nowMs() - start;
+    }
+    benchReport("loadInventory", count, ms, rounds, count);
+
+    for (int r = 0; r < requestedRounds; r++) {
+        long long found = 0;
+        double start = nowMs();
+        for (int i = 0; i < BENCH_LOOKUPS; i++) {
+            // A quarter of the lookups miss
+            int id = (int)(benchRandom() % (unsigned int)(count + count / 4)) + 1;
+            found += searchProduct(store, id) != NULL;
+        }
+        ms[r] = nowMs() - start;
+        benchSink = found;
+    }
+    benchReport("searchProduct", count, ms, requestedRounds, BENCH_LOOKUPS);
+
+    for (int r = 0; r < requestedRounds; r++) {
+        double start = nowMs();
+        for (int i = 0; i < BENCH_TXNS; i++) {
+            processPurchase(store, (int)(benchRandom() % (unsigned int)count) + 1, 5);
+        }
+        ms[r] = nowMs() - start;
+    }
+    benchReport("processPurchase", count, ms, requestedRounds, BENCH_TXNS);
+
+    for (int r = 0; r < requestedRounds; r++) {
+        double start = nowMs();
+        for (int i = 0; i < BENCH_TXNS; i++) {
+            processSale(store, (int)(benchRandom() % (unsigned int)count) + 1, 5);
+        }
+        ms[r] = nowMs() - start;
+    }
+    benchReport("processSale", count, ms, requestedRounds, BENCH_TXNS);
+
+    // Includes the flush, so the cost of getting lines to disk is counted
+    for (int r = 0; r < requestedRounds; r++) {
+        double start = nowMs();
+        for (int i = 0; i < BENCH_LOG_LINES; i++) logActivity(store, "Benchmark activity line");
+        loggerFlush(store);
+        ms[r] = nowMs() - start;
+    }
+    benchReport("logActivity", count, ms, requestedRounds, BENCH_LOG_LINES);
+
+    for (int r = 0; r < rounds; r++) {
+        double start = nowMs();
+        exportToCSV(store);
+        ms[r] = nowMs() - start;
+    }
+    benchReport("exportToCSV", count, ms, rounds, count);
+
+    benchScans(count, requestedRounds);
+
+    // Single round: deletes can't be repeated on the same ids
+    int deletes = count / 10 < BENCH_DELETES ? count / 10 : BENCH_DELETES;
+    if (deletes > 0) {
+        double start = nowMs();
+        for (int i = 0; i < deletes; i++) {
+            // Stride through the id space so every delete hits a live product
+            int id = (int)((long long)i * count / deletes) + 1;
+            deleteProduct(store, id);
+        }
+        ms[0] = nowMs() - start;
+        benchReport("deleteProduct", count, ms, 1, deletes);
+    }
+    journalCommit(store);
+}
+
+// --generate: writes a synthetic catalog as CSV (for --import-csv or other tools).
+int benchGenerateCsv(int count, const char* path) {
+    loggerConfig.enabled = 0;
+    store = inventoryCreate(NULL);
+    if (store == NULL) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    if (!benchGenerate(count, 12345 + (unsigned long long)count)) {
+        printf("Out of memory generating %d products\n", count);
+        return 1;
+    }
+    if (exportCSV(store, path, NULL) < 0) {
+        printf("Error writing %s\n", path);
+        return 1;
+    }
+    fprintf(stderr, "%d products written to %s\n", count, path);
+    return 0;
+}
+
+void printBenchUsage(const char* prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  --max N          Largest catalog size to run (default 10000000)\n");
+    printf("  --rounds N       Timed rounds per operation (default 5, max %d)\n", BENCH_MAX_ROUNDS);
+    printf("  --dir PATH       Scratch directory for the store files (default %s)\n", BENCH_DIR);
+    printf("  --generate N [file]  Only write N synthetic products as CSV (default %s, - = stdout)\n", CSVIMPORTFILE);
+    printf("Results go to stdout as CSV, progress to stderr.\n");
+}
+
+int main(int argc, char** argv) {
+    long long maxSize = 10000000;
+    int rounds = 5;
+    const char* dir = BENCH_DIR;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--max") == 0 && i + 1 < argc) maxSize = atoll(argv[++i]);
+        else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) rounds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) dir = argv[++i];
+        else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc) {
+            return benchGenerateCsv(atoi(argv[i + 1]), i + 2 < argc ? argv[i + 2] : CSVIMPORTFILE);
+        } else {
+            printBenchUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (rounds < 1) rounds = 1;
+    if (rounds > BENCH_MAX_ROUNDS) rounds = BENCH_MAX_ROUNDS;
+
+    makeDir(dir);
+    if (chdir(dir) != 0) {
+        printf("Error entering %s\n", dir);
+        return 1;
+    }
+    store = inventoryCreate(NULL);
+    if (store == NULL) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    strcpy(currentUser.username, "bench");
+    currentUser.role = ADMIN;
+    loggerStart(store);
+
+    printf("op,products,rounds,ops_per_round,best_ms,median_ms,ns_per_op\n");
+    for (size_t i = 0; i < sizeof(benchSizes) / sizeof(benchSizes[0]); i++) {
+        if (benchSizes[i] > maxSize) break;
+        benchSize((int)benchSizes[i], rounds);
+    }
+
+    inventoryDestroy(store);
+    return 0;
+}
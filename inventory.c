@@ -0,0 +1,5694 @@
+#include "inventory.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>     // __rdtsc
+#endif
+
+// Global Variables (everything per inventory lives in Inventory, see inventory.h)
+_Thread_local User currentUser;   // Per thread: each operator/worker thread acts as its own user
+int isLoggedIn = 0;
+
+// Hardcoded Users
+User users[] = {
+    {"admin", "admin123", ADMIN},
+    {"staff", "staff123", STAFF}
+};
+int userCount = 2;
+
+// ---------------- Product Store & Index ----------------
+// Products live in a growable array. An open-addressing hash table
+// (linear probing, power-of-two size) maps Product.id -> array position
+// so lookups don't have to walk the whole catalog. The same IdMap is
+// reused by other id-keyed indexes (e.g. the low-stock alert heap).
+
+unsigned int hashId(int id) {
+    unsigned int h = (unsigned int)id;
+    h ^= h >> 16;
+    h *= 0x7feb352dU;
+    h ^= h >> 15;
+    h *= 0x846ca68bU;
+    h ^= h >> 16;
+    return h;
+}
+
+// Empties the map, sized so `expected` entries keep it at most half full.
+int idMapClear(IdMap* m, int expected) {
+    int newCap = 16;
+    while (newCap < (expected + 1) * 2) newCap *= 2;
+
+    if (newCap != m->capacity) {
+        IndexSlot* table = realloc(m->slots, (size_t)newCap * sizeof(IndexSlot));
+        if (table == NULL) {
+            printf("Out of memory growing index!\n");
+            return 0;
+        }
+        m->slots = table;
+        m->capacity = newCap;
+    }
+    for (int i = 0; i < m->capacity; i++) m->slots[i].pos = INDEX_EMPTY;
+    m->used = 0;
+    return 1;
+}
+
+// Returns the slot holding `id`, or -1 if it is not in the map.
+int idMapFindSlot(const IdMap* m, int id) {
+    if (m->capacity == 0) return -1;
+
+    unsigned int mask = (unsigned int)m->capacity - 1;
+    unsigned int slot = hashId(id) & mask;
+    while (m->slots[slot].pos != INDEX_EMPTY) {
+        if (m->slots[slot].pos != INDEX_DELETED && m->slots[slot].id == id) return (int)slot;
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+int idMapGet(const IdMap* m, int id) {
+    int slot = idMapFindSlot(m, id);
+    return slot < 0 ? -1 : m->slots[slot].pos;
+}
+
+// Inserts `id` (which must not be present) without any resize check.
+void idMapInsertRaw(IdMap* m, int id, int value) {
+    unsigned int mask = (unsigned int)m->capacity - 1;
+    unsigned int slot = hashId(id) & mask;
+    while (m->slots[slot].pos >= 0) slot = (slot + 1) & mask;
+    if (m->slots[slot].pos == INDEX_EMPTY) m->used++;
+    m->slots[slot].id = id;
+    m->slots[slot].pos = value;
+}
+
+// Inserts or overwrites id -> value.
+void idMapPut(IdMap* m, int id, int value) {
+    int slot = idMapFindSlot(m, id);
+    if (slot >= 0) {
+        m->slots[slot].pos = value;
+        return;
+    }
+
+    // Keep load (including tombstones) under 50%; rehashing also purges tombstones.
+    if ((m->used + 1) * 2 > m->capacity) {
+        IndexSlot* old = m->slots;
+        int oldCap = m->capacity;
+        int live = 0;
+        for (int i = 0; i < oldCap; i++) if (old[i].pos >= 0) live++;
+
+        m->slots = NULL;
+        m->capacity = 0;
+        if (!idMapClear(m, live + 1)) {
+            m->slots = old;
+            m->capacity = oldCap;
+            return;
+        }
+        for (int i = 0; i < oldCap; i++) {
+            if (old[i].pos >= 0) idMapInsertRaw(m, old[i].id, old[i].pos);
+        }
+        free(old);
+    }
+    idMapInsertRaw(m, id, value);
+}
+
+void idMapRemove(IdMap* m, int id) {
+    int slot = idMapFindSlot(m, id);
+    if (slot >= 0) m->slots[slot].pos = INDEX_DELETED;
+}
+
+// Display order: products keep the order they were added in (exports and
+// snapshots use it) even though a delete moves the last product into the
+// hole. orderPos lists array positions in that order, -1 marking deleted
+// products, and slotOrder maps a position back to its orderPos entry.
+// Tombstones are squeezed out once they outnumber live products, and
+// inventoryNormalize puts the array itself back in order before a save.
+
+// Display order = array order for the first `count` products.
+void orderReset(Inventory* inv, int count) {
+    int cap = count > inv->inventoryCapacity ? count : inv->inventoryCapacity;
+    if (cap < 1) cap = 1;
+    int* positions = realloc(inv->orderPos, (size_t)cap * sizeof(int));
+    int* slots = positions != NULL ? realloc(inv->slotOrder, (size_t)cap * sizeof(int)) : NULL;
+    if (positions != NULL) inv->orderPos = positions;
+    if (slots == NULL) {
+        printf("Out of memory building display order!\n");
+        return;
+    }
+    inv->slotOrder = slots;
+    inv->orderCapacity = cap;
+    for (int i = 0; i < count; i++) inv->orderPos[i] = inv->slotOrder[i] = i;
+    inv->orderLen = count;
+    inv->orderShuffled = 0;
+}
+
+void orderCompact(Inventory* inv) {
+    int out = 0;
+    for (int k = 0; k < inv->orderLen; k++) {
+        int pos = inv->orderPos[k];
+        if (pos < 0) continue;
+        inv->orderPos[out] = pos;
+        inv->slotOrder[pos] = out++;
+    }
+    inv->orderLen = out;
+}
+
+// Drops the current store, whether heap-allocated or mapped.
+void releaseInventory(Inventory* inv) {
+#ifndef _WIN32
+    if (inv->inventoryMapBase != NULL) {
+        munmap(inv->inventoryMapBase, inv->inventoryMapLen);
+        inv->inventoryMapBase = NULL;
+        inv->inventoryMapLen = 0;
+        inv->products = NULL;
+    }
+#endif
+    free(inv->products);
+    inv->products = NULL;
+    inv->inventoryCapacity = 0;
+    inv->productCount = 0;
+}
+
+// Grows the product array so it can hold at least `needed` products.
+// A mapped snapshot is copied to the heap the first time it has to grow.
+int reserveInventory(Inventory* inv, int needed) {
+    if (needed <= inv->inventoryCapacity) return 1;
+
+    int newCap = inv->inventoryCapacity > 0 ? inv->inventoryCapacity : INITIAL_CAPACITY;
+    while (newCap < needed) newCap *= 2;
+
+    Product* grown;
+    if (inv->inventoryMapBase != NULL) {
+        grown = malloc((size_t)newCap * sizeof(Product));
+        if (grown != NULL) {
+            memcpy(grown, inv->products, (size_t)inv->productCount * sizeof(Product));
+#ifndef _WIN32
+            munmap(inv->inventoryMapBase, inv->inventoryMapLen);
+#endif
+            inv->inventoryMapBase = NULL;
+            inv->inventoryMapLen = 0;
+        }
+    } else {
+        grown = realloc(inv->products, (size_t)newCap * sizeof(Product));
+    }
+    int* grownOrder = grown != NULL ? realloc(inv->slotOrder, (size_t)newCap * sizeof(int)) : NULL;
+    if (grown == NULL || grownOrder == NULL) {
+        if (grown != NULL) inv->products = grown;
+        printf("Out of memory growing inventory!\n");
+        return 0;
+    }
+    inv->products = grown;
+    inv->slotOrder = grownOrder;
+    inv->inventoryCapacity = newCap;
+    return 1;
+}
+
+// Rebuilds the product index from scratch for the first `count` products,
+// and takes their array order as the display order.
+void rebuildIndex(Inventory* inv, int count) {
+    orderReset(inv, count);
+    if (!idMapClear(&inv->productIndex, count)) return;
+    for (int i = 0; i < count; i++) idMapInsertRaw(&inv->productIndex, inv->products[i].id, i);
+}
+
+int indexFind(Inventory* inv, int id) {
+    return idMapGet(&inv->productIndex, id);
+}
+
+void indexInsert(Inventory* inv, int id, int pos) {
+    idMapPut(&inv->productIndex, id, pos);
+}
+
+void indexRemove(Inventory* inv, int id) {
+    idMapRemove(&inv->productIndex, id);
+}
+
+void indexSetPos(Inventory* inv, int id, int pos) {
+    idMapPut(&inv->productIndex, id, pos);
+}
+
+// Appends a product (whose id must be new) at the end of the array and of
+// the display order. Returns its position, or -1 if out of memory.
+int storeAppend(Inventory* inv, const Product* p) {
+    if (!reserveInventory(inv, inv->productCount + 1)) return -1;
+    if (inv->orderLen == inv->orderCapacity) {
+        orderCompact(inv);
+        if (inv->orderLen == inv->orderCapacity) {
+            int newCap = inv->orderCapacity > 0 ? inv->orderCapacity * 2 : INITIAL_CAPACITY;
+            int* grown = realloc(inv->orderPos, (size_t)newCap * sizeof(int));
+            if (grown == NULL) return -1;
+            inv->orderPos = grown;
+            inv->orderCapacity = newCap;
+        }
+    }
+    int pos = inv->productCount++;
+    inv->products[pos] = *p;
+    indexInsert(inv, p->id, pos);
+    inv->orderPos[inv->orderLen] = pos;
+    inv->slotOrder[pos] = inv->orderLen++;
+    return pos;
+}
+
+// Removes the product at `pos` in O(1): the last product moves into its
+// slot and the display order keeps a tombstone.
+void storeRemoveAt(Inventory* inv, int pos) {
+    int last = inv->productCount - 1;
+    indexRemove(inv, inv->products[pos].id);
+    inv->orderPos[inv->slotOrder[pos]] = -1;
+    if (pos != last) {
+        inv->products[pos] = inv->products[last];
+        inv->slotOrder[pos] = inv->slotOrder[last];
+        inv->orderPos[inv->slotOrder[pos]] = pos;
+        indexSetPos(inv, inv->products[pos].id, pos);
+        inv->orderShuffled = 1;
+    }
+    inv->productCount--;
+    if (inv->orderLen - inv->productCount > inv->productCount + 64) orderCompact(inv);
+}
+
+// Rewrites the array in display order (before it is saved). Callers need
+// the store to themselves.
+int inventoryNormalize(Inventory* inv) {
+    if (!inv->orderShuffled) {
+        orderCompact(inv);
+        return 1;
+    }
+    Product* ordered = malloc((size_t)(inv->inventoryCapacity > 0 ? inv->inventoryCapacity : 1) * sizeof(Product));
+    if (ordered == NULL) return 0;
+    int n = 0;
+    for (int k = 0; k < inv->orderLen; k++) {
+        if (inv->orderPos[k] >= 0) ordered[n++] = inv->products[inv->orderPos[k]];
+    }
+    int count = inv->productCount, capacity = inv->inventoryCapacity;
+    releaseInventory(inv);
+    inv->products = ordered;
+    inv->inventoryCapacity = capacity;
+    inv->productCount = count;
+    rebuildIndex(inv, inv->productCount);
+    return 1;
+}
+
+// ---------------- Low Stock Alerts ----------------
+// Products below their reorder level are kept in a binary min-heap ordered
+// by how close they are to running out (quantity / reorderLevel, then
+// quantity, then id), with an IdMap from product id to heap slot. The
+// mutation functions keep it current, so the main menu only pays for the
+// alerts it actually shows (alertTop) instead of scanning the catalog.
+
+// Is a more critical than b?
+int alertLess(const AlertEntry* a, const AlertEntry* b) {
+    long long lhs = (long long)a->quantity * b->reorderLevel;
+    long long rhs = (long long)b->quantity * a->reorderLevel;
+    if (lhs != rhs) return lhs < rhs;
+    if (a->quantity != b->quantity) return a->quantity < b->quantity;
+    return a->id < b->id;
+}
+
+void alertPlace(Inventory* inv, int i, AlertEntry e) {
+    inv->alertHeap[i] = e;
+    idMapPut(&inv->alertSlots, e.id, i);
+}
+
+void alertSiftUp(Inventory* inv, int i) {
+    AlertEntry e = inv->alertHeap[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!alertLess(&e, &inv->alertHeap[parent])) break;
+        alertPlace(inv, i, inv->alertHeap[parent]);
+        i = parent;
+    }
+    alertPlace(inv, i, e);
+}
+
+void alertSiftDown(Inventory* inv, int i) {
+    AlertEntry e = inv->alertHeap[i];
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= inv->alertSize) break;
+        if (child + 1 < inv->alertSize && alertLess(&inv->alertHeap[child + 1], &inv->alertHeap[child])) child++;
+        if (!alertLess(&inv->alertHeap[child], &e)) break;
+        alertPlace(inv, i, inv->alertHeap[child]);
+        i = child;
+    }
+    alertPlace(inv, i, e);
+}
+
+void alertRemoveAt(Inventory* inv, int i) {
+    idMapRemove(&inv->alertSlots, inv->alertHeap[i].id);
+    inv->alertSize--;
+    if (i == inv->alertSize) return;
+    alertPlace(inv, i, inv->alertHeap[inv->alertSize]);
+    alertSiftDown(inv, i);
+    alertSiftUp(inv, i);
+}
+
+// Re-evaluates one product against its reorder level.
+void alertRefresh(Inventory* inv, const Product* p) {
+    pthread_mutex_lock(&inv->alertMutex);
+    // Read under the mutex so the last refresh always sees the latest quantity
+    AlertEntry e = { p->id, __atomic_load_n(&p->quantity, __ATOMIC_ACQUIRE), p->reorderLevel };
+    int slot = idMapGet(&inv->alertSlots, e.id);
+    if (e.quantity < e.reorderLevel) {
+        if (slot < 0) {
+            if (inv->alertSize == inv->alertCapacity) {
+                int newCap = inv->alertCapacity ? inv->alertCapacity * 2 : 64;
+                AlertEntry* grown = realloc(inv->alertHeap, (size_t)newCap * sizeof(AlertEntry));
+                if (grown == NULL) {
+                    pthread_mutex_unlock(&inv->alertMutex);
+                    return;
+                }
+                inv->alertHeap = grown;
+                inv->alertCapacity = newCap;
+            }
+            slot = inv->alertSize++;
+        }
+        alertPlace(inv, slot, e);
+        alertSiftUp(inv, slot);
+        alertSiftDown(inv, idMapGet(&inv->alertSlots, e.id));
+    } else if (slot >= 0) {
+        alertRemoveAt(inv, slot);
+    }
+    pthread_mutex_unlock(&inv->alertMutex);
+}
+
+// Called after a quantity change. Changes that stay at or above the reorder
+// level can't affect the heap and skip the lock entirely.
+void alertTrack(Inventory* inv, const Product* p, int oldQty, int newQty) {
+    if (oldQty >= p->reorderLevel && newQty >= p->reorderLevel) return;
+    alertRefresh(inv, p);
+}
+
+void alertRemoveId(Inventory* inv, int id) {
+    pthread_mutex_lock(&inv->alertMutex);
+    int slot = idMapGet(&inv->alertSlots, id);
+    if (slot >= 0) alertRemoveAt(inv, slot);
+    pthread_mutex_unlock(&inv->alertMutex);
+}
+
+// Rebuilds the heap from the whole store (after loading).
+void alertRebuild(Inventory* inv) {
+    pthread_mutex_lock(&inv->alertMutex);
+    int below = 0;
+    for (int i = 0; i < inv->productCount; i++) if (inv->products[i].quantity < inv->products[i].reorderLevel) below++;
+    if (below > inv->alertCapacity) {
+        AlertEntry* grown = realloc(inv->alertHeap, (size_t)below * sizeof(AlertEntry));
+        if (grown != NULL) {
+            inv->alertHeap = grown;
+            inv->alertCapacity = below;
+        } else below = 0;
+    }
+    idMapClear(&inv->alertSlots, below);
+    inv->alertSize = 0;
+    for (int i = 0; i < inv->productCount && inv->alertSize < below; i++) {
+        if (inv->products[i].quantity < inv->products[i].reorderLevel) {
+            AlertEntry e = { inv->products[i].id, inv->products[i].quantity, inv->products[i].reorderLevel };
+            inv->alertHeap[inv->alertSize++] = e;
+        }
+    }
+    for (int i = inv->alertSize / 2 - 1; i >= 0; i--) alertSiftDown(inv, i);
+    for (int i = 0; i < inv->alertSize; i++) idMapPut(&inv->alertSlots, inv->alertHeap[i].id, i);
+    pthread_mutex_unlock(&inv->alertMutex);
+}
+
+// Copies the `max` most critical alerts into out, most critical first.
+// Expands the heap from the root through a frontier of at most max + 1
+// slots, so the cost depends only on how many alerts are shown.
+int alertTop(Inventory* inv, AlertEntry* out, int max, int* total) {
+    int frontier[256];
+    if (max > 255) max = 255;
+
+    pthread_mutex_lock(&inv->alertMutex);
+    *total = inv->alertSize;
+    int n = 0, fSize = 0;
+    if (inv->alertSize > 0) frontier[fSize++] = 0;
+    while (n < max && fSize > 0) {
+        // Pop the most critical heap slot from the frontier
+        int best = 0;
+        for (int i = 1; i < fSize; i++) {
+            if (alertLess(&inv->alertHeap[frontier[i]], &inv->alertHeap[frontier[best]])) best = i;
+        }
+        int slot = frontier[best];
+        frontier[best] = frontier[--fSize];
+        out[n++] = inv->alertHeap[slot];
+        if (2 * slot + 1 < inv->alertSize) frontier[fSize++] = 2 * slot + 1;
+        if (2 * slot + 2 < inv->alertSize) frontier[fSize++] = 2 * slot + 2;
+    }
+    pthread_mutex_unlock(&inv->alertMutex);
+    return n;
+}
+
+// ---------------- Stock Statistics ----------------
+// Running totals for the charts screen, updated by every mutation instead
+// of recomputed per frame: product counts, units and stock value per type,
+// a log2 histogram of quantities, and the products holding the largest and
+// smallest quantity (one max-heap and one min-heap of id/quantity, each
+// with an IdMap from id to heap slot). Reading it all is O(1).
+
+int statsBucket(int qty) {
+    if (qty <= 0) return 0;
+    int b = 1;
+    while (qty > 1 && b < STATS_BUCKETS - 1) {
+        qty >>= 1;
+        b++;
+    }
+    return b;
+}
+
+// Prices are bounded at input (MAX_PRICE); one that got in before the
+// check is clamped so the conversion stays defined.
+long long priceCents(float price) {
+    if (price != price) return 0;
+    if (price > MAX_PRICE) price = MAX_PRICE;
+    else if (price < -MAX_PRICE) price = -MAX_PRICE;
+    return (long long)(price * 100.0f + (price < 0 ? -0.5f : 0.5f));
+}
+
+// Adds one product's value change to a total. A single product can't
+// overflow (quantity x MAX_PRICE in cents), but tens of billions of units
+// at top prices can, so the total saturates instead of wrapping.
+void statsAddValue(long long* total, long long delta) {
+    if (__builtin_add_overflow(*total, delta, total)) *total = delta > 0 ? 0x7fffffffffffffffLL : -0x7fffffffffffffffLL - 1;
+}
+
+// Does a belong above b?
+int qtyHeapLess(const QtyHeap* h, const QtyEntry* a, const QtyEntry* b) {
+    if (a->quantity != b->quantity) return h->sign > 0 ? a->quantity > b->quantity : a->quantity < b->quantity;
+    return a->id < b->id;
+}
+
+void qtyHeapPlace(QtyHeap* h, int i, QtyEntry e) {
+    h->items[i] = e;
+    idMapPut(&h->slots, e.id, i);
+}
+
+void qtyHeapSiftUp(QtyHeap* h, int i) {
+    QtyEntry e = h->items[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!qtyHeapLess(h, &e, &h->items[parent])) break;
+        qtyHeapPlace(h, i, h->items[parent]);
+        i = parent;
+    }
+    qtyHeapPlace(h, i, e);
+}
+
+void qtyHeapSiftDown(QtyHeap* h, int i) {
+    QtyEntry e = h->items[i];
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= h->size) break;
+        if (child + 1 < h->size && qtyHeapLess(h, &h->items[child + 1], &h->items[child])) child++;
+        if (!qtyHeapLess(h, &h->items[child], &e)) break;
+        qtyHeapPlace(h, i, h->items[child]);
+        i = child;
+    }
+    qtyHeapPlace(h, i, e);
+}
+
+// Inserts id or moves it to its new quantity.
+void qtyHeapSet(QtyHeap* h, int id, int quantity) {
+    int slot = idMapGet(&h->slots, id);
+    if (slot < 0) {
+        if (h->size == h->capacity) {
+            int newCap = h->capacity ? h->capacity * 2 : 64;
+            QtyEntry* grown = realloc(h->items, (size_t)newCap * sizeof(QtyEntry));
+            if (grown == NULL) return;
+            h->items = grown;
+            h->capacity = newCap;
+        }
+        slot = h->size++;
+    }
+    QtyEntry e = { id, quantity };
+    qtyHeapPlace(h, slot, e);
+    qtyHeapSiftUp(h, slot);
+    qtyHeapSiftDown(h, idMapGet(&h->slots, id));
+}
+
+void qtyHeapRemove(QtyHeap* h, int id) {
+    int slot = idMapGet(&h->slots, id);
+    if (slot < 0) return;
+    idMapRemove(&h->slots, id);
+    h->size--;
+    if (slot == h->size) return;
+    qtyHeapPlace(h, slot, h->items[h->size]);
+    qtyHeapSiftDown(h, slot);
+    qtyHeapSiftUp(h, slot);
+}
+
+void qtyHeapBuild(QtyHeap* h, const Product* products, int count) {
+    if (count > h->capacity) {
+        QtyEntry* grown = realloc(h->items, (size_t)count * sizeof(QtyEntry));
+        if (grown == NULL) count = h->capacity;
+        else {
+            h->items = grown;
+            h->capacity = count;
+        }
+    }
+    idMapClear(&h->slots, count);
+    h->size = count;
+    for (int i = 0; i < count; i++) {
+        h->items[i].id = products[i].id;
+        h->items[i].quantity = products[i].quantity;
+    }
+    for (int i = h->size / 2 - 1; i >= 0; i--) qtyHeapSiftDown(h, i);
+    for (int i = 0; i < h->size; i++) idMapPut(&h->slots, h->items[i].id, i);
+}
+
+// Adds (sign 1) or removes (sign -1) a product's contribution to the totals.
+void statsAccount(Inventory* inv, const Product* p, int quantity, int sign) {
+    int t = p->type == RAW_MATERIAL ? 0 : 1;
+    inv->stockStats.products += sign;
+    inv->stockStats.typeCount[t] += sign;
+    inv->stockStats.typeUnits[t] += (long long)sign * quantity;
+    statsAddValue(&inv->stockStats.typeValueCents[t], (long long)sign * quantity * priceCents(p->price));
+    inv->stockStats.histogram[statsBucket(quantity)] += sign;
+}
+
+void statsAddProduct(Inventory* inv, const Product* p) {
+    pthread_mutex_lock(&inv->statsMutex);
+    statsAccount(inv, p, p->quantity, 1);
+    qtyHeapSet(&inv->maxQtyHeap, p->id, p->quantity);
+    qtyHeapSet(&inv->minQtyHeap, p->id, p->quantity);
+    pthread_mutex_unlock(&inv->statsMutex);
+}
+
+void statsRemoveProduct(Inventory* inv, const Product* p) {
+    pthread_mutex_lock(&inv->statsMutex);
+    statsAccount(inv, p, p->quantity, -1);
+    qtyHeapRemove(&inv->maxQtyHeap, p->id);
+    qtyHeapRemove(&inv->minQtyHeap, p->id);
+    pthread_mutex_unlock(&inv->statsMutex);
+}
+
+// Called after a quantity change. Totals move by the delta (which commutes
+// across threads); the heaps take the quantity as of now so a late call
+// can't leave them behind.
+void statsTrack(Inventory* inv, const Product* p, int oldQty, int newQty) {
+    int t = p->type == RAW_MATERIAL ? 0 : 1;
+    pthread_mutex_lock(&inv->statsMutex);
+    inv->stockStats.typeUnits[t] += (long long)newQty - oldQty;
+    statsAddValue(&inv->stockStats.typeValueCents[t], ((long long)newQty - oldQty) * priceCents(p->price));
+    inv->stockStats.histogram[statsBucket(oldQty)]--;
+    inv->stockStats.histogram[statsBucket(newQty)]++;
+    int now = __atomic_load_n(&p->quantity, __ATOMIC_ACQUIRE);
+    qtyHeapSet(&inv->maxQtyHeap, p->id, now);
+    qtyHeapSet(&inv->minQtyHeap, p->id, now);
+    pthread_mutex_unlock(&inv->statsMutex);
+}
+
+// Recomputes everything from the store (after loading).
+void statsRebuild(Inventory* inv) {
+    pthread_mutex_lock(&inv->statsMutex);
+    memset(&inv->stockStats, 0, sizeof(inv->stockStats));
+    for (int i = 0; i < inv->productCount; i++) statsAccount(inv, &inv->products[i], inv->products[i].quantity, 1);
+    qtyHeapBuild(&inv->maxQtyHeap, inv->products, inv->productCount);
+    qtyHeapBuild(&inv->minQtyHeap, inv->products, inv->productCount);
+    pthread_mutex_unlock(&inv->statsMutex);
+}
+
+// Copies a consistent view of the totals; maxOut/minOut get id 0 when the
+// store is empty.
+void statsRead(Inventory* inv, StockStats* out, QtyEntry* maxOut, QtyEntry* minOut) {
+    QtyEntry none = { 0, 0 };
+    pthread_mutex_lock(&inv->statsMutex);
+    *out = inv->stockStats;
+    *maxOut = inv->maxQtyHeap.size > 0 ? inv->maxQtyHeap.items[0] : none;
+    *minOut = inv->minQtyHeap.size > 0 ? inv->minQtyHeap.items[0] : none;
+    pthread_mutex_unlock(&inv->statsMutex);
+}
+
+// ---------------- Inventory View Index ----------------
+// Sorted orders of the catalog for the View Inventory screen, one array of
+// product ids per sort key. They are built the first time the screen is
+// opened and from then on kept sorted by the mutation functions (binary
+// search + shift), so changing the sort never re-sorts. Only the quantity
+// order moves on stock changes; it remembers the quantity each id was
+// sorted under (viewQtyKey) to find the entry again. Processes that never
+// show the screen (server, batch) never build it and skip the hooks.
+
+// Orders two products by a fixed (non-quantity) key, ties broken by id.
+int viewKeyCompare(SortKey key, const Product* a, const Product* b) {
+    int c = 0;
+    if (key == SORT_NAME) c = strcmp(a->name, b->name);
+    else if (key == SORT_PRICE) c = (a->price > b->price) - (a->price < b->price);
+    else if (key == SORT_TYPE) c = (int)a->type - (int)b->type;
+    if (c != 0) return c;
+    return (a->id > b->id) - (a->id < b->id);
+}
+
+// First slot in [lo, hi) of order `key` whose entry does not sort before p
+// (qty is the quantity p is, or will be, sorted under in the quantity order).
+int viewLowerBoundIn(Inventory* inv, SortKey key, const Product* p, int qty, int lo, int hi) {
+    const int* order = inv->viewOrder[key];
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        int other = order[mid];
+        int before;
+        if (key == SORT_ID) {
+            before = other < p->id;
+        } else if (key == SORT_QTY) {
+            int otherQty = idMapGet(&inv->viewQtyKey, other);
+            before = otherQty < qty || (otherQty == qty && other < p->id);
+        } else {
+            before = viewKeyCompare(key, &inv->products[indexFind(inv, other)], p) < 0;
+        }
+        if (before) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+int viewLowerBound(Inventory* inv, SortKey key, const Product* p, int qty) {
+    return viewLowerBoundIn(inv, key, p, qty, 0, inv->viewOrderLen);
+}
+
+void viewOrderInsert(Inventory* inv, SortKey key, const Product* p, int qty) {
+    int i = viewLowerBound(inv, key, p, qty);
+    memmove(&inv->viewOrder[key][i + 1], &inv->viewOrder[key][i], (size_t)(inv->viewOrderLen - i) * sizeof(int));
+    inv->viewOrder[key][i] = p->id;
+}
+
+void viewOrderErase(Inventory* inv, SortKey key, const Product* p, int qty) {
+    int i = viewLowerBound(inv, key, p, qty);
+    if (i >= inv->viewOrderLen || inv->viewOrder[key][i] != p->id) return;
+    memmove(&inv->viewOrder[key][i], &inv->viewOrder[key][i + 1], (size_t)(inv->viewOrderLen - i - 1) * sizeof(int));
+}
+
+// qsort has no context pointer: the comparators read these, set by the
+// sorting thread just before each qsort call.
+_Thread_local Inventory* sortInventory;
+_Thread_local SortKey viewSortKey;
+
+int viewSortCompare(const void* a, const void* b) {
+    const Product* pa = &sortInventory->products[*(const int*)a];
+    const Product* pb = &sortInventory->products[*(const int*)b];
+    if (viewSortKey == SORT_QTY && pa->quantity != pb->quantity) return pa->quantity < pb->quantity ? -1 : 1;
+    return viewKeyCompare(viewSortKey, pa, pb);
+}
+
+// Builds every order from the store; called by the view screen on first use.
+// Out of memory it leaves viewReady at 0 and viewPage pages the store unsorted.
+void viewIndexBuild(Inventory* inv) {
+    pthread_rwlock_rdlock(&inv->inventoryLock);
+    pthread_mutex_lock(&inv->viewMutex);
+    if (!inv->viewReady) {
+        int cap = inv->productCount > INITIAL_CAPACITY ? inv->productCount : INITIAL_CAPACITY;
+        int* positions = malloc((size_t)cap * sizeof(int));
+        int ok = positions != NULL;
+        for (int k = 0; k < SORT_KEYS; k++) {
+            inv->viewOrder[k] = ok ? malloc((size_t)cap * sizeof(int)) : NULL;
+            if (inv->viewOrder[k] == NULL) ok = 0;
+        }
+        if (ok) ok = idMapClear(&inv->viewQtyKey, inv->productCount);
+        if (!ok) {
+            printf("Out of memory building the inventory view!\n");
+            free(positions);
+            for (int k = 0; k < SORT_KEYS; k++) {
+                free(inv->viewOrder[k]);
+                inv->viewOrder[k] = NULL;
+            }
+            pthread_mutex_unlock(&inv->viewMutex);
+            pthread_rwlock_unlock(&inv->inventoryLock);
+            return;
+        }
+        for (int i = 0; i < inv->productCount; i++) idMapPut(&inv->viewQtyKey, inv->products[i].id, inv->products[i].quantity);
+
+        for (int k = 0; k < SORT_KEYS; k++) {
+            for (int i = 0; i < inv->productCount; i++) positions[i] = i;
+            sortInventory = inv;
+            viewSortKey = (SortKey)k;
+            qsort(positions, (size_t)inv->productCount, sizeof(int), viewSortCompare);
+            for (int i = 0; i < inv->productCount; i++) inv->viewOrder[k][i] = inv->products[positions[i]].id;
+        }
+        free(positions);
+        inv->viewOrderLen = inv->productCount;
+        inv->viewOrderCapacity = cap;
+        inv->viewVersion++;
+        __atomic_store_n(&inv->viewReady, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&inv->viewMutex);
+    pthread_rwlock_unlock(&inv->inventoryLock);
+}
+
+// Frees the orders; the screen builds them again on next use.
+void viewIndexDrop(Inventory* inv) {
+    pthread_mutex_lock(&inv->viewMutex);
+    for (int k = 0; k < SORT_KEYS; k++) {
+        free(inv->viewOrder[k]);
+        inv->viewOrder[k] = NULL;
+    }
+    inv->viewOrderLen = inv->viewOrderCapacity = 0;
+    inv->viewVersion++;
+    __atomic_store_n(&inv->viewReady, 0, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&inv->viewMutex);
+}
+
+// Hooks for the mutation functions; they run under inventoryLock.
+
+void viewTrackAdd(Inventory* inv, const Product* p) {
+    if (!__atomic_load_n(&inv->viewReady, __ATOMIC_ACQUIRE)) return;
+    pthread_mutex_lock(&inv->viewMutex);
+    if (inv->viewOrderLen == inv->viewOrderCapacity) {
+        int newCap = inv->viewOrderCapacity * 2;
+        for (int k = 0; k < SORT_KEYS; k++) {
+            int* grown = realloc(inv->viewOrder[k], (size_t)newCap * sizeof(int));
+            if (grown == NULL) {
+                // Out of memory: drop the view index; the screen rebuilds it
+                for (int j = 0; j < SORT_KEYS; j++) {
+                    free(inv->viewOrder[j]);
+                    inv->viewOrder[j] = NULL;
+                }
+                inv->viewOrderCapacity = inv->viewOrderLen = 0;
+                __atomic_store_n(&inv->viewReady, 0, __ATOMIC_RELEASE);
+                pthread_mutex_unlock(&inv->viewMutex);
+                return;
+            }
+            inv->viewOrder[k] = grown;
+        }
+        inv->viewOrderCapacity = newCap;
+    }
+    int qty = __atomic_load_n(&p->quantity, __ATOMIC_ACQUIRE);
+    for (int k = 0; k < SORT_KEYS; k++) viewOrderInsert(inv, (SortKey)k, p, qty);
+    idMapPut(&inv->viewQtyKey, p->id, qty);
+    inv->viewOrderLen++;
+    inv->viewVersion++;
+    pthread_mutex_unlock(&inv->viewMutex);
+}
+
+// Call before the product is removed from the store.
+void viewTrackRemove(Inventory* inv, const Product* p) {
+    if (!__atomic_load_n(&inv->viewReady, __ATOMIC_ACQUIRE)) return;
+    pthread_mutex_lock(&inv->viewMutex);
+    int qty = idMapGet(&inv->viewQtyKey, p->id);
+    for (int k = 0; k < SORT_KEYS; k++) viewOrderErase(inv, (SortKey)k, p, qty);
+    idMapRemove(&inv->viewQtyKey, p->id);
+    inv->viewOrderLen--;
+    inv->viewVersion++;
+    pthread_mutex_unlock(&inv->viewMutex);
+}
+
+// Re-files p after its quantity or reorder level changed.
+void viewTrackUpdate(Inventory* inv, const Product* p) {
+    if (!__atomic_load_n(&inv->viewReady, __ATOMIC_ACQUIRE)) return;
+    pthread_mutex_lock(&inv->viewMutex);
+    int oldQty = idMapGet(&inv->viewQtyKey, p->id);
+    int qty = __atomic_load_n(&p->quantity, __ATOMIC_ACQUIRE);
+    int* order = inv->viewOrder[SORT_QTY];
+    int i = viewLowerBound(inv, SORT_QTY, p, oldQty);
+    if (qty != oldQty && i < inv->viewOrderLen && order[i] == p->id) {
+        // Only the entries between the old and new slot shift by one
+        if (qty > oldQty) {
+            int j = viewLowerBoundIn(inv, SORT_QTY, p, qty, i + 1, inv->viewOrderLen);
+            memmove(&order[i], &order[i + 1], (size_t)(j - i - 1) * sizeof(int));
+            order[j - 1] = p->id;
+        } else {
+            int j = viewLowerBoundIn(inv, SORT_QTY, p, qty, 0, i);
+            memmove(&order[j + 1], &order[j], (size_t)(i - j) * sizeof(int));
+            order[j] = p->id;
+        }
+        idMapPut(&inv->viewQtyKey, p->id, qty);
+    }
+    // Low stock filtering depends on quantity, so bump even when unmoved
+    inv->viewVersion++;
+    pthread_mutex_unlock(&inv->viewMutex);
+}
+
+int viewFilterMatch(ViewFilter filter, const Product* p) {
+    if (filter == FILTER_RAW) return p->type == RAW_MATERIAL;
+    if (filter == FILTER_FINISHED) return p->type == FINISHED_GOOD;
+    if (filter == FILTER_LOW_STOCK) return p->quantity < p->reorderLevel;
+    return 1;
+}
+
+// Copies up to max ids starting at row `first` of the sorted, filtered
+// view into ids and returns how many were copied; *total gets the row
+// count. Unfiltered pages come straight from the order array. Without the
+// orders (not built, or out of memory) rows come in store order instead.
+int viewPage(Inventory* inv, SortKey key, int descending, ViewFilter filter, int first, int max, int* ids, int* total) {
+    pthread_rwlock_rdlock(&inv->inventoryLock);
+    pthread_mutex_lock(&inv->viewMutex);
+    if (!inv->viewReady) {
+        int n = 0, count = 0;
+        for (int i = 0; i < inv->productCount; i++) {
+            const Product* p = &inv->products[descending ? inv->productCount - 1 - i : i];
+            if (!viewFilterMatch(filter, p)) continue;
+            if (count >= first && n < max) ids[n++] = p->id;
+            count++;
+        }
+        *total = count;
+        pthread_mutex_unlock(&inv->viewMutex);
+        pthread_rwlock_unlock(&inv->inventoryLock);
+        return n;
+    }
+    const int* rows = inv->viewOrder[key];
+    int count = inv->viewOrderLen;
+    if (filter != FILTER_ALL) {
+        if (inv->viewRows == NULL || inv->viewRowsVersion != inv->viewVersion || inv->viewRowsKey != key ||
+            inv->viewRowsDescending != descending || inv->viewRowsFilter != filter) {
+            int* grown = realloc(inv->viewRows, (size_t)(inv->viewOrderLen > 0 ? inv->viewOrderLen : 1) * sizeof(int));
+            if (grown != NULL) {
+                inv->viewRows = grown;
+                inv->viewRowCount = 0;
+                for (int i = 0; i < inv->viewOrderLen; i++) {
+                    int id = rows[descending ? inv->viewOrderLen - 1 - i : i];
+                    if (viewFilterMatch(filter, &inv->products[indexFind(inv, id)])) inv->viewRows[inv->viewRowCount++] = id;
+                }
+                inv->viewRowsVersion = inv->viewVersion;
+                inv->viewRowsKey = key;
+                inv->viewRowsDescending = descending;
+                inv->viewRowsFilter = filter;
+            }
+        }
+        // Already in display order
+        rows = inv->viewRows;
+        count = inv->viewRowCount;
+        descending = 0;
+    }
+
+    int n = 0;
+    for (int i = first; i < count && n < max; i++) {
+        ids[n++] = rows[descending ? count - 1 - i : i];
+    }
+    *total = count;
+    pthread_mutex_unlock(&inv->viewMutex);
+    pthread_rwlock_unlock(&inv->inventoryLock);
+    return n;
+}
+
+// ---------------- Name Search Index ----------------
+// Finds products by part of their name, case-insensitively:
+//   - prefix: product ids sorted by folded name, searched by binary search
+//   - substring: a trigram index (every 3-character window of a folded
+//     name -> sorted list of ids). A query is answered from the shortest
+//     posting list among its trigrams, checking each candidate's name.
+// The GUI builds it on a background thread at startup (a million names
+// take a couple of seconds); from then on addProduct/deleteProduct keep
+// it current.
+
+#define NAME_MIN_GRAM 3
+
+char foldChar(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+// strcmp on folded characters; if prefixOnly, a matching a that ends first
+// compares equal (a is a prefix of b).
+int foldCompare(const char* a, const char* b, int prefixOnly) {
+    while (*a && foldChar(*a) == foldChar(*b)) {
+        a++;
+        b++;
+    }
+    if (*a == '\0' && prefixOnly) return 0;
+    return (unsigned char)foldChar(*a) - (unsigned char)foldChar(*b);
+}
+
+// Case-insensitive substring test.
+int foldContains(const char* haystack, const char* needle) {
+    for (; *haystack; haystack++) {
+        const char* h = haystack;
+        const char* n = needle;
+        while (*n && foldChar(*h) == foldChar(*n)) {
+            h++;
+            n++;
+        }
+        if (*n == '\0') return 1;
+    }
+    return 0;
+}
+
+int trigramKey(const char* s) {
+    return ((unsigned char)foldChar(s[0]) << 16) | ((unsigned char)foldChar(s[1]) << 8) | (unsigned char)foldChar(s[2]);
+}
+
+// First slot whose id does not sort before the product (name, id).
+int nameLowerBound(Inventory* inv, const char* name, int id) {
+    int lo = 0, hi = inv->nameOrderLen;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        const Product* other = &inv->products[indexFind(inv, inv->nameOrder[mid])];
+        int c = foldCompare(other->name, name, 0);
+        if (c < 0 || (c == 0 && other->id < id)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Returns the slot of `key` in namePostings, creating it if asked.
+PostingList* namePostingFor(Inventory* inv, int key, int create) {
+    int slot = idMapGet(&inv->nameTrigrams, key);
+    if (slot >= 0) return &inv->namePostings[slot];
+    if (!create) return NULL;
+    if (inv->namePostingCount == inv->namePostingCapacity) {
+        int newCap = inv->namePostingCapacity ? inv->namePostingCapacity * 2 : 1024;
+        PostingList* grown = realloc(inv->namePostings, (size_t)newCap * sizeof(PostingList));
+        if (grown == NULL) return NULL;
+        inv->namePostings = grown;
+        inv->namePostingCapacity = newCap;
+    }
+    PostingList* list = &inv->namePostings[inv->namePostingCount];
+    memset(list, 0, sizeof(*list));
+    idMapPut(&inv->nameTrigrams, key, inv->namePostingCount++);
+    return list;
+}
+
+// Index of the first id >= id in a posting list.
+int postingLowerBound(const PostingList* list, int id) {
+    int lo = 0, hi = list->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (list->ids[mid] < id) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+void postingInsert(PostingList* list, int id) {
+    int i = postingLowerBound(list, id);
+    if (i < list->count && list->ids[i] == id) return;     // Repeated trigram in one name
+    if (list->count == list->capacity) {
+        int newCap = list->capacity ? list->capacity * 2 : 4;
+        int* grown = realloc(list->ids, (size_t)newCap * sizeof(int));
+        if (grown == NULL) return;
+        list->ids = grown;
+        list->capacity = newCap;
+    }
+    memmove(&list->ids[i + 1], &list->ids[i], (size_t)(list->count - i) * sizeof(int));
+    list->ids[i] = id;
+    list->count++;
+}
+
+void postingErase(PostingList* list, int id) {
+    int i = postingLowerBound(list, id);
+    if (i >= list->count || list->ids[i] != id) return;
+    memmove(&list->ids[i], &list->ids[i + 1], (size_t)(list->count - i - 1) * sizeof(int));
+    list->count--;
+}
+
+void nameIndexTrigrams(Inventory* inv, const Product* p, int add) {
+    size_t len = strlen(p->name);
+    for (size_t i = 0; i + NAME_MIN_GRAM <= len; i++) {
+        PostingList* list = namePostingFor(inv, trigramKey(p->name + i), add);
+        if (list == NULL) continue;
+        if (add) postingInsert(list, p->id);
+        else postingErase(list, p->id);
+    }
+}
+
+// Sort entry for the initial build: the first 8 folded name bytes decide
+// most comparisons without touching the product records.
+typedef struct {
+    unsigned long long prefix;
+    int pos;
+} NameSortEntry;
+
+int nameSortCompare(const void* a, const void* b) {
+    const NameSortEntry* ea = a;
+    const NameSortEntry* eb = b;
+    if (ea->prefix != eb->prefix) return ea->prefix < eb->prefix ? -1 : 1;
+    const Product* pa = &sortInventory->products[ea->pos];
+    const Product* pb = &sortInventory->products[eb->pos];
+    int c = foldCompare(pa->name, pb->name, 0);
+    if (c != 0) return c;
+    return (pa->id > pb->id) - (pa->id < pb->id);
+}
+
+int intCompare(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// Frees both structures; the caller holds nameMutex.
+void nameIndexClearLocked(Inventory* inv) {
+    free(inv->nameOrder);
+    inv->nameOrder = NULL;
+    inv->nameOrderLen = inv->nameOrderCapacity = 0;
+    for (int t = 0; t < inv->namePostingCount; t++) free(inv->namePostings[t].ids);
+    inv->namePostingCount = 0;
+    idMapClear(&inv->nameTrigrams, 1024);
+}
+
+// Builds both structures from the store. Out of memory it leaves nameReady
+// at 0, and searches keep scanning the store linearly.
+void nameIndexBuild(Inventory* inv) {
+    pthread_rwlock_rdlock(&inv->inventoryLock);
+    pthread_mutex_lock(&inv->nameMutex);
+    if (!inv->nameReady) {
+        int cap = inv->productCount > INITIAL_CAPACITY ? inv->productCount : INITIAL_CAPACITY;
+        inv->nameOrder = malloc((size_t)cap * sizeof(int));
+        NameSortEntry* entries = malloc((size_t)cap * sizeof(NameSortEntry));
+        if (inv->nameOrder == NULL || entries == NULL) {
+            printf("Out of memory building the name index!\n");
+            free(entries);
+            nameIndexClearLocked(inv);
+            __atomic_store_n(&inv->nameFailed, 1, __ATOMIC_RELEASE);
+            pthread_mutex_unlock(&inv->nameMutex);
+            pthread_rwlock_unlock(&inv->inventoryLock);
+            return;
+        }
+        for (int i = 0; i < inv->productCount; i++) {
+            unsigned long long prefix = 0;
+            const char* c = inv->products[i].name;
+            for (int k = 0; k < 8; k++) {
+                prefix = (prefix << 8) | (unsigned char)foldChar(*c);
+                if (*c) c++;
+            }
+            entries[i].prefix = prefix;
+            entries[i].pos = i;
+        }
+        sortInventory = inv;
+        qsort(entries, (size_t)inv->productCount, sizeof(NameSortEntry), nameSortCompare);
+        for (int i = 0; i < inv->productCount; i++) inv->nameOrder[i] = inv->products[entries[i].pos].id;
+        free(entries);
+        inv->nameOrderLen = inv->productCount;
+        inv->nameOrderCapacity = cap;
+
+        // Append unsorted, then sort each list once. A list missing an id
+        // would hide a match, so any failed allocation abandons the index.
+        int ok = idMapClear(&inv->nameTrigrams, 1024);
+        for (int i = 0; i < inv->productCount && ok; i++) {
+            const char* name = inv->products[i].name;
+            size_t len = strlen(name);
+            for (size_t j = 0; j + NAME_MIN_GRAM <= len; j++) {
+                PostingList* list = namePostingFor(inv, trigramKey(name + j), 1);
+                if (list == NULL) {
+                    ok = 0;
+                    break;
+                }
+                if (list->count > 0 && list->ids[list->count - 1] == inv->products[i].id) continue;
+                if (list->count == list->capacity) {
+                    int newCap = list->capacity ? list->capacity * 2 : 4;
+                    int* grown = realloc(list->ids, (size_t)newCap * sizeof(int));
+                    if (grown == NULL) {
+                        ok = 0;
+                        break;
+                    }
+                    list->ids = grown;
+                    list->capacity = newCap;
+                }
+                list->ids[list->count++] = inv->products[i].id;
+            }
+        }
+        if (!ok) {
+            printf("Out of memory building the name index!\n");
+            nameIndexClearLocked(inv);
+            __atomic_store_n(&inv->nameFailed, 1, __ATOMIC_RELEASE);
+            pthread_mutex_unlock(&inv->nameMutex);
+            pthread_rwlock_unlock(&inv->inventoryLock);
+            return;
+        }
+        for (int t = 0; t < inv->namePostingCount; t++) {
+            PostingList* list = &inv->namePostings[t];
+            int sorted = 1;
+            for (int k = 1; k < list->count && sorted; k++) sorted = list->ids[k - 1] <= list->ids[k];
+            if (!sorted) qsort(list->ids, (size_t)list->count, sizeof(int), intCompare);
+            // Drop repeats (a trigram seen twice in one name, non-adjacent)
+            int out = 0;
+            for (int k = 0; k < list->count; k++) {
+                if (out == 0 || list->ids[out - 1] != list->ids[k]) list->ids[out++] = list->ids[k];
+            }
+            list->count = out;
+        }
+        __atomic_store_n(&inv->nameFailed, 0, __ATOMIC_RELEASE);
+        __atomic_store_n(&inv->nameReady, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&inv->nameMutex);
+    pthread_rwlock_unlock(&inv->inventoryLock);
+}
+
+// Frees both structures (before a bulk change); nameIndexBuild starts over.
+void nameIndexDrop(Inventory* inv) {
+    pthread_mutex_lock(&inv->nameMutex);
+    nameIndexClearLocked(inv);
+    __atomic_store_n(&inv->nameFailed, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&inv->nameReady, 0, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&inv->nameMutex);
+}
+
+void* nameIndexMain(void* arg) {
+    Inventory* inv = arg;
+    nameIndexBuild(inv);
+    return NULL;
+}
+
+// Hooks for addProduct/deleteProduct; they run under inventoryLock.
+
+void nameTrackAdd(Inventory* inv, const Product* p) {
+    if (!__atomic_load_n(&inv->nameReady, __ATOMIC_ACQUIRE)) return;
+    pthread_mutex_lock(&inv->nameMutex);
+    if (inv->nameOrderLen == inv->nameOrderCapacity) {
+        int* grown = realloc(inv->nameOrder, (size_t)inv->nameOrderCapacity * 2 * sizeof(int));
+        if (grown == NULL) {
+            pthread_mutex_unlock(&inv->nameMutex);
+            return;
+        }
+        inv->nameOrder = grown;
+        inv->nameOrderCapacity *= 2;
+    }
+    int i = nameLowerBound(inv, p->name, p->id);
+    memmove(&inv->nameOrder[i + 1], &inv->nameOrder[i], (size_t)(inv->nameOrderLen - i) * sizeof(int));
+    inv->nameOrder[i] = p->id;
+    inv->nameOrderLen++;
+    nameIndexTrigrams(inv, p, 1);
+    pthread_mutex_unlock(&inv->nameMutex);
+}
+
+// Call before the product is removed from the store.
+void nameTrackRemove(Inventory* inv, const Product* p) {
+    if (!__atomic_load_n(&inv->nameReady, __ATOMIC_ACQUIRE)) return;
+    pthread_mutex_lock(&inv->nameMutex);
+    int i = nameLowerBound(inv, p->name, p->id);
+    if (i < inv->nameOrderLen && inv->nameOrder[i] == p->id) {
+        memmove(&inv->nameOrder[i], &inv->nameOrder[i + 1], (size_t)(inv->nameOrderLen - i - 1) * sizeof(int));
+        inv->nameOrderLen--;
+    }
+    nameIndexTrigrams(inv, p, 0);
+    pthread_mutex_unlock(&inv->nameMutex);
+}
+
+// Fills ids with up to max products whose name matches query: names that
+// start with it first (in name order), then names that contain it (in id
+// order; queries of NAME_MIN_GRAM characters or more). *prefixTotal gets
+// the full number of prefix matches. Returns how many ids were written.
+// Without the index (its build ran out of memory) the store is scanned and
+// both groups come in store order.
+int nameSearch(Inventory* inv, const char* query, int* ids, int max, int* prefixTotal) {
+    *prefixTotal = 0;
+    size_t qlen = strlen(query);
+    if (qlen == 0 || max <= 0) return 0;
+
+    long long t0 = metricStart();
+    pthread_rwlock_rdlock(&inv->inventoryLock);
+    pthread_mutex_lock(&inv->nameMutex);
+
+    if (!inv->nameReady) {
+        int n = 0;
+        for (int i = 0; i < inv->productCount; i++) {
+            if (foldCompare(query, inv->products[i].name, 1) != 0) continue;
+            if (n < max) ids[n++] = inv->products[i].id;
+            (*prefixTotal)++;
+        }
+        for (int i = 0; i < inv->productCount && n < max && qlen >= NAME_MIN_GRAM; i++) {
+            const Product* p = &inv->products[i];
+            if (foldCompare(query, p->name, 1) != 0 && foldContains(p->name, query)) ids[n++] = p->id;
+        }
+        pthread_mutex_unlock(&inv->nameMutex);
+        pthread_rwlock_unlock(&inv->inventoryLock);
+        metricRecord(METRIC_SEARCH, t0);
+        return n;
+    }
+
+    // Prefix range [first, last)
+    int lo = 0, hi = inv->nameOrderLen;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (foldCompare(query, inv->products[indexFind(inv, inv->nameOrder[mid])].name, 1) > 0) lo = mid + 1;
+        else hi = mid;
+    }
+    int first = lo;
+    hi = inv->nameOrderLen;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (foldCompare(query, inv->products[indexFind(inv, inv->nameOrder[mid])].name, 1) >= 0) lo = mid + 1;
+        else hi = mid;
+    }
+    *prefixTotal = lo - first;
+
+    int n = 0;
+    for (int i = first; i < lo && n < max; i++) ids[n++] = inv->nameOrder[i];
+
+    if (n < max && qlen >= NAME_MIN_GRAM) {
+        // The rarest trigram of the query bounds the candidates
+        const PostingList* best = NULL;
+        for (size_t i = 0; i + NAME_MIN_GRAM <= qlen; i++) {
+            const PostingList* list = namePostingFor(inv, trigramKey(query + i), 0);
+            if (list == NULL || list->count == 0) {
+                best = NULL;
+                break;
+            }
+            if (best == NULL || list->count < best->count) best = list;
+        }
+        for (int k = 0; best != NULL && k < best->count && n < max; k++) {
+            const Product* p = &inv->products[indexFind(inv, best->ids[k])];
+            // Prefix matches were listed already
+            if (foldCompare(query, p->name, 1) != 0 && foldContains(p->name, query)) ids[n++] = p->id;
+        }
+    }
+
+    pthread_mutex_unlock(&inv->nameMutex);
+    pthread_rwlock_unlock(&inv->inventoryLock);
+    metricRecord(METRIC_SEARCH, t0);
+    return n;
+}
+
+// ---------------- Platform Helpers ----------------
+
+double nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Wall-clock time in ms since the epoch (nowMs is monotonic, for intervals).
+long long wallMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+void sleepMs(int ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+// Flushes stdio buffers and forces the data down to the disk.
+int syncFile(FILE* fp) {
+    if (fflush(fp) != 0) return -1;
+    return fsync(fileno(fp));
+}
+
+// Atomically replaces `to` with `from` (rename() won't overwrite on Windows).
+int replaceFile(const char* from, const char* to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+    return rename(from, to);
+#endif
+}
+
+// ---------------- Operation Metrics ----------------
+// Each core operation and file write records how long it took into a
+// log-linear latency histogram (HDR style: METRIC_SUB_BUCKETS linear steps
+// per power of two, so every value is kept to within ~6%). Recording is a
+// few relaxed atomic adds into one of METRIC_SHARDS copies chosen per
+// thread, so worker threads don't share cache lines; readers add the
+// shards up. Id lookups are too quick to time every call: they are all
+// counted but only one in METRIC_LOOKUP_SAMPLE is timed.
+//
+// Latencies are taken in CPU ticks (rdtsc on x86, a few ns, where
+// clock_gettime costs tens) and converted to time only when read, using
+// the tick rate seen since the first measurement.
+
+#define METRIC_SUB_BITS 4
+#define METRIC_SUB_BUCKETS (1 << METRIC_SUB_BITS)
+#define METRIC_MAX_BITS 44                  // Up to 2^44 ticks (over an hour at 4 GHz)
+#define METRIC_BUCKETS ((METRIC_MAX_BITS - METRIC_SUB_BITS + 1) * METRIC_SUB_BUCKETS)
+#define METRIC_SHARDS 8
+#define METRIC_LOOKUP_SAMPLE 64
+
+typedef struct {
+    atomic_llong count;
+    atomic_llong totalTicks;    // Of the timed calls
+    atomic_llong maxTicks;
+    atomic_llong buckets[METRIC_BUCKETS];
+} MetricHistogram;
+
+MetricHistogram metricShards[METRIC_SHARDS][METRIC_OPS];
+atomic_int metricNextShard;
+_Thread_local int metricShard = -1;
+_Thread_local unsigned int metricLookupTick;
+atomic_llong metricBaseTicks;   // A tick count and the time it was read at,
+atomic_llong metricBaseNs;      // for converting ticks to time
+int metricsEnabled = 1;
+double metricsStartMs = 0;
+
+const char* metricNames[METRIC_OPS] = {
+    "add", "update", "sale", "purchase", "delete", "lookup", "search",
+    "save", "load", "import", "export", "transfer", "journal sync", "log write", "frame"
+};
+
+long long nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+long long metricTicks() {
+    return (long long)__rdtsc();
+}
+#else
+long long metricTicks() {
+    return nowNs();
+}
+#endif
+
+// Nanoseconds per tick, measured since the first metricStart.
+double metricNsPerTick() {
+    long long baseNs = atomic_load(&metricBaseNs);
+    if (baseNs == 0) return 1.0;
+    long long elapsedNs = nowNs() - baseNs;
+    if (elapsedNs < 2000000) {
+        sleepMs(2);     // Too short an interval for a usable rate
+        elapsedNs = nowNs() - baseNs;
+    }
+    long long ticks = metricTicks() - atomic_load(&metricBaseTicks);
+    return ticks > 0 ? (double)elapsedNs / (double)ticks : 1.0;
+}
+
+int metricBucket(long long ticks) {
+    if (ticks < METRIC_SUB_BUCKETS) return ticks < 0 ? 0 : (int)ticks;
+    if (ticks >= (1LL << METRIC_MAX_BITS)) ticks = (1LL << METRIC_MAX_BITS) - 1;
+    int magnitude = 63 - __builtin_clzll((unsigned long long)ticks);
+    int sub = (int)(ticks >> (magnitude - METRIC_SUB_BITS)) & (METRIC_SUB_BUCKETS - 1);
+    return (magnitude - METRIC_SUB_BITS + 1) * METRIC_SUB_BUCKETS + sub;
+}
+
+// Smallest value that lands in `bucket`; *width gets how many values do.
+long long metricBucketFloor(int bucket, long long* width) {
+    if (bucket < METRIC_SUB_BUCKETS) {
+        *width = 1;
+        return bucket;
+    }
+    int shift = bucket / METRIC_SUB_BUCKETS - 1;
+    *width = 1LL << shift;
+    return (long long)(METRIC_SUB_BUCKETS + bucket % METRIC_SUB_BUCKETS) << shift;
+}
+
+// Timestamp to pass to metricRecord, or 0 when metrics are off.
+long long metricStart() {
+    if (!metricsEnabled) return 0;
+    if (atomic_load_explicit(&metricBaseNs, memory_order_relaxed) == 0) {
+        atomic_store(&metricBaseTicks, metricTicks());
+        atomic_store(&metricBaseNs, nowNs());
+    }
+    return metricTicks();
+}
+
+// metricStart for id lookups: 0 (count only) for all but one call in
+// METRIC_LOOKUP_SAMPLE.
+long long metricStartSampled() {
+    if (!metricsEnabled || metricLookupTick++ % METRIC_LOOKUP_SAMPLE != 0) return 0;
+    return metricStart();
+}
+
+// Counts one call of op; a non-zero start also records its latency.
+void metricRecord(MetricOp op, long long start) {
+    if (!metricsEnabled) return;
+    if (metricShard < 0) metricShard = atomic_fetch_add(&metricNextShard, 1) % METRIC_SHARDS;
+    MetricHistogram* h = &metricShards[metricShard][op];
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+    if (start == 0) return;
+    long long ticks = metricTicks() - start;
+    if (ticks < 0) ticks = 0;
+    atomic_fetch_add_explicit(&h->totalTicks, ticks, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->buckets[metricBucket(ticks)], 1, memory_order_relaxed);
+    long long seen = atomic_load_explicit(&h->maxTicks, memory_order_relaxed);
+    while (ticks > seen && !atomic_compare_exchange_weak_explicit(&h->maxTicks, &seen, ticks,
+                                                                  memory_order_relaxed, memory_order_relaxed));
+}
+
+// Sums the shards of op into one histogram.
+void metricCollect(MetricOp op, long long* buckets, long long* count, long long* totalTicks, long long* maxTicks) {
+    memset(buckets, 0, sizeof(long long) * METRIC_BUCKETS);
+    *count = *totalTicks = *maxTicks = 0;
+    for (int s = 0; s < METRIC_SHARDS; s++) {
+        MetricHistogram* h = &metricShards[s][op];
+        *count += atomic_load_explicit(&h->count, memory_order_relaxed);
+        *totalTicks += atomic_load_explicit(&h->totalTicks, memory_order_relaxed);
+        long long m = atomic_load_explicit(&h->maxTicks, memory_order_relaxed);
+        if (m > *maxTicks) *maxTicks = m;
+        for (int b = 0; b < METRIC_BUCKETS; b++) buckets[b] += atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+    }
+}
+
+// Latency below which `fraction` of the timed calls fall (bucket midpoint).
+double metricPercentileUs(const long long* buckets, long long timed, long long maxTicks, double fraction, double nsPerTick) {
+    long long rank = (long long)(fraction * (double)timed + 0.5);
+    if (rank < 1) rank = 1;
+    long long seen = 0;
+    double value = (double)maxTicks;
+    for (int b = 0; b < METRIC_BUCKETS; b++) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            long long width;
+            double mid = (double)metricBucketFloor(b, &width) + (double)(width - 1) / 2.0;
+            if (mid < value) value = mid;
+            break;
+        }
+    }
+    return value * nsPerTick / 1000.0;
+}
+
+void metricRead(MetricOp op, MetricSummary* out) {
+    long long buckets[METRIC_BUCKETS];
+    long long totalTicks, maxTicks;
+    double nsPerTick = metricNsPerTick();
+    metricCollect(op, buckets, &out->count, &totalTicks, &maxTicks);
+    long long timed = 0;
+    for (int b = 0; b < METRIC_BUCKETS; b++) timed += buckets[b];
+    out->timed = timed;
+    out->meanUs = timed > 0 ? (double)totalTicks / (double)timed * nsPerTick / 1000.0 : 0;
+    out->p50Us = timed > 0 ? metricPercentileUs(buckets, timed, maxTicks, 0.50, nsPerTick) : 0;
+    out->p99Us = timed > 0 ? metricPercentileUs(buckets, timed, maxTicks, 0.99, nsPerTick) : 0;
+    out->maxUs = (double)maxTicks * nsPerTick / 1000.0;
+}
+
+void metricsReset() {
+    for (int s = 0; s < METRIC_SHARDS; s++) {
+        for (int op = 0; op < METRIC_OPS; op++) {
+            MetricHistogram* h = &metricShards[s][op];
+            atomic_store_explicit(&h->count, 0, memory_order_relaxed);
+            atomic_store_explicit(&h->totalTicks, 0, memory_order_relaxed);
+            atomic_store_explicit(&h->maxTicks, 0, memory_order_relaxed);
+            for (int b = 0; b < METRIC_BUCKETS; b++) atomic_store_explicit(&h->buckets[b], 0, memory_order_relaxed);
+        }
+    }
+    metricsStartMs = nowMs();
+}
+
+// Writes a summary row per operation, then the non-empty buckets of each
+// histogram ("bucket,op,from_ns,to_ns,count"), as CSV. Returns 1 on success.
+int metricsDump(const char* path) {
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL) return 0;
+    double seconds = (nowMs() - metricsStartMs) / 1000.0;
+    double nsPerTick = metricNsPerTick();
+    fprintf(fp, "op,count,timed,mean_us,p50_us,p90_us,p99_us,p999_us,max_us,ops_per_sec\n");
+    for (int op = 0; op < METRIC_OPS; op++) {
+        long long buckets[METRIC_BUCKETS];
+        long long count, totalTicks, maxTicks, timed = 0;
+        metricCollect((MetricOp)op, buckets, &count, &totalTicks, &maxTicks);
+        for (int b = 0; b < METRIC_BUCKETS; b++) timed += buckets[b];
+        if (count == 0) continue;
+        if (timed == 0) {
+            fprintf(fp, "%s,%lld,0,,,,,,,%.1f\n", metricNames[op], count, seconds > 0 ? count / seconds : 0.0);
+            continue;
+        }
+        fprintf(fp, "%s,%lld,%lld,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.1f\n", metricNames[op], count, timed,
+                (double)totalTicks / (double)timed * nsPerTick / 1000.0,
+                metricPercentileUs(buckets, timed, maxTicks, 0.50, nsPerTick),
+                metricPercentileUs(buckets, timed, maxTicks, 0.90, nsPerTick),
+                metricPercentileUs(buckets, timed, maxTicks, 0.99, nsPerTick),
+                metricPercentileUs(buckets, timed, maxTicks, 0.999, nsPerTick),
+                (double)maxTicks * nsPerTick / 1000.0, seconds > 0 ? count / seconds : 0.0);
+    }
+    fprintf(fp, "\nbucket,op,from_ns,to_ns,count\n");
+    for (int op = 0; op < METRIC_OPS; op++) {
+        long long buckets[METRIC_BUCKETS];
+        long long count, totalTicks, maxTicks;
+        metricCollect((MetricOp)op, buckets, &count, &totalTicks, &maxTicks);
+        for (int b = 0; b < METRIC_BUCKETS; b++) {
+            if (buckets[b] == 0) continue;
+            long long width;
+            long long floor = metricBucketFloor(b, &width);
+            fprintf(fp, "bucket,%s,%.0f,%.0f,%lld\n", metricNames[op], floor * nsPerTick,
+                    (floor + width) * nsPerTick, buckets[b]);
+        }
+    }
+    return fclose(fp) == 0;
+}
+
+// ---------------- Transaction Journal ----------------
+// Mutations append a small binary record to JOURNALFILE instead of
+// rewriting the whole inventory file. Records are buffered and committed
+// (write + fsync) in groups. After JOURNAL_CHECKPOINT_RECORDS records a
+// checkpoint is due: journalTick writes a fresh snapshot (SNAPSHOTFILE)
+// and resets the journal. On startup the snapshot is loaded and the
+// journal replayed on top of it.
+//
+// Quantity changes are journaled as deltas (JOURNAL_ADJUST) so records from
+// concurrent transactions commute; every record has an LSN and replay skips
+// anything the snapshot already covers. The journal mutex is always taken
+// after inventoryLock, never before.
+
+#define JOURNAL_MAGIC "INVJRNL2"
+#define JOURNAL_MAGIC_V1 "INVJRNL1"    // Before reorder levels: ADD records carry none
+
+typedef enum {
+    JOURNAL_ADD = 1,
+    JOURNAL_DELETE,
+    JOURNAL_SET_QTY,        // Absolute quantity (older journals only)
+    JOURNAL_ADJUST,         // Quantity delta
+    JOURNAL_SET_REORDER     // New reorder level (in `quantity`)
+} JournalOp;
+
+typedef struct {
+    unsigned int checksum;      // FNV-1a over the record after this field
+    unsigned short length;      // Total record length, name included
+    unsigned char op;           // JournalOp
+    unsigned char type;         // ProductType (JOURNAL_ADD)
+    unsigned long long lsn;     // Log sequence number
+    int id;
+    int quantity;
+    float price;
+    int reorderLevel;           // JOURNAL_ADD
+} JournalRecord;                // JOURNAL_ADD records are followed by the name bytes
+
+unsigned int fnv1a(const void* data, size_t len, unsigned int h) {
+    const unsigned char* b = data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= b[i];
+        h *= 16777619U;
+    }
+    return h;
+}
+
+// Writes out buffered records and fsyncs them. Caller holds journalMutex.
+void journalCommitLocked(Inventory* inv) {
+    if (inv->journalFp == NULL || inv->journalPending == 0) return;
+    
+    long long t0 = metricStart();
+    if (inv->journalBufLen > 0) {
+        fwrite(inv->journalBuf, 1, inv->journalBufLen, inv->journalFp);
+        inv->journalBufLen = 0;
+    }
+    if (syncFile(inv->journalFp) != 0) printf("Error syncing journal!\n");
+    inv->journalPending = 0;
+    metricRecord(METRIC_JOURNAL, t0);
+}
+
+void journalCommit(Inventory* inv) {
+    pthread_mutex_lock(&inv->journalMutex);
+    journalCommitLocked(inv);
+    pthread_mutex_unlock(&inv->journalMutex);
+}
+
+// Commits and closes the journal, e.g. before loading the store again.
+void journalClose(Inventory* inv) {
+    pthread_mutex_lock(&inv->journalMutex);
+    journalCommitLocked(inv);
+    if (inv->journalFp) fclose(inv->journalFp);
+    inv->journalFp = NULL;
+    pthread_mutex_unlock(&inv->journalMutex);
+}
+
+// Starts an empty journal. Caller holds journalMutex or is single-threaded.
+void journalReset(Inventory* inv) {
+    if (inv->journalFp) fclose(inv->journalFp);
+    inv->journalFp = fopen(inv->journalPath, "wb");
+    if (inv->journalFp == NULL) {
+        printf("Error opening journal!\n");
+        return;
+    }
+    fwrite(JOURNAL_MAGIC, 1, 8, inv->journalFp);
+    syncFile(inv->journalFp);
+    inv->journalBufLen = 0;
+    inv->journalPending = 0;
+    inv->journalRecordCount = 0;
+}
+
+// Folds the journal into a new snapshot and starts an empty journal.
+// Holds the store exclusively so the snapshot matches its LSN exactly.
+// Returns 0 if the snapshot couldn't be written (the journal is kept).
+int journalCheckpoint(Inventory* inv) {
+    pthread_rwlock_wrlock(&inv->inventoryLock);
+    pthread_mutex_lock(&inv->journalMutex);
+    journalCommitLocked(inv);
+    int saved = saveInventory(inv);
+    if (saved) journalReset(inv);
+    ledgerCheckpoint(inv);
+    lotCheckpoint(inv);
+    inv->journalCheckpointDue = 0;
+    pthread_mutex_unlock(&inv->journalMutex);
+    pthread_rwlock_unlock(&inv->inventoryLock);
+    return saved;
+}
+
+// Appends one record. `quantity` is the product's quantity for JOURNAL_ADD
+// and the delta for JOURNAL_ADJUST.
+void journalWrite(Inventory* inv, JournalOp op, const Product* p, int quantity) {
+    JournalRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    size_t nameLen = (op == JOURNAL_ADD) ? strlen(p->name) : 0;
+
+    rec.length = (unsigned short)(sizeof(rec) + nameLen);
+    rec.op = (unsigned char)op;
+    rec.type = (unsigned char)p->type;
+    rec.id = p->id;
+    rec.quantity = quantity;
+    rec.price = p->price;
+    rec.reorderLevel = p->reorderLevel;
+
+    pthread_mutex_lock(&inv->journalMutex);
+    rec.lsn = ++inv->journalLsn;
+    unsigned int h = fnv1a((const char*)&rec + sizeof(rec.checksum), sizeof(rec) - sizeof(rec.checksum), 2166136261U);
+    rec.checksum = fnv1a(p->name, nameLen, h);
+
+    if (inv->journalFp == NULL) {
+        pthread_mutex_unlock(&inv->journalMutex);
+        return;
+    }
+    if (inv->journalBufLen + rec.length > sizeof(inv->journalBuf)) {
+        fwrite(inv->journalBuf, 1, inv->journalBufLen, inv->journalFp);
+        inv->journalBufLen = 0;
+    }
+    memcpy(inv->journalBuf + inv->journalBufLen, &rec, sizeof(rec));
+    memcpy(inv->journalBuf + inv->journalBufLen + sizeof(rec), p->name, nameLen);
+    inv->journalBufLen += rec.length;
+
+    if (inv->journalPending++ == 0) inv->journalOldestPendingMs = nowMs();
+    inv->journalRecordCount++;
+
+    if (inv->journalAutoCommit && inv->journalPending >= JOURNAL_GROUP_COMMIT) journalCommitLocked(inv);
+    if (inv->journalAutoCommit && inv->journalRecordCount >= JOURNAL_CHECKPOINT_RECORDS) inv->journalCheckpointDue = 1;
+    pthread_mutex_unlock(&inv->journalMutex);
+}
+
+void journalAppend(Inventory* inv, JournalOp op, const Product* p) {
+    journalWrite(inv, op, p, p->quantity);
+}
+
+void journalAppendAdjust(Inventory* inv, const Product* p, int delta) {
+    journalWrite(inv, JOURNAL_ADJUST, p, delta);
+}
+
+// Called once per frame: runs a due checkpoint, or commits a group that has
+// waited long enough. Must not be called with inventoryLock held. Returns 1
+// while records are still waiting, i.e. the caller must keep ticking.
+int journalTick(Inventory* inv) {
+    if (inv->journalCheckpointDue) {
+        journalCheckpoint(inv);
+        return 0;
+    }
+    pthread_mutex_lock(&inv->journalMutex);
+    if (inv->journalPending > 0 && nowMs() - inv->journalOldestPendingMs >= JOURNAL_COMMIT_MS) {
+        journalCommitLocked(inv);
+    }
+    int waiting = inv->journalPending > 0;
+    pthread_mutex_unlock(&inv->journalMutex);
+    return waiting;
+}
+
+// Applies one replayed record to the in-memory store.
+void journalApply(Inventory* inv, const JournalRecord* rec, const char* name, size_t nameLen, int version) {
+    int pos = indexFind(inv, rec->id);
+
+    if (rec->op == JOURNAL_ADD) {
+        if (pos < 0) {
+            Product blank;
+            memset(&blank, 0, sizeof(blank));
+            blank.id = rec->id;
+            pos = storeAppend(inv, &blank);
+            if (pos < 0) return;
+        }
+        Product* p = &inv->products[pos];
+        p->id = rec->id;
+        if (nameLen >= sizeof(p->name)) nameLen = sizeof(p->name) - 1;
+        memcpy(p->name, name, nameLen);
+        p->name[nameLen] = '\0';
+        p->quantity = rec->quantity;
+        p->price = rec->price;
+        p->type = (ProductType)rec->type;
+        p->reorderLevel = version >= 2 ? rec->reorderLevel : LOW_STOCK_THRESHOLD;
+    } else if (rec->op == JOURNAL_SET_REORDER) {
+        if (pos >= 0) inv->products[pos].reorderLevel = rec->quantity;
+    } else if (rec->op == JOURNAL_SET_QTY) {
+        if (pos >= 0) inv->products[pos].quantity = rec->quantity;
+    } else if (rec->op == JOURNAL_ADJUST) {
+        if (pos >= 0) inv->products[pos].quantity += rec->quantity;
+    } else if (rec->op == JOURNAL_DELETE) {
+        if (pos >= 0) storeRemoveAt(inv, pos);
+    }
+}
+
+// Replays JOURNALFILE over the loaded snapshot. Returns 1 if the journal
+// is missing, from an older version, or ended in a torn/corrupt record
+// (the tail is dropped); the caller then starts a fresh one.
+int journalReplay(Inventory* inv) {
+    FILE* fp = fopen(inv->journalPath, "rb");
+    if (fp == NULL) return 1;
+
+    char magic[8];
+    int version = 0;
+    if (fread(magic, 1, 8, fp) == 8) {
+        if (memcmp(magic, JOURNAL_MAGIC, 8) == 0) version = 2;
+        else if (memcmp(magic, JOURNAL_MAGIC_V1, 8) == 0) version = 1;
+    }
+    if (version == 0) {
+        fclose(fp);
+        return 1;
+    }
+
+    JournalRecord rec;
+    char name[256];
+    long good = ftell(fp);
+    while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+        size_t nameLen = rec.length >= sizeof(rec) ? rec.length - sizeof(rec) : sizeof(name);
+        if (nameLen >= sizeof(name) || fread(name, 1, nameLen, fp) != nameLen) break;
+
+        unsigned int h = fnv1a((const char*)&rec + sizeof(rec.checksum), sizeof(rec) - sizeof(rec.checksum), 2166136261U);
+        if (fnv1a(name, nameLen, h) != rec.checksum) break;
+
+        if (rec.lsn > inv->snapshotLsn) journalApply(inv, &rec, name, nameLen, version);
+        if (rec.lsn > inv->journalLsn) inv->journalLsn = rec.lsn;
+        inv->journalRecordCount++;
+        good = ftell(fp);
+    }
+
+    fseek(fp, 0, SEEK_END);
+    int torn = (ftell(fp) != good);
+    fclose(fp);
+    return torn || version < 2;
+}
+
+// ---------------- Stock Ledger ----------------
+// Every quantity change (add, delete, sale, purchase, stock update,
+// transfer, import) is appended to LEDGERFILE as a movement: time, product
+// id, signed delta and why. Movements are written in blocks of up to
+// LEDGER_BLOCK, each stored column by column: time deltas, id deltas and
+// quantity deltas as zigzag varints, then one kind byte each. A typical
+// movement takes 4-6 bytes. Blocks carry a checksum and end with a trailer
+// so a torn last block is found by looking only at the end of the file.
+//
+// The buffered block is written when full and at every journal checkpoint
+// (with an fsync); a crash can lose that block's history but never the
+// stock itself, which the journal keeps. Whatever the ledger missed is
+// recorded as a MOVE_BASE movement when the ledger is opened.
+//
+// After every LEDGER_CHECKPOINT_BLOCKS data blocks (or later, while the
+// checkpoint would outweigh the blocks since the last one) a checkpoint
+// block follows: the running quantity of every product the ledger has
+// seen, ids ascending. LEDGERINDEXFILE lists every block with its time
+// range and the checkpoint it builds on, one fixed-size entry each. So a
+// query binary-searches the entries, reads one checkpoint and decodes only
+// the blocks after it, and opening the ledger reads just the newest
+// checkpoint and what follows it - never the whole history.
+
+#define LEDGER_MAGIC "INVLEDG1"
+#define LEDGER_BLOCK_MAGIC 0x4B4C424CU         // "LBLK"
+#define LEDGER_CHECKPOINT_MAGIC 0x504B434CU    // "LCKP"
+
+// A checkpoint has no time column or kinds: count is the number of
+// products, deltaBytes the quantity column and firstTime when it was taken.
+typedef struct {
+    unsigned int magic;
+    unsigned int count;         // Movements in the block
+    unsigned int timeBytes;     // Column sizes, in order
+    unsigned int idBytes;
+    unsigned int deltaBytes;
+    unsigned int checksum;      // FNV-1a over the columns
+    long long firstTime;        // ms since the epoch; the time column starts from here
+} LedgerBlockHeader;
+
+typedef struct {
+    unsigned int blockBytes;    // Header + columns + trailer
+    unsigned int magic;         // The block's
+} LedgerBlockTrailer;
+
+// One block as listed in LEDGERINDEXFILE
+typedef struct {
+    long long offset;           // Where the block starts in LEDGERFILE
+    long long firstTime;        // A checkpoint's time, for both
+    long long lastTime;
+    int checkpoint;             // Entry of the checkpoint the block builds on (its own for one), -1 = none
+    unsigned int bytes;         // Header + columns + trailer
+} LedgerIndexEntry;
+
+size_t putVarint(unsigned char* out, unsigned long long v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (unsigned char)v;
+    return n;
+}
+
+// Returns 0 if the varint runs past end.
+int getVarint(const unsigned char** p, const unsigned char* end, unsigned long long* v) {
+    unsigned long long r = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+        unsigned char b = *(*p)++;
+        r |= (unsigned long long)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = r;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+unsigned long long zigzag(long long v) {
+    return ((unsigned long long)v << 1) ^ (unsigned long long)(v >> 63);
+}
+
+long long unzigzag(unsigned long long v) {
+    return (long long)(v >> 1) ^ -(long long)(v & 1);
+}
+
+// Walks the movements of a block read by ledgerReadBlock. In a checkpoint
+// the delta is the product's quantity and every time is the checkpoint's.
+typedef struct {
+    const unsigned char* tp;
+    const unsigned char* tend;
+    const unsigned char* ip;
+    const unsigned char* iend;
+    const unsigned char* dp;
+    const unsigned char* dend;
+    long long t;
+    long long id;
+    unsigned int left;
+} LedgerCursor;
+
+void ledgerCursorInit(LedgerCursor* c, const LedgerBlockHeader* hdr, const unsigned char* cols) {
+    c->tp = cols;
+    c->tend = c->ip = cols + hdr->timeBytes;
+    c->iend = c->dp = c->ip + hdr->idBytes;
+    c->dend = c->dp + hdr->deltaBytes;
+    c->t = hdr->firstTime;
+    c->id = 0;
+    c->left = hdr->count;
+}
+
+// Returns 0 past the last movement (or at a bad varint).
+int ledgerNext(LedgerCursor* c, long long* t, int* id, int* delta) {
+    unsigned long long dt = 0, did, d;
+    if (c->left == 0 || (c->tp < c->tend && !getVarint(&c->tp, c->tend, &dt)) ||
+        !getVarint(&c->ip, c->iend, &did) || !getVarint(&c->dp, c->dend, &d)) return 0;
+    c->left--;
+    c->t += (long long)dt;
+    c->id += unzigzag(did);
+    *t = c->t;
+    *id = (int)c->id;
+    *delta = (int)unzigzag(d);
+    return 1;
+}
+
+// Moves a product's running ledger quantity (ledgerMutex held). Out of
+// memory the totals are incomplete, so checkpoints stop until reopening.
+void ledgerTrack(Inventory* inv, int id, int delta) {
+    int slot = idMapGet(&inv->ledgerIds, id);
+    if (slot < 0) {
+        if (inv->ledgerQtyCount == inv->ledgerQtyCapacity) {
+            int newCap = inv->ledgerQtyCapacity ? inv->ledgerQtyCapacity * 2 : 1024;
+            QtyEntry* grown = realloc(inv->ledgerQty, (size_t)newCap * sizeof(QtyEntry));
+            if (grown == NULL) {
+                inv->ledgerQtyLost = 1;
+                return;
+            }
+            inv->ledgerQty = grown;
+            inv->ledgerQtyCapacity = newCap;
+        }
+        slot = inv->ledgerQtyCount++;
+        inv->ledgerQty[slot].id = id;
+        inv->ledgerQty[slot].quantity = 0;
+        idMapPut(&inv->ledgerIds, id, slot);
+    }
+    inv->ledgerQty[slot].quantity += delta;
+}
+
+// Appends a block and its index entry (ledgerMutex held). Returns 0 if
+// the block couldn't be written. Without an index entry a block is still
+// in the ledger; the next open lists it.
+int ledgerWriteBlock(Inventory* inv, LedgerBlockHeader* hdr, const unsigned char* cols, size_t len, long long lastTime) {
+    hdr->checksum = fnv1a(cols, len, 2166136261U);
+    LedgerBlockTrailer trailer = { (unsigned int)(sizeof(*hdr) + len + sizeof(trailer)), hdr->magic };
+    long offset = ftell(inv->ledgerFp);
+    if (offset < 0 || fwrite(hdr, sizeof(*hdr), 1, inv->ledgerFp) != 1 ||
+        fwrite(cols, 1, len, inv->ledgerFp) != len ||
+        fwrite(&trailer, sizeof(trailer), 1, inv->ledgerFp) != 1 || fflush(inv->ledgerFp) != 0) {
+        printf("Error writing ledger!\n");
+        return 0;
+    }
+    if (inv->ledgerIndexFp == NULL) return 1;
+    LedgerIndexEntry e = {
+        .offset = offset,
+        .firstTime = hdr->firstTime,
+        .lastTime = lastTime,
+        .checkpoint = hdr->magic == LEDGER_CHECKPOINT_MAGIC ? inv->ledgerEntries : inv->ledgerLastCheckpoint,
+        .bytes = trailer.blockBytes
+    };
+    if (fwrite(&e, sizeof(e), 1, inv->ledgerIndexFp) != 1 || fflush(inv->ledgerIndexFp) != 0) {
+        // Stop indexing: queries see the blocks listed so far
+        printf("Error writing ledger index!\n");
+        fclose(inv->ledgerIndexFp);
+        inv->ledgerIndexFp = NULL;
+        return 1;
+    }
+    inv->ledgerEntries++;
+    return 1;
+}
+
+int qtyEntryIdCompare(const void* a, const void* b) {
+    int x = ((const QtyEntry*)a)->id, y = ((const QtyEntry*)b)->id;
+    return (x > y) - (x < y);
+}
+
+// Writes every running quantity as a checkpoint (ledgerMutex held, nothing
+// buffered). O(products), at most once per LEDGER_CHECKPOINT_BLOCKS blocks.
+void ledgerWriteCheckpointLocked(Inventory* inv) {
+    int n = inv->ledgerQtyCount;
+    if (n == 0 || inv->ledgerQtyLost || inv->ledgerFp == NULL || inv->ledgerIndexFp == NULL) return;
+    QtyEntry* sorted = malloc((size_t)n * sizeof(QtyEntry));
+    // Worst case 5 bytes per id and quantity
+    unsigned char* cols = sorted != NULL ? malloc((size_t)n * 10) : NULL;
+    if (cols == NULL) {
+        free(sorted);
+        return;
+    }
+    memcpy(sorted, inv->ledgerQty, (size_t)n * sizeof(QtyEntry));
+    qsort(sorted, (size_t)n, sizeof(QtyEntry), qtyEntryIdCompare);
+
+    LedgerBlockHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = LEDGER_CHECKPOINT_MAGIC;
+    hdr.count = (unsigned int)n;
+    hdr.firstTime = inv->ledgerLastMs;
+    size_t len = 0;
+    int prevId = 0;
+    for (int i = 0; i < n; i++) {
+        len += putVarint(cols + len, zigzag((long long)sorted[i].id - prevId));
+        prevId = sorted[i].id;
+    }
+    hdr.idBytes = (unsigned int)len;
+    for (int i = 0; i < n; i++) len += putVarint(cols + len, zigzag(sorted[i].quantity));
+    hdr.deltaBytes = (unsigned int)len - hdr.idBytes;
+    int entry = inv->ledgerEntries;
+    if (ledgerWriteBlock(inv, &hdr, cols, len, hdr.firstTime) && inv->ledgerEntries > entry) {
+        inv->ledgerLastCheckpoint = entry;
+        inv->ledgerBlocksSince = 0;
+        inv->ledgerBytesSince = 0;
+        inv->ledgerCheckpointBytes = (long long)(sizeof(hdr) + len + sizeof(LedgerBlockTrailer));
+    }
+    free(cols);
+    free(sorted);
+}
+
+// Encodes the buffered movements as one block and appends it, followed by
+// a checkpoint when one is due (ledgerMutex held).
+void ledgerFlushLocked(Inventory* inv) {
+    int n = inv->ledgerBufLen;
+    if (n <= 0 || inv->ledgerFp == NULL) return;
+    // Worst case 10 bytes per time, 5 per id and delta, 1 per kind
+    unsigned char* cols = malloc((size_t)n * 21);
+    if (cols == NULL) return;
+    LedgerBlockHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = LEDGER_BLOCK_MAGIC;
+    hdr.count = (unsigned int)n;
+    hdr.firstTime = inv->ledgerBufTime[0];
+
+    size_t len = 0;
+    long long prevTime = hdr.firstTime;
+    for (int i = 0; i < n; i++) {
+        len += putVarint(cols + len, (unsigned long long)(inv->ledgerBufTime[i] - prevTime));
+        prevTime = inv->ledgerBufTime[i];
+    }
+    hdr.timeBytes = (unsigned int)len;
+    int prevId = 0;
+    for (int i = 0; i < n; i++) {
+        len += putVarint(cols + len, zigzag((long long)inv->ledgerBufId[i] - prevId));
+        prevId = inv->ledgerBufId[i];
+    }
+    hdr.idBytes = (unsigned int)len - hdr.timeBytes;
+    for (int i = 0; i < n; i++) len += putVarint(cols + len, zigzag(inv->ledgerBufDelta[i]));
+    hdr.deltaBytes = (unsigned int)len - hdr.timeBytes - hdr.idBytes;
+    memcpy(cols + len, inv->ledgerBufKind, (size_t)n);
+    len += (size_t)n;
+
+    if (ledgerWriteBlock(inv, &hdr, cols, len, inv->ledgerBufTime[n - 1])) {
+        inv->ledgerBlocksSince++;
+        inv->ledgerBytesSince += (long long)(sizeof(hdr) + len + sizeof(LedgerBlockTrailer));
+    }
+    free(cols);
+    inv->ledgerBufLen = 0;
+    if (inv->ledgerBlocksSince >= LEDGER_CHECKPOINT_BLOCKS && inv->ledgerBytesSince >= inv->ledgerCheckpointBytes) {
+        ledgerWriteCheckpointLocked(inv);
+    }
+}
+
+// Records a quantity change. Callers hold inventoryLock, so a change is
+// in the ledger before anyone can observe the next one.
+void ledgerRecordLocked(Inventory* inv, int id, int delta, MovementKind kind) {
+    long long t = wallMs();
+    if (t < inv->ledgerLastMs) t = inv->ledgerLastMs;
+    inv->ledgerLastMs = t;
+    int i = inv->ledgerBufLen++;
+    inv->ledgerBufTime[i] = t;
+    inv->ledgerBufId[i] = id;
+    inv->ledgerBufDelta[i] = delta;
+    inv->ledgerBufKind[i] = (unsigned char)kind;
+    ledgerTrack(inv, id, delta);
+    if (inv->ledgerBufLen == LEDGER_BLOCK) ledgerFlushLocked(inv);
+}
+
+// Ledger kind for a stock change logged as `action`.
+MovementKind movementKind(LogAction action) {
+    switch (action) {
+        case LOG_SALE: return MOVE_SALE;
+        case LOG_PURCHASE: return MOVE_PURCHASE;
+        case LOG_TRANSFER_OUT: return MOVE_TRANSFER_OUT;
+        case LOG_TRANSFER_IN: return MOVE_TRANSFER_IN;
+        case LOG_PRODUCE: return MOVE_PRODUCE;
+        case LOG_CONSUME: return MOVE_CONSUME;
+        default: return MOVE_UPDATE;
+    }
+}
+
+void ledgerRecord(Inventory* inv, int id, int delta, MovementKind kind) {
+    pthread_mutex_lock(&inv->ledgerMutex);
+    // No ledger file = in-memory only (stress test): nothing to record
+    if (inv->ledgerFp != NULL) ledgerRecordLocked(inv, id, delta, kind);
+    pthread_mutex_unlock(&inv->ledgerMutex);
+}
+
+// Writes the buffered block and syncs the files (called with every journal checkpoint).
+void ledgerCheckpoint(Inventory* inv) {
+    pthread_mutex_lock(&inv->ledgerMutex);
+    ledgerFlushLocked(inv);
+    if (inv->ledgerFp != NULL) syncFile(inv->ledgerFp);
+    if (inv->ledgerIndexFp != NULL) syncFile(inv->ledgerIndexFp);
+    pthread_mutex_unlock(&inv->ledgerMutex);
+}
+
+// Flushes and closes the ledger and forgets the running quantities;
+// ledgerOpen reads them back.
+void ledgerClose(Inventory* inv) {
+    pthread_mutex_lock(&inv->ledgerMutex);
+    ledgerFlushLocked(inv);
+    if (inv->ledgerFp) fclose(inv->ledgerFp);
+    if (inv->ledgerIndexFp) fclose(inv->ledgerIndexFp);
+    inv->ledgerFp = inv->ledgerIndexFp = NULL;
+    inv->ledgerEntries = inv->ledgerBlocksSince = 0;
+    inv->ledgerLastCheckpoint = -1;
+    inv->ledgerBytesSince = inv->ledgerCheckpointBytes = 0;
+    inv->ledgerQtyCount = 0;
+    inv->ledgerQtyLost = 0;
+    free(inv->ledgerIds.slots);
+    memset(&inv->ledgerIds, 0, sizeof(inv->ledgerIds));
+    pthread_mutex_unlock(&inv->ledgerMutex);
+}
+
+// Reads the block (data or checkpoint) at the current position. Returns
+// the columns (caller frees) or NULL at the end of the valid part of the file.
+unsigned char* ledgerReadBlock(FILE* fp, LedgerBlockHeader* hdr, size_t* len) {
+    LedgerBlockTrailer trailer;
+    if (fread(hdr, sizeof(*hdr), 1, fp) != 1 || hdr->count == 0) return NULL;
+    if (hdr->magic == LEDGER_BLOCK_MAGIC) {
+        if (hdr->count > LEDGER_BLOCK) return NULL;
+        *len = (size_t)hdr->timeBytes + hdr->idBytes + hdr->deltaBytes + hdr->count;
+        if (*len > (size_t)hdr->count * 21) return NULL;
+    } else if (hdr->magic == LEDGER_CHECKPOINT_MAGIC) {
+        if (hdr->timeBytes != 0) return NULL;
+        *len = (size_t)hdr->idBytes + hdr->deltaBytes;
+        if (*len > (size_t)hdr->count * 10) return NULL;
+    } else {
+        return NULL;
+    }
+    unsigned char* cols = malloc(*len);
+    if (cols == NULL) return NULL;
+    if (fread(cols, 1, *len, fp) != *len || fread(&trailer, sizeof(trailer), 1, fp) != 1 ||
+        trailer.magic != hdr->magic || trailer.blockBytes != sizeof(*hdr) + *len + sizeof(trailer) ||
+        fnv1a(cols, *len, 2166136261U) != hdr->checksum) {
+        free(cols);
+        return NULL;
+    }
+    return cols;
+}
+
+int ledgerReadEntry(FILE* idx, int k, LedgerIndexEntry* e) {
+    return fseek(idx, (long)k * (long)sizeof(*e), SEEK_SET) == 0 && fread(e, sizeof(*e), 1, idx) == 1;
+}
+
+// Reads the block an index entry lists (see ledgerReadBlock).
+unsigned char* ledgerReadEntryBlock(FILE* fp, const LedgerIndexEntry* e, LedgerBlockHeader* hdr, size_t* len) {
+    if (fseek(fp, (long)e->offset, SEEK_SET) != 0) return NULL;
+    return ledgerReadBlock(fp, hdr, len);
+}
+
+// Opens LEDGERINDEXFILE so it lists exactly the blocks in the first `good`
+// bytes of the ledger (ledgerMutex held): entries that don't chain on from
+// the previous one are dropped, and blocks after the last good entry are
+// read and listed (after a crash, or for a ledger older than the index).
+void ledgerIndexOpenLocked(Inventory* inv, long good) {
+    FILE* idx = fopen(inv->ledgerIndexPath, "r+b");
+    if (idx == NULL) idx = fopen(inv->ledgerIndexPath, "w+b");
+    if (idx == NULL) {
+        printf("Error opening ledger index!\n");
+        return;
+    }
+    inv->ledgerBlocksSince = 0;
+    inv->ledgerBytesSince = inv->ledgerCheckpointBytes = 0;
+    LedgerIndexEntry e;
+    long long next = 8;
+    long long lastTime = 0;
+    int count = 0, checkpoint = -1;
+    while (fread(&e, sizeof(e), 1, idx) == 1 && e.offset == next && e.bytes > 0 && e.offset + e.bytes <= good &&
+           (count == 0 || e.firstTime >= lastTime) && e.lastTime >= e.firstTime &&
+           (e.checkpoint == count || e.checkpoint == checkpoint)) {
+        if (e.checkpoint == count) {
+            checkpoint = count;
+            inv->ledgerBlocksSince = 0;
+            inv->ledgerBytesSince = 0;
+            inv->ledgerCheckpointBytes = e.bytes;
+        } else {
+            inv->ledgerBlocksSince++;
+            inv->ledgerBytesSince += e.bytes;
+        }
+        next += e.bytes;
+        lastTime = e.lastTime;
+        count++;
+    }
+
+    FILE* fp = next < good ? fopen(inv->ledgerPath, "rb") : NULL;
+    if (fp != NULL && fseek(fp, (long)next, SEEK_SET) == 0) {
+        LedgerBlockHeader hdr;
+        size_t len;
+        unsigned char* cols;
+        while (next < good && (cols = ledgerReadBlock(fp, &hdr, &len)) != NULL) {
+            long long t = hdr.firstTime;
+            int id, delta;
+            LedgerCursor c;
+            ledgerCursorInit(&c, &hdr, cols);
+            while (hdr.magic == LEDGER_BLOCK_MAGIC && ledgerNext(&c, &t, &id, &delta)) {}
+            free(cols);
+            int isCheckpoint = hdr.magic == LEDGER_CHECKPOINT_MAGIC;
+            e = (LedgerIndexEntry){
+                .offset = next,
+                .firstTime = hdr.firstTime,
+                .lastTime = t,
+                .checkpoint = isCheckpoint ? count : checkpoint,
+                .bytes = (unsigned int)(sizeof(hdr) + len + sizeof(LedgerBlockTrailer))
+            };
+            if (fseek(idx, (long)count * (long)sizeof(e), SEEK_SET) != 0 || fwrite(&e, sizeof(e), 1, idx) != 1) break;
+            if (isCheckpoint) {
+                checkpoint = count;
+                inv->ledgerBlocksSince = 0;
+                inv->ledgerBytesSince = 0;
+                inv->ledgerCheckpointBytes = e.bytes;
+            } else {
+                inv->ledgerBlocksSince++;
+                inv->ledgerBytesSince += e.bytes;
+            }
+            next += e.bytes;
+            lastTime = t;
+            count++;
+        }
+    }
+    if (fp != NULL) fclose(fp);
+
+    fflush(idx);
+    if (ftruncate(fileno(idx), (long)count * (long)sizeof(e)) != 0) printf("Error truncating ledger index!\n");
+    fseek(idx, 0, SEEK_END);
+    inv->ledgerIndexFp = idx;
+    inv->ledgerEntries = count;
+    inv->ledgerLastCheckpoint = checkpoint;
+    if (lastTime > inv->ledgerLastMs) inv->ledgerLastMs = lastTime;
+}
+
+// Running quantities as of the end of the ledger: the newest checkpoint
+// plus the blocks after it (ledgerMutex held).
+void ledgerTotalsLoadLocked(Inventory* inv) {
+    idMapClear(&inv->ledgerIds, inv->productCount);
+    inv->ledgerQtyCount = 0;
+    inv->ledgerQtyLost = 0;
+    FILE* fp = fopen(inv->ledgerPath, "rb");
+    if (fp == NULL || inv->ledgerIndexFp == NULL) {
+        if (fp != NULL) fclose(fp);
+        return;
+    }
+    for (int k = inv->ledgerLastCheckpoint >= 0 ? inv->ledgerLastCheckpoint : 0; k < inv->ledgerEntries; k++) {
+        LedgerIndexEntry e;
+        LedgerBlockHeader hdr;
+        size_t len;
+        unsigned char* cols = ledgerReadEntry(inv->ledgerIndexFp, k, &e) ? ledgerReadEntryBlock(fp, &e, &hdr, &len) : NULL;
+        if (cols == NULL) {
+            // Listed but unreadable: totals would be wrong, so no checkpoints this time
+            inv->ledgerQtyLost = 1;
+            break;
+        }
+        LedgerCursor c;
+        ledgerCursorInit(&c, &hdr, cols);
+        long long t;
+        int id, delta;
+        while (ledgerNext(&c, &t, &id, &delta)) ledgerTrack(inv, id, delta);
+        free(cols);
+    }
+    fclose(fp);
+    fseek(inv->ledgerIndexFp, 0, SEEK_END);
+}
+
+// Opens the ledger for appending, creating it if needed, with its index
+// and running quantities, then records a MOVE_BASE for every product whose
+// ledger quantity differs from the store (history from before the ledger
+// existed, or a block lost in a crash). Normally only the last block is
+// checked; if it is torn, the file is scanned and cut after the last good
+// block. Called while loading, before anyone else uses the store.
+void ledgerOpen(Inventory* inv) {
+    FILE* fp = fopen(inv->ledgerPath, "rb");
+    long size = 0, good = 0;
+    if (fp != NULL) {
+        char magic[8];
+        fseek(fp, 0, SEEK_END);
+        size = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        if (size >= 8 && fread(magic, 1, 8, fp) == 8 && memcmp(magic, LEDGER_MAGIC, 8) == 0) {
+            good = 8;
+            LedgerBlockTrailer trailer;
+            LedgerBlockHeader hdr;
+            size_t len;
+            unsigned char* cols = NULL;
+            if (size >= 8 + (long)sizeof(trailer) && fseek(fp, size - (long)sizeof(trailer), SEEK_SET) == 0 &&
+                fread(&trailer, sizeof(trailer), 1, fp) == 1 &&
+                (trailer.magic == LEDGER_BLOCK_MAGIC || trailer.magic == LEDGER_CHECKPOINT_MAGIC) &&
+                (long)trailer.blockBytes <= size - 8 && fseek(fp, size - (long)trailer.blockBytes, SEEK_SET) == 0) {
+                cols = ledgerReadBlock(fp, &hdr, &len);
+            }
+            if (cols != NULL || size == 8) {
+                good = size;
+            } else {
+                fseek(fp, 8, SEEK_SET);
+                while ((cols = ledgerReadBlock(fp, &hdr, &len)) != NULL) {
+                    free(cols);
+                    good = ftell(fp);
+                }
+            }
+            free(cols);
+        } else if (size > 0) {
+            printf("Error: %s is not a ledger, starting a new one!\n", inv->ledgerPath);
+        }
+        fclose(fp);
+    }
+
+    pthread_mutex_lock(&inv->ledgerMutex);
+    inv->ledgerFp = fopen(inv->ledgerPath, good > 0 ? "r+b" : "wb");
+    if (inv->ledgerFp == NULL) {
+        printf("Error opening ledger!\n");
+        pthread_mutex_unlock(&inv->ledgerMutex);
+        return;
+    } else if (good == 0) {
+        fwrite(LEDGER_MAGIC, 1, 8, inv->ledgerFp);
+        fflush(inv->ledgerFp);
+        good = 8;
+    } else {
+        if (good < size) {
+            fflush(inv->ledgerFp);
+            if (ftruncate(fileno(inv->ledgerFp), good) != 0) printf("Error truncating ledger!\n");
+        }
+        fseek(inv->ledgerFp, 0, SEEK_END);
+    }
+    ledgerIndexOpenLocked(inv, good);
+    ledgerTotalsLoadLocked(inv);
+    // A ledger older than its checkpoints gets one now, so later opens are short
+    if (inv->ledgerBlocksSince >= LEDGER_CHECKPOINT_BLOCKS && inv->ledgerBytesSince >= inv->ledgerCheckpointBytes) {
+        ledgerWriteCheckpointLocked(inv);
+    }
+
+    for (int i = 0; i < inv->productCount; i++) {
+        const Product* p = &inv->products[i];
+        int slot = idMapGet(&inv->ledgerIds, p->id);
+        int known = slot >= 0 ? inv->ledgerQty[slot].quantity : 0;
+        if (known != p->quantity || slot < 0) ledgerRecordLocked(inv, p->id, p->quantity - known, MOVE_BASE);
+    }
+    // Products the ledger still holds stock for but the store no longer has
+    for (int i = 0; i < inv->ledgerQtyCount; i++) {
+        const QtyEntry* q = &inv->ledgerQty[i];
+        if (q->quantity != 0 && indexFind(inv, q->id) < 0) ledgerRecordLocked(inv, q->id, -q->quantity, MOVE_BASE);
+    }
+    pthread_mutex_unlock(&inv->ledgerMutex);
+}
+
+// Quantity of a product at time t (ms since the epoch), i.e. after its
+// last movement at or before t. Returns 0 if it had none by then. Reads
+// the newest checkpoint at or before t and the blocks from there to t,
+// without holding the ledger (or the store) while it does.
+int ledgerQuantityAt(Inventory* inv, int id, long long t, int* qty) {
+    // What is listed and still buffered now; later blocks are all after t or not ours to read
+    pthread_mutex_lock(&inv->ledgerMutex);
+    int entries = inv->ledgerIndexFp != NULL ? inv->ledgerEntries : 0;
+    int found = 0;
+    long long q = 0, buffered = 0;
+    int inBuffer = 0;
+    for (int i = 0; i < inv->ledgerBufLen; i++) {
+        if (inv->ledgerBufId[i] == id && inv->ledgerBufTime[i] <= t) {
+            buffered += inv->ledgerBufDelta[i];
+            inBuffer = 1;
+        }
+    }
+    pthread_mutex_unlock(&inv->ledgerMutex);
+
+    FILE* idx = entries > 0 ? fopen(inv->ledgerIndexPath, "rb") : NULL;
+    FILE* fp = idx != NULL ? fopen(inv->ledgerPath, "rb") : NULL;
+    if (fp != NULL) {
+        // Last block starting at or before t
+        LedgerIndexEntry e;
+        int lo = 0, hi = entries;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (ledgerReadEntry(idx, mid, &e) && e.firstTime <= t) lo = mid + 1;
+            else hi = mid;
+        }
+        int last = lo - 1;
+        if (last >= 0 && ledgerReadEntry(idx, last, &e)) {
+            for (int k = e.checkpoint >= 0 ? e.checkpoint : 0; k <= last; k++) {
+                LedgerIndexEntry b;
+                LedgerBlockHeader hdr;
+                size_t len;
+                unsigned char* cols = ledgerReadEntry(idx, k, &b) ? ledgerReadEntryBlock(fp, &b, &hdr, &len) : NULL;
+                if (cols == NULL) break;
+                LedgerCursor c;
+                ledgerCursorInit(&c, &hdr, cols);
+                long long mt;
+                int mid, delta;
+                if (hdr.magic == LEDGER_CHECKPOINT_MAGIC) {
+                    // Ids ascending
+                    while (ledgerNext(&c, &mt, &mid, &delta) && mid <= id) {
+                        if (mid == id) {
+                            q = delta;
+                            found = 1;
+                        }
+                    }
+                } else {
+                    while (ledgerNext(&c, &mt, &mid, &delta) && mt <= t) {
+                        if (mid == id) {
+                            q += delta;
+                            found = 1;
+                        }
+                    }
+                }
+                free(cols);
+            }
+        }
+    }
+    if (fp != NULL) fclose(fp);
+    if (idx != NULL) fclose(idx);
+
+    if (inBuffer) {
+        q += buffered;
+        found = 1;
+    }
+    if (found) *qty = (int)q;
+    return found;
+}
+
+// Net change of a product's quantity over (from, to].
+long long ledgerNetMovement(Inventory* inv, int id, long long from, long long to) {
+    int before = 0, after = 0;
+    ledgerQuantityAt(inv, id, from, &before);
+    ledgerQuantityAt(inv, id, to, &after);
+    return (long long)after - before;
+}
+
+// ---------------- Stock Lots ----------------
+// A purchase is received as a lot with its own unit cost, receive time and
+// optional expiry date. Stock leaving (sales, transfers out, production,
+// stock-take corrections) is taken first from untracked units, which came
+// in some other way (added, imported, counted, transferred in) and are the
+// oldest, then from the lots: earliest expiry first for dated lots, then
+// the rest in the order they were received. Each product with open lots
+// keeps them in a heap in that order, so taking stock is O(log lots). A
+// production run opens a lot of the finished good at the cost of the
+// components it took.
+//
+// Products are spread over LOT_STRIPES stripes by id. A stripe holds its
+// products' heaps (found through its own IdMap), a lock, and running
+// totals over its lots (units, cost, and the same units at list price), so
+// valuing the stock at cost is O(stripes): the list price value from Stock
+// Statistics, with the lot units swapped from list price to their cost.
+//
+// Transactions stay lock-free for products in a stripe without lots: they
+// change the quantity with a compare-and-swap and check the stripe's
+// `lotted` count before and after. A purchase opens the product's heap
+// (raising `lotted`) before adding its units, so a take that still sees 0
+// afterwards only had untracked units to take from; one that sees lots
+// appear settles under the lock instead (see lotSettleLocked). Products in
+// a stripe with lots take its lock, still changing the quantity with a
+// compare-and-swap since lock-free takes may run alongside.
+//
+// LOTFILE is append-only: "R,id,lot,qty,cost,received,expires" opens a
+// lot, "T,id,lot,qty" takes units from one, "D,id" drops a deleted
+// product's lots. It is buffered and synced at journal checkpoints; a
+// crash can lose its tail, never stock. Loading drops lots of products
+// that are gone, trims lots holding more than the product's quantity (in
+// consumption order), and rewrites the file once used-up lines outnumber
+// open lots.
+//
+// Lots change under inventoryLock shared plus the stripe lock
+// (transactions), or inventoryLock exclusively (add, delete, production,
+// loading).
+
+// A lot as read back from LOTFILE
+typedef struct {
+    int id;
+    int line;           // Where it was received (drops only apply to earlier lots)
+    StockLot lot;
+} LotRecord;
+
+LotStripe* lotStripe(Inventory* inv, int id) {
+    return &inv->lotStripes[hashId(id) & (LOT_STRIPES - 1)];
+}
+
+// Is lot a taken before lot b?
+int lotBefore(const StockLot* a, const StockLot* b) {
+    long long dueA = a->expiresMs > 0 ? a->expiresMs : 0x7fffffffffffffffLL;
+    long long dueB = b->expiresMs > 0 ? b->expiresMs : 0x7fffffffffffffffLL;
+    if (dueA != dueB) return dueA < dueB;
+    return a->lot < b->lot;
+}
+
+int lotCompare(const void* a, const void* b) {
+    return lotBefore(a, b) ? -1 : lotBefore(b, a) ? 1 : 0;
+}
+
+void lotSiftUp(ProductLots* pl, int i) {
+    StockLot e = pl->lots[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!lotBefore(&e, &pl->lots[parent])) break;
+        pl->lots[i] = pl->lots[parent];
+        i = parent;
+    }
+    pl->lots[i] = e;
+}
+
+void lotSiftDown(ProductLots* pl, int i) {
+    StockLot e = pl->lots[i];
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= pl->count) break;
+        if (child + 1 < pl->count && lotBefore(&pl->lots[child + 1], &pl->lots[child])) child++;
+        if (!lotBefore(&pl->lots[child], &e)) break;
+        pl->lots[i] = pl->lots[child];
+        i = child;
+    }
+    pl->lots[i] = e;
+}
+
+// Adds (sign 1) or removes (-1) qty units of a lot from the running totals.
+void lotAccount(LotStripe* st, ProductLots* pl, const StockLot* l, int qty, int sign) {
+    pl->units += sign * qty;
+    st->units += sign * qty;
+    st->costCents += sign * (long long)qty * l->unitCostCents;
+    st->listCents += sign * (long long)qty * pl->priceCents;
+}
+
+// The open lots of product `id`, created empty if `create` is set.
+ProductLots* lotProduct(LotStripe* st, int id, long long priceCents, int create) {
+    int slot = idMapGet(&st->index, id);
+    if (slot >= 0) return &st->products[slot];
+    if (!create) return NULL;
+    if (st->count == st->capacity) {
+        int newCap = st->capacity ? st->capacity * 2 : 16;
+        ProductLots* grown = realloc(st->products, (size_t)newCap * sizeof(ProductLots));
+        if (grown == NULL) return NULL;
+        st->products = grown;
+        st->capacity = newCap;
+    }
+    ProductLots* pl = &st->products[st->count];
+    memset(pl, 0, sizeof(*pl));
+    pl->id = id;
+    pl->priceCents = priceCents;
+    idMapPut(&st->index, id, st->count++);
+    atomic_fetch_add(&st->lotted, 1);
+    return pl;
+}
+
+// Adds a lot to a product's heap. Returns 0 if out of memory (the units
+// then stay untracked).
+int lotPush(LotStripe* st, ProductLots* pl, const StockLot* l) {
+    if (pl->count == pl->capacity) {
+        int newCap = pl->capacity ? pl->capacity * 2 : 4;
+        StockLot* grown = realloc(pl->lots, (size_t)newCap * sizeof(StockLot));
+        if (grown == NULL) return 0;
+        pl->lots = grown;
+        pl->capacity = newCap;
+    }
+    pl->lots[pl->count++] = *l;
+    lotSiftUp(pl, pl->count - 1);
+    lotAccount(st, pl, l, l->qty, 1);
+    st->lots++;
+    return 1;
+}
+
+// Forgets the lots in slot `slot`; the stripe's last product fills the hole.
+void lotDrop(LotStripe* st, int slot) {
+    ProductLots* pl = &st->products[slot];
+    for (int i = 0; i < pl->count; i++) lotAccount(st, pl, &pl->lots[i], pl->lots[i].qty, -1);
+    st->lots -= pl->count;
+    free(pl->lots);
+    idMapRemove(&st->index, pl->id);
+    int last = --st->count;
+    if (slot != last) {
+        st->products[slot] = st->products[last];
+        idMapPut(&st->index, st->products[slot].id, slot);
+    }
+    atomic_fetch_sub(&st->lotted, 1);
+}
+
+// Opens a lot of qty units received now. Returns 0 if out of memory. The
+// product's heap must exist before its units are added (see above), so
+// callers changing the quantity lock-free create it first.
+int lotReceiveLocked(Inventory* inv, const Product* p, int qty, long long unitCostCents, long long expiresMs) {
+    LotStripe* st = lotStripe(inv, p->id);
+    ProductLots* pl = lotProduct(st, p->id, priceCents(p->price), 1);
+    StockLot l = { atomic_fetch_add(&inv->lotNextId, 1), qty, unitCostCents, wallMs(), expiresMs };
+    if (pl == NULL || !lotPush(st, pl, &l)) {
+        if (pl != NULL && pl->count == 0) lotDrop(st, (int)(pl - st->products));
+        return 0;
+    }
+    if (inv->lotFp != NULL) {
+        fprintf(inv->lotFp, "R,%d,%d,%d,%lld,%lld,%lld\n", p->id, l.lot, qty, unitCostCents, l.receivedMs, expiresMs);
+        atomic_fetch_add(&inv->lotFileLines, 1);
+    }
+    return 1;
+}
+
+// Takes qty units from a product that had `before` units: untracked ones
+// first, then lots in consumption order. Returns what they cost, in cents.
+long long lotTakeLocked(Inventory* inv, const Product* p, int before, int qty) {
+    LotStripe* st = lotStripe(inv, p->id);
+    int slot = idMapGet(&st->index, p->id);
+    if (slot < 0) return (long long)qty * priceCents(p->price);
+    ProductLots* pl = &st->products[slot];
+    long long untracked = before - pl->units;
+    int loose = untracked <= 0 ? 0 : untracked < qty ? (int)untracked : qty;
+    long long cost = (long long)loose * pl->priceCents;
+    qty -= loose;
+    while (qty > 0 && pl->count > 0) {
+        StockLot* top = &pl->lots[0];
+        int n = top->qty < qty ? top->qty : qty;
+        lotAccount(st, pl, top, n, -1);
+        cost += (long long)n * top->unitCostCents;
+        top->qty -= n;
+        qty -= n;
+        if (inv->lotFp != NULL) {
+            fprintf(inv->lotFp, "T,%d,%d,%d\n", p->id, top->lot, n);
+            atomic_fetch_add(&inv->lotFileLines, 1);
+        }
+        if (top->qty == 0) {
+            pl->lots[0] = pl->lots[--pl->count];
+            st->lots--;
+            if (pl->count > 0) lotSiftDown(pl, 0);
+        }
+    }
+    cost += (long long)qty * pl->priceCents;   // More than the lots held: at list price
+    if (pl->count == 0) lotDrop(st, slot);
+    return cost;
+}
+
+// A lock-free take of qty units saw lots appear in its stripe while it ran.
+// Any units it took from a lot show up as lots holding more than the
+// product's quantity; takes them out of the lots. Returns the take's cost.
+long long lotSettleLocked(Inventory* inv, const Product* p, int qty) {
+    LotStripe* st = lotStripe(inv, p->id);
+    ProductLots* pl = lotProduct(st, p->id, 0, 0);
+    int now = __atomic_load_n(&p->quantity, __ATOMIC_SEQ_CST);
+    long long excess = pl != NULL ? pl->units - now : 0;
+    int fromLots = excess <= 0 ? 0 : excess < qty ? (int)excess : qty;
+    long long cost = (long long)(qty - fromLots) * priceCents(p->price);
+    if (fromLots > 0) cost += lotTakeLocked(inv, p, (int)pl->units, fromLots);
+    return cost;
+}
+
+// Drops the lots of a product that is being deleted.
+void lotForgetLocked(Inventory* inv, int id) {
+    LotStripe* st = lotStripe(inv, id);
+    int slot = idMapGet(&st->index, id);
+    if (slot < 0) return;
+    if (inv->lotFp != NULL) {
+        fprintf(inv->lotFp, "D,%d\n", id);
+        atomic_fetch_add(&inv->lotFileLines, 1);
+    }
+    lotDrop(st, slot);
+}
+
+// Brings the lots in line with the store: drops those of products that are
+// gone (or came back at another price) and trims lots holding more units
+// than their product. inventoryLock held exclusively.
+void lotReconcile(Inventory* inv) {
+    for (int s = 0; s < LOT_STRIPES; s++) {
+        LotStripe* st = &inv->lotStripes[s];
+        for (int i = st->count - 1; i >= 0; i--) {
+            ProductLots* pl = &st->products[i];
+            Product* p = searchProduct(inv, pl->id);
+            if (p == NULL || priceCents(p->price) != pl->priceCents) lotForgetLocked(inv, pl->id);
+            else if (pl->units > p->quantity) lotTakeLocked(inv, p, (int)pl->units, (int)(pl->units - p->quantity));
+        }
+    }
+}
+
+void lotRelease(Inventory* inv) {
+    for (int s = 0; s < LOT_STRIPES; s++) {
+        LotStripe* st = &inv->lotStripes[s];
+        for (int i = 0; i < st->count; i++) free(st->products[i].lots);
+        st->count = 0;
+        atomic_store(&st->lotted, 0);
+        idMapClear(&st->index, 0);
+        st->lots = st->units = st->costCents = st->listCents = 0;
+        atomic_store(&st->salesCostCents, 0);
+    }
+}
+
+long long lotOpenCount(Inventory* inv) {
+    long long lots = 0;
+    for (int s = 0; s < LOT_STRIPES; s++) lots += inv->lotStripes[s].lots;
+    return lots;
+}
+
+void lotClose(Inventory* inv) {
+    if (inv->lotFp != NULL) fclose(inv->lotFp);
+    inv->lotFp = NULL;
+}
+
+// Syncs LOTFILE (journal checkpoints, command line tools). stdio locks the
+// stream, so this may run alongside transactions appending to it.
+void lotCheckpoint(Inventory* inv) {
+    if (inv->lotFp != NULL) syncFile(inv->lotFp);
+}
+
+// Rewrites LOTFILE with only the open lots (temp file + sync + rename).
+int lotCompact(Inventory* inv) {
+    char tmpPath[INVENTORY_PATH_LEN + 4];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", inv->lotPath);
+    FILE* fp = fopen(tmpPath, "w");
+    if (fp == NULL) return 0;
+    for (int s = 0; s < LOT_STRIPES; s++) {
+        const LotStripe* st = &inv->lotStripes[s];
+        for (int i = 0; i < st->count; i++) {
+            const ProductLots* pl = &st->products[i];
+            for (int j = 0; j < pl->count; j++) {
+                const StockLot* l = &pl->lots[j];
+                fprintf(fp, "R,%d,%d,%d,%lld,%lld,%lld\n", pl->id, l->lot, l->qty, l->unitCostCents, l->receivedMs, l->expiresMs);
+            }
+        }
+    }
+    if (syncFile(fp) != 0 || fclose(fp) != 0 || replaceFile(tmpPath, inv->lotPath) != 0) {
+        remove(tmpPath);
+        return 0;
+    }
+    atomic_store(&inv->lotFileLines, lotOpenCount(inv));
+    return 1;
+}
+
+// Reads LOTFILE back after the store is loaded and reopens it for appending.
+void lotLoad(Inventory* inv) {
+    lotClose(inv);
+    lotRelease(inv);
+    LotRecord* records = NULL;
+    int count = 0, capacity = 0, line = 0, torn = 0, nextId = 1;
+    IdMap byLot = { NULL, 0, 0 };       // Lot number -> records slot
+    IdMap dropped = { NULL, 0, 0 };     // Product id -> line of its last drop
+
+    FILE* fp = fopen(inv->lotPath, "r");
+    char text[160];
+    while (fp != NULL && fgets(text, sizeof(text), fp)) {
+        if (strchr(text, '\n') == NULL) {
+            torn = 1;       // Cut short by a crash: rewrite the file below
+            break;
+        }
+        line++;
+        LotRecord r;
+        int lot, qty;
+        if (sscanf(text, "R,%d,%d,%d,%lld,%lld,%lld", &r.id, &r.lot.lot, &r.lot.qty, &r.lot.unitCostCents,
+                   &r.lot.receivedMs, &r.lot.expiresMs) == 6 && r.lot.lot > 0 && r.lot.qty > 0) {
+            if (count == capacity) {
+                int newCap = capacity ? capacity * 2 : 1024;
+                LotRecord* grown = realloc(records, (size_t)newCap * sizeof(LotRecord));
+                if (grown == NULL) break;
+                records = grown;
+                capacity = newCap;
+            }
+            r.line = line;
+            idMapPut(&byLot, r.lot.lot, count);
+            records[count++] = r;
+            if (r.lot.lot >= nextId) nextId = r.lot.lot + 1;
+        } else if (sscanf(text, "T,%d,%d,%d", &r.id, &lot, &qty) == 3) {
+            int slot = idMapGet(&byLot, lot);
+            if (slot >= 0) records[slot].lot.qty -= qty < records[slot].lot.qty ? qty : records[slot].lot.qty;
+        } else if (sscanf(text, "D,%d", &r.id) == 1) {
+            idMapPut(&dropped, r.id, line);
+        }
+    }
+    if (fp != NULL) fclose(fp);
+    atomic_store(&inv->lotNextId, nextId);
+    atomic_store(&inv->lotFileLines, line);
+
+    for (int i = 0; i < count; i++) {
+        const LotRecord* r = &records[i];
+        if (r->lot.qty <= 0 || r->line < idMapGet(&dropped, r->id)) continue;
+        Product* p = searchProduct(inv, r->id);
+        LotStripe* st = lotStripe(inv, r->id);
+        ProductLots* pl = p != NULL ? lotProduct(st, r->id, priceCents(p->price), 1) : NULL;
+        if (pl != NULL && !lotPush(st, pl, &r->lot) && pl->count == 0) lotDrop(st, (int)(pl - st->products));
+    }
+    free(records);
+    free(byLot.slots);
+    free(dropped.slots);
+
+    inv->lotFp = fopen(inv->lotPath, "a");
+    if (inv->lotFp == NULL) printf("Error opening lot file!\n");
+    lotReconcile(inv);
+    if (torn || atomic_load(&inv->lotFileLines) > 2 * lotOpenCount(inv) + 64) {
+        lotClose(inv);
+        lotCompact(inv);
+        inv->lotFp = fopen(inv->lotPath, "a");
+    }
+}
+
+// Copies up to `max` of a product's open lots, in the order they will be
+// taken. Returns how many it has; *untracked gets its other units.
+int lotCopy(Inventory* inv, int id, StockLot* out, int max, int* untracked) {
+    LotStripe* st = lotStripe(inv, id);
+    pthread_rwlock_rdlock(&inv->inventoryLock);
+    pthread_mutex_lock(&st->lock);
+    Product* p = searchProduct(inv, id);
+    ProductLots* pl = lotProduct(st, id, 0, 0);
+    int count = pl != NULL ? pl->count : 0;
+    StockLot* sorted = count > 0 ? malloc((size_t)count * sizeof(StockLot)) : NULL;
+    if (sorted != NULL) {
+        memcpy(sorted, pl->lots, (size_t)count * sizeof(StockLot));
+        qsort(sorted, (size_t)count, sizeof(StockLot), lotCompare);
+        for (int i = 0; i < count && i < max; i++) out[i] = sorted[i];
+        free(sorted);
+    } else {
+        count = 0;
+    }
+    *untracked = p != NULL ? __atomic_load_n(&p->quantity, __ATOMIC_ACQUIRE) - (int)(pl != NULL ? pl->units : 0) : 0;
+    pthread_mutex_unlock(&st->lock);
+    pthread_rwlock_unlock(&inv->inventoryLock);
+    return count;
+}
+
+// Values the stock at cost. Takes inventoryLock exclusively for a moment so
+// no transaction is half way between the store and its lots.
+void lotValuation(Inventory* inv, LotValuation* out) {
+    StockStats stats;
+    QtyEntry maxQty, minQty;
+    long long listCents = 0;
+    memset(out, 0, sizeof(*out));
+    pthread_rwlock_wrlock(&inv->inventoryLock);
+    statsRead(inv, &stats, &maxQty, &minQty);
+    for (int s = 0; s < LOT_STRIPES; s++) {
+        const LotStripe* st = &inv->lotStripes[s];
+        out->lots += st->lots;
+        out->lotUnits += st->units;
+        out->lotValueCents += st->costCents;
+        out->salesCostCents += atomic_load(&st->salesCostCents);
+        listCents += st->listCents;
+    }
+    out->untrackedUnits = stats.typeUnits[0] + stats.typeUnits[1] - out->lotUnits;
+    out->untrackedValueCents = stats.typeValueCents[0] + stats.typeValueCents[1] - listCents;
+    out->valueCents = out->lotValueCents + out->untrackedValueCents;
+    pthread_rwlock_unlock(&inv->inventoryLock);
+}
+
+// ---------------- Snapshot Files ----------------
+// The primary snapshot (SNAPSHOTFILE) is a fixed-layout binary file: a
+// 64-byte header followed by productCount raw Product records. It is
+// mmap'ed copy-on-write and used in place as the store, so startup costs
+// a checksum pass instead of a text parse. FILENAME keeps the original
+// "id,name,qty,price,type" text format; it is read once to migrate an
+// existing inventory, and the two can be converted with --export-text
+// and --import-text.
+//
+// Version 1 records were 68 bytes (no reorderLevel); they are still read,
+// by copying into the heap with the default level.
+
+#define SNAPSHOT_MAGIC "INVSNAP"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_V1_RECORD 68
+#define SNAPSHOT_ENDIAN_TAG 0x01020304U
+
+typedef struct {
+    char magic[8];                  // SNAPSHOT_MAGIC
+    unsigned int version;           // SNAPSHOT_VERSION
+    unsigned int headerSize;        // sizeof(SnapshotHeader); records start here
+    unsigned int recordSize;        // sizeof(Product)
+    unsigned int endianTag;         // SNAPSHOT_ENDIAN_TAG as written by the host
+    unsigned long long count;       // Number of records
+    unsigned long long lsn;         // Last journal LSN folded into this snapshot
+    unsigned long long checksum;    // snapshotChecksum() of the record area
+    char reserved[16];
+} SnapshotHeader;
+
+_Static_assert(sizeof(SnapshotHeader) == 64, "Snapshot header must stay 64 bytes");
+
+// FNV-1a style hash over 64-bit words; cheap enough to verify millions of records at startup.
+unsigned long long snapshotChecksum(const void* data, size_t len) {
+    const unsigned char* b = data;
+    unsigned long long h = 14695981039346656037ULL;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        unsigned long long w;
+        memcpy(&w, b + i, 8);
+        h = (h ^ w) * 1099511628211ULL;
+    }
+    for (; i < len; i++) h = (h ^ b[i]) * 1099511628211ULL;
+    return h;
+}
+
+int snapshotHeaderValid(const SnapshotHeader* hdr, size_t fileSize) {
+    if (memcmp(hdr->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) return 0;
+    if (hdr->endianTag != SNAPSHOT_ENDIAN_TAG || hdr->headerSize != sizeof(SnapshotHeader)) return 0;
+    if (!(hdr->version == SNAPSHOT_VERSION && hdr->recordSize == sizeof(Product)) &&
+        !(hdr->version == 1 && hdr->recordSize == SNAPSHOT_V1_RECORD)) return 0;
+    if (hdr->count > 0x7fffffffULL) return 0;
+    return fileSize == hdr->headerSize + hdr->count * hdr->recordSize;
+}
+
+// Loads a binary snapshot as the store. Returns 0 (leaving the store untouched)
+// if the file is missing, from an unknown version, or fails its checksum.
+int loadBinarySnapshot(Inventory* inv, const char* path) {
+    void* base;
+    size_t size;
+    int mapped;
+#ifdef _WIN32
+    // No mmap here: read the whole file into the heap instead.
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) return 0;
+    fseek(fp, 0, SEEK_END);
+    size = (size_t)ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    base = size >= sizeof(SnapshotHeader) ? malloc(size) : NULL;
+    if (base == NULL || fread(base, 1, size, fp) != size) {
+        free(base);
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+    mapped = 0;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+        close(fd);
+        return 0;
+    }
+    size = (size_t)st.st_size;
+    // MAP_PRIVATE: edits to the live store never reach the file
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return 0;
+    mapped = 1;
+#endif
+
+    SnapshotHeader hdr;
+    memcpy(&hdr, base, sizeof(hdr));
+    const char* records = (const char*)base + sizeof(SnapshotHeader);
+    if (!snapshotHeaderValid(&hdr, size) ||
+        snapshotChecksum(records, (size_t)hdr.count * hdr.recordSize) != hdr.checksum) {
+#ifndef _WIN32
+        munmap(base, size);
+#else
+        free(base);
+#endif
+        return 0;
+    }
+
+    releaseInventory(inv);
+    if (mapped && hdr.version == SNAPSHOT_VERSION) {
+        // Current layout: use the mapping in place
+        inv->inventoryMapBase = base;
+        inv->inventoryMapLen = size;
+        inv->products = (Product*)records;
+        inv->inventoryCapacity = (int)hdr.count;
+    } else {
+        if (!reserveInventory(inv, (int)hdr.count > 0 ? (int)hdr.count : 1)) {
+            hdr.count = 0;
+        }
+        for (unsigned long long i = 0; i < hdr.count; i++) {
+            Product* p = &inv->products[i];
+            memcpy(p, records + i * hdr.recordSize, hdr.recordSize);
+            if (hdr.version == 1) p->reorderLevel = LOW_STOCK_THRESHOLD;
+        }
+#ifndef _WIN32
+        munmap(base, size);
+#else
+        free(base);
+#endif
+    }
+    inv->productCount = (int)hdr.count;
+    inv->snapshotLsn = hdr.lsn;
+    inv->journalLsn = hdr.lsn;
+    rebuildIndex(inv, inv->productCount);
+    return 1;
+}
+
+// Writes the store as a binary snapshot (temp file + sync + rename).
+int saveBinarySnapshot(Inventory* inv, const char* path) {
+    if (!inventoryNormalize(inv)) return 0;
+    char tmpPath[256];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    FILE* fp = fopen(tmpPath, "wb");
+    if (fp == NULL) return 0;
+
+    SnapshotHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    hdr.version = SNAPSHOT_VERSION;
+    hdr.headerSize = sizeof(SnapshotHeader);
+    hdr.recordSize = sizeof(Product);
+    hdr.endianTag = SNAPSHOT_ENDIAN_TAG;
+    hdr.count = (unsigned long long)inv->productCount;
+    hdr.lsn = inv->journalLsn;
+    hdr.checksum = snapshotChecksum(inv->products, (size_t)inv->productCount * sizeof(Product));
+
+    int ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+             (inv->productCount == 0 ||     // products may be NULL when the store is empty
+              fwrite(inv->products, sizeof(Product), (size_t)inv->productCount, fp) == (size_t)inv->productCount);
+    ok = (syncFile(fp) == 0) && ok;
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || replaceFile(tmpPath, path) != 0) {
+        remove(tmpPath);
+        return 0;
+    }
+    inv->snapshotLsn = inv->journalLsn;
+    return 1;
+}
+
+// Loads the text format ("id,name,qty,price,type[,reorderLevel]" per line) as the store.
+int loadTextInventory(Inventory* inv, const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL) return 0;
+    
+    releaseInventory(inv);
+    char line[256];
+    Product p;
+    memset(&p, 0, sizeof(p));
+    while (fgets(line, sizeof(line), fp)) {
+        p.reorderLevel = LOW_STOCK_THRESHOLD;
+        if (sscanf(line, "%d,%49[^,],%d,%f,%d,%d",
+                   &p.id,
+                   p.name,
+                   &p.quantity,
+                   &p.price,
+                   (int*)&p.type,
+                   &p.reorderLevel) < 5) break;
+        if (p.quantity < 0 || !(p.price >= 0 && p.price <= MAX_PRICE)) continue;
+        if (!reserveInventory(inv, inv->productCount + 1)) break;
+        inv->products[inv->productCount++] = p;
+    }
+    
+    fclose(fp);
+    rebuildIndex(inv, inv->productCount);
+    return 1;
+}
+
+// Writes the store in the text format (temp file + sync + rename).
+int saveTextInventory(Inventory* inv, const char* path) {
+    if (!inventoryNormalize(inv)) return 0;
+    char tmpPath[256];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    FILE* fp = fopen(tmpPath, "w");
+    if (fp == NULL) return 0;
+    
+    for (int i = 0; i < inv->productCount; i++) {
+        fprintf(fp, "%d,%s,%d,%.2f,%d,%d\n",
+                inv->products[i].id,
+                inv->products[i].name,
+                inv->products[i].quantity,
+                inv->products[i].price,
+                inv->products[i].type,
+                inv->products[i].reorderLevel);
+    }
+    
+    if (syncFile(fp) != 0 || fclose(fp) != 0 || replaceFile(tmpPath, path) != 0) {
+        remove(tmpPath);
+        return 0;
+    }
+    return 1;
+}
+
+// Binary snapshot first; fall back to the legacy text file (first run after upgrading).
+void loadSnapshot(Inventory* inv) {
+    inv->snapshotLsn = 0;
+    inv->journalLsn = 0;
+    if (loadBinarySnapshot(inv, inv->snapshotPath)) return;
+    if (loadTextInventory(inv, inv->textPath)) return;
+    releaseInventory(inv);
+    rebuildIndex(inv, inv->productCount);
+}
+
+// ---------------- Activity Log View ----------------
+// The Activity Log screen reads from an in-memory ring of the most recent
+// LOG_VIEW_LINES lines instead of the file. The ring is filled by an
+// incremental reader that remembers how far into LOGFILE it has read and
+// only picks up what was appended since. The logger thread runs it after
+// each write, and while idle, so lines from other processes also show up.
+// None of this happens on the UI thread.
+
+void logViewPush(Inventory* inv, const char* line) {
+    pthread_mutex_lock(&inv->logViewMutex);
+    char* slot = inv->logViewLines[inv->logViewTotal % LOG_VIEW_LINES];
+    snprintf(slot, LOG_LINE_LEN, "%s", line);
+    inv->logViewTotal++;
+    pthread_mutex_unlock(&inv->logViewMutex);
+}
+
+// Copies up to `max` lines ending `skip` lines before the newest, oldest first.
+// Returns the number copied; *available receives how many lines the ring holds.
+int logViewCopy(Inventory* inv, int skip, int max, char out[][LOG_LINE_LEN], int* available) {
+    pthread_mutex_lock(&inv->logViewMutex);
+    int held = inv->logViewTotal < LOG_VIEW_LINES ? (int)inv->logViewTotal : LOG_VIEW_LINES;
+    if (skip > held) skip = held;
+    int n = held - skip < max ? held - skip : max;
+    long first = inv->logViewTotal - skip - n;
+    for (int i = 0; i < n; i++) {
+        memcpy(out[i], inv->logViewLines[(first + i) % LOG_VIEW_LINES], LOG_LINE_LEN);
+    }
+    *available = held;
+    pthread_mutex_unlock(&inv->logViewMutex);
+    return n;
+}
+
+// Lines pushed so far; changes whenever the ring gets a new line.
+long logViewLineCount(Inventory* inv) {
+    pthread_mutex_lock(&inv->logViewMutex);
+    long total = inv->logViewTotal;
+    pthread_mutex_unlock(&inv->logViewMutex);
+    return total;
+}
+
+// Reads whatever was appended to LOGFILE since the last call. The first call
+// (or one after the file shrank) starts near the end, so a huge log costs
+// no more than the ring can show.
+void logViewCatchUp(Inventory* inv) {
+    FILE* fp = fopen(inv->logPath, "rb");
+    if (fp == NULL) return;
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    int skipPartial = 0;
+    if (inv->logViewOffset < 0 || size < inv->logViewOffset) {
+        pthread_mutex_lock(&inv->logViewMutex);
+        inv->logViewTotal = 0;
+        pthread_mutex_unlock(&inv->logViewMutex);
+        long start = size - (long)LOG_VIEW_LINES * 100;
+        skipPartial = start > 0;
+        inv->logViewOffset = skipPartial ? start : 0;
+    }
+    if (size == inv->logViewOffset) {
+        fclose(fp);
+        return;
+    }
+
+    fseek(fp, inv->logViewOffset, SEEK_SET);
+    if (skipPartial) {
+        int c;
+        while ((c = fgetc(fp)) != EOF && c != '\n');
+        inv->logViewOffset = ftell(fp);
+    }
+
+    char line[LOG_LINE_LEN];
+    while (fgets(line, sizeof(line), fp)) {
+        size_t len = strlen(line);
+        if (line[len - 1] != '\n') {
+            if (feof(fp)) break;    // Line still being written; pick it up next time
+            // Overlong line: keep the start, skip the rest
+            int c;
+            while ((c = fgetc(fp)) != EOF && c != '\n');
+            if (c == EOF) break;
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+        logViewPush(inv, line);
+        inv->logViewOffset = ftell(fp);
+    }
+    fclose(fp);
+}
+
+// ---------------- Activity Logger ----------------
+// Callers push structured LogEntry values into a lock-free MPMC ring
+// (bounded, per-cell sequence numbers). A background thread formats them
+// into LOGFILE lines and writes them in batches. How often the file is
+// flushed is set by loggerConfig; audit-critical actions are flushed and
+// fsync'ed as soon as the thread picks them up.
+
+LoggerConfig loggerConfig = {
+    1,
+    64,
+    500,
+    (1u << LOG_LOGIN) | (1u << LOG_LOGOUT) | (1u << LOG_UPDATE) | (1u << LOG_DELETE)
+};
+
+// Formats an entry as "[time] User: X | Action: ..." (the historical line format).
+int formatLogEntry(const LogEntry* e, char* out, size_t size) {
+    // Each inventory's logger thread formats its own entries: cache the stamp
+    // per thread because consecutive entries usually share a second, and
+    // serialize ctime (static buffer) across those threads.
+    static pthread_mutex_t ctimeMutex = PTHREAD_MUTEX_INITIALIZER;
+    static _Thread_local time_t lastTime = -1;
+    static _Thread_local char timeStr[32] = "Unknown";
+    if (e->timestamp != lastTime) {
+        pthread_mutex_lock(&ctimeMutex);
+        char* t = ctime(&e->timestamp);
+        if (t) {
+            snprintf(timeStr, sizeof(timeStr), "%s", t);
+            timeStr[strcspn(timeStr, "\n")] = '\0';
+        }
+        pthread_mutex_unlock(&ctimeMutex);
+        lastTime = e->timestamp;
+    }
+
+    char action[160];
+    switch (e->action) {
+        case LOG_LOGIN: sprintf(action, "Logged in"); break;
+        case LOG_LOGOUT: sprintf(action, "Logged out"); break;
+        case LOG_ADD: sprintf(action, "Added product: %s (ID: %d) with %d units", e->text, e->productId, e->quantity); break;
+        case LOG_UPDATE: sprintf(action, "Updated stock for ID %d to %d units", e->productId, e->quantity); break;
+        case LOG_SALE: sprintf(action, "Sale: %d units of %s (ID: %d)", e->quantity, e->text, e->productId); break;
+        case LOG_PURCHASE: sprintf(action, "Purchase: %d units of %s (ID: %d)", e->quantity, e->text, e->productId); break;
+        case LOG_DELETE: sprintf(action, "Deleted product: %s (ID: %d)", e->text, e->productId); break;
+        case LOG_EXPORT: sprintf(action, "Exported inventory to CSV"); break;
+        case LOG_REORDER: sprintf(action, "Set reorder level for ID %d to %d units", e->productId, e->quantity); break;
+        case LOG_TRANSFER_OUT: sprintf(action, "Transfer out: %d units of %s (ID: %d)", e->quantity, e->text, e->productId); break;
+        case LOG_TRANSFER_IN: sprintf(action, "Transfer in: %d units of %s (ID: %d)", e->quantity, e->text, e->productId); break;
+        case LOG_PRODUCE: sprintf(action, "Produced: %d units of %s (ID: %d)", e->quantity, e->text, e->productId); break;
+        case LOG_CONSUME: sprintf(action, "Consumed: %d units of %s (ID: %d)", e->quantity, e->text, e->productId); break;
+        default: sprintf(action, "%s", e->text); break;
+    }
+    return snprintf(out, size, "[%s] User: %s | Action: %s\n", timeStr, e->user, action);
+}
+
+// Synchronous fallback used when the logger thread isn't running.
+void writeLogEntryNow(Inventory* inv, const LogEntry* e) {
+    FILE* fp = fopen(inv->logPath, "a");
+    if (fp == NULL) return;
+    char line[320];
+    formatLogEntry(e, line, sizeof(line));
+    fputs(line, fp);
+    fclose(fp);
+}
+
+void* loggerMain(void* arg) {
+    Inventory* inv = arg;
+    logViewCatchUp(inv);
+    FILE* fp = fopen(inv->logPath, "a");
+    char batch[1 << 16];
+    size_t batchLen = 0;
+    int unflushed = 0;
+    double oldestUnflushedMs = 0;
+
+    for (;;) {
+        int running = atomic_load(&inv->loggerRunning);
+        int syncNow = 0;
+
+        // Drain everything that is ready
+        size_t tail = atomic_load_explicit(&inv->logTail, memory_order_relaxed);
+        for (;;) {
+            LogCell* cell = &inv->logRing[tail & (LOG_RING_SIZE - 1)];
+            if (atomic_load_explicit(&cell->seq, memory_order_acquire) != tail + 1) break;
+
+            if (batchLen + 320 > sizeof(batch)) {
+                if (fp) fwrite(batch, 1, batchLen, fp);
+                batchLen = 0;
+            }
+            batchLen += (size_t)formatLogEntry(&cell->entry, batch + batchLen, sizeof(batch) - batchLen);
+            if (loggerConfig.critical & (1u << cell->entry.action)) syncNow = 1;
+            if (unflushed++ == 0) oldestUnflushedMs = nowMs();
+
+            atomic_store_explicit(&cell->seq, tail + LOG_RING_SIZE, memory_order_release);
+            atomic_store_explicit(&inv->logTail, ++tail, memory_order_relaxed);
+        }
+
+        if (atomic_exchange(&inv->logFlushRequested, 0) || !running) syncNow = 1;
+        if (unflushed > 0 && (syncNow || unflushed >= loggerConfig.flushEvery ||
+                              nowMs() - oldestUnflushedMs >= loggerConfig.flushIntervalMs)) {
+            if (fp) {
+                long long t0 = metricStart();
+                fwrite(batch, 1, batchLen, fp);
+                if (syncNow) syncFile(fp);
+                else fflush(fp);
+                metricRecord(METRIC_LOG, t0);
+            }
+            batchLen = 0;
+            unflushed = 0;
+        }
+        if (syncNow) atomic_store(&inv->logSynced, tail);
+
+        if (!running) break;
+        logViewCatchUp(inv);
+
+        // Sleep until woken by a producer or the flush interval elapses
+        pthread_mutex_lock(&inv->loggerMutex);
+        if (atomic_load(&inv->logHead) == tail && atomic_load(&inv->loggerRunning) && !atomic_load(&inv->logFlushRequested)) {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            long waitMs = unflushed > 0 ? loggerConfig.flushIntervalMs / 4 + 1 : loggerConfig.flushIntervalMs;
+            until.tv_sec += waitMs / 1000;
+            until.tv_nsec += (waitMs % 1000) * 1000000L;
+            if (until.tv_nsec >= 1000000000L) { until.tv_sec++; until.tv_nsec -= 1000000000L; }
+            pthread_cond_timedwait(&inv->loggerWake, &inv->loggerMutex, &until);
+        }
+        pthread_mutex_unlock(&inv->loggerMutex);
+    }
+
+    if (fp) fclose(fp);
+    return NULL;
+}
+
+void loggerWakeUp(Inventory* inv) {
+    pthread_mutex_lock(&inv->loggerMutex);
+    pthread_cond_signal(&inv->loggerWake);
+    pthread_mutex_unlock(&inv->loggerMutex);
+}
+
+void loggerStart(Inventory* inv) {
+    if (atomic_load(&inv->loggerRunning)) return;
+    for (size_t i = 0; i < LOG_RING_SIZE; i++) atomic_store(&inv->logRing[i].seq, i);
+    atomic_store(&inv->logHead, 0);
+    atomic_store(&inv->logTail, 0);
+    atomic_store(&inv->logSynced, 0);
+    atomic_store(&inv->loggerRunning, 1);
+    if (pthread_create(&inv->loggerThread, NULL, loggerMain, inv) != 0) {
+        atomic_store(&inv->loggerRunning, 0);
+    }
+}
+
+// Blocks until every entry pushed so far has been written and synced.
+void loggerFlush(Inventory* inv) {
+    if (!atomic_load(&inv->loggerRunning)) return;
+    size_t target = atomic_load(&inv->logHead);
+    while (atomic_load(&inv->logSynced) < target) {
+        // Re-request each round: a producer may not have published its entry yet
+        atomic_store(&inv->logFlushRequested, 1);
+        loggerWakeUp(inv);
+        sleepMs(1);
+    }
+}
+
+// Drains the ring and stops the logger thread.
+void loggerShutdown(Inventory* inv) {
+    if (!atomic_load(&inv->loggerRunning)) return;
+    atomic_store(&inv->loggerRunning, 0);
+    loggerWakeUp(inv);
+    pthread_join(inv->loggerThread, NULL);
+}
+
+void logEvent(Inventory* inv, LogAction action, int productId, int quantity, const char* text) {
+    if (!loggerConfig.enabled) return;
+    LogEntry e;
+    e.timestamp = time(NULL);
+    e.action = action;
+    e.productId = productId;
+    e.quantity = quantity;
+    snprintf(e.user, sizeof(e.user), "%s", currentUser.username);
+    snprintf(e.text, sizeof(e.text), "%s", text ? text : "");
+
+    if (!atomic_load(&inv->loggerRunning)) {
+        writeLogEntryNow(inv, &e);
+        return;
+    }
+
+    size_t pos = atomic_load_explicit(&inv->logHead, memory_order_relaxed);
+    LogCell* cell;
+    for (;;) {
+        cell = &inv->logRing[pos & (LOG_RING_SIZE - 1)];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        if (seq == pos) {
+            if (atomic_compare_exchange_weak_explicit(&inv->logHead, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) break;
+        } else if (seq < pos) {
+            // Ring full: let the logger thread catch up
+            loggerWakeUp(inv);
+            sched_yield();
+            pos = atomic_load_explicit(&inv->logHead, memory_order_relaxed);
+        } else {
+            pos = atomic_load_explicit(&inv->logHead, memory_order_relaxed);
+        }
+    }
+    cell->entry = e;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+
+    if ((loggerConfig.critical & (1u << action)) || (pos + 1) % (size_t)loggerConfig.flushEvery == 0) {
+        loggerWakeUp(inv);
+    }
+}
+
+void logActivity(Inventory* inv, const char* action) {
+    logEvent(inv, LOG_MESSAGE, 0, 0, action);
+}
+
+// ---------------- Core Logic Functions ----------------
+
+// Loads the snapshot, replays the journal tail and reopens the journal for appending.
+void loadInventory(Inventory* inv) {
+    long long t0 = metricStart();
+    journalClose(inv);
+    ledgerClose(inv);
+    loadSnapshot(inv);
+
+    if (journalReplay(inv)) {
+        // No usable journal: start from a clean snapshot + empty journal
+        journalCheckpoint(inv);
+    } else {
+        inv->journalFp = fopen(inv->journalPath, "ab");
+        if (inv->journalFp == NULL) printf("Error opening journal!\n");
+    }
+    ledgerOpen(inv);
+    bomLoad(inv);
+    lotLoad(inv);
+    alertRebuild(inv);
+    statsRebuild(inv);
+    metricRecord(METRIC_LOAD, t0);
+}
+
+// Writes a full snapshot of the store. The temp file + rename inside
+// saveBinarySnapshot means a crash never leaves a half-written snapshot.
+int saveInventory(Inventory* inv) {
+    long long t0 = metricStart();
+    int saved = saveBinarySnapshot(inv, inv->snapshotPath);
+    metricRecord(METRIC_SAVE, t0);
+    if (!saved) {
+        printf("Error saving inventory!\n");
+        return 0;
+    }
+    return 1;
+}
+
+int authenticateUser(Inventory* inv, const char* username, const char* password) {
+    for (int i = 0; i < userCount; i++) {
+        if (strcmp(users[i].username, username) == 0 &&
+            strcmp(users[i].password, password) == 0) {
+            currentUser = users[i];
+            isLoggedIn = 1;
+            logEvent(inv, LOG_LOGIN, 0, 0, NULL);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Returns 1 on success, 0 if the quantity is negative, the price is outside
+// 0..MAX_PRICE, the id is already taken or memory ran out. The store may be reallocated while growing, so Product pointers taken
+// before the call must be looked up again.
+int addProduct(Inventory* inv, int id, const char* name, int qty, float price, ProductType type, int reorderLevel) {
+    if (qty < 0 || !(price >= 0 && price <= MAX_PRICE)) {
+        printf("Error: quantity or price out of range!\n");
+        return 0;
+    }
+    long long t0 = metricStart();
+    pthread_rwlock_wrlock(&inv->inventoryLock);
+    Product fresh;
+    memset(&fresh, 0, sizeof(fresh));
+    fresh.id = id;
+    strncpy(fresh.name, name, sizeof(fresh.name) - 1);
+    fresh.quantity = qty;
+    fresh.price = price;
+    fresh.type = type;
+    fresh.reorderLevel = reorderLevel;
+    int pos = indexFind(inv, id) >= 0 ? -1 : storeAppend(inv, &fresh);
+    if (pos < 0) {
+        pthread_rwlock_unlock(&inv->inventoryLock);
+        metricRecord(METRIC_ADD, t0);
+        return 0;
+    }
+    Product* p = &inv->products[pos];
+    journalAppend(inv, JOURNAL_ADD, p);
+    ledgerRecord(inv, id, qty, MOVE_ADD);
+    logEvent(inv, LOG_ADD, id, qty, p->name);
+    alertRefresh(inv, p);
+    statsAddProduct(inv, p);
+    viewTrackAdd(inv, p);
+    nameTrackAdd(inv, p);
+    pthread_rwlock_unlock(&inv->inventoryLock);
+    metricRecord(METRIC_ADD, t0);
+    return 1;
+}
+
+// O(1) average lookup through the id index. The returned pointer is only
+// stable while the caller holds inventoryLock (or is the only thread that
+// adds/deletes products, like the GUI).
+Product* searchProduct(Inventory* inv, int id) {
+    long long t0 = metricStartSampled();
+    int pos = indexFind(inv, id);
+    metricRecord(METRIC_LOOKUP, t0);
+    if (pos >= 0 && pos < inv->productCount && inv->products[pos].id == id) {
+        return &inv->products[pos];
+    }
+    return NULL;
+}
+
+const char* txnResultMessage(TxnResult r) {
+    switch (r) {
+        case TXN_OK: return "Transaction Success!";
+        case TXN_NOT_FOUND: return "Product not found!";
+        case TXN_INSUFFICIENT_STOCK: return "Insufficient stock!";
+        default: return "Invalid quantity!";
+    }
+}
+
+// The transaction functions below are safe to call from many threads at
+// once. They look the product up in the shared store under the read lock
+// (inv/count may be stale if another thread grew the store meanwhile) and
+// change quantity with a compare-and-swap loop, so two sales of the same
+// product can never both pass the stock check. Products with lots also
+// take their lot stripe's lock (see Stock Lots).
+
+TxnResult updateStock(Inventory* inv, int id, int newQty) {
+    long long t0 = metricStart();
+    if (newQty < 0) return TXN_INVALID_QTY;
+    pthread_rwlock_rdlock(&inv->inventoryLock);
+    Product* p = searchProduct(inv, id);
+    if (p == NULL) {
+        pthread_rwlock_unlock(&inv->inventoryLock);
+        metricRecord(METRIC_UPDATE, t0);
+        return TXN_NOT_FOUND;
+    }
+
+    LotStripe* st = lotStripe(inv, id);
+    int old;
+    if (atomic_load(&st->lotted) == 0) {
+        old = __atomic_exchange_n(&p->quantity, newQty, __ATOMIC_SEQ_CST);
+        if (newQty < old && atomic_load(&st->lotted) != 0) {
+            pthread_mutex_lock(&st->lock);
+            lotSettleLocked(inv, p, old - newQty);
+            pthread_mutex_unlock(&st->lock);
+        }
+    } else {
+        pthread_mutex_lock(&st->lock);
+        old = __atomic_exchange_n(&p->quantity, newQty, __ATOMIC_SEQ_CST);
+        if (newQty < old) lotTakeLocked(inv, p, old, old - newQty);
+        pthread_mutex_unlock(&st->lock);
+    }
+    journalAppendAdjust(inv, p, newQty - old);
+    if (newQty != old) ledgerRecord(inv, id, newQty - old, MOVE_UPDATE);
+    logEvent(inv, LOG_UPDATE, id, newQty, p->name);
+    alertTrack(inv, p, old, newQty);
+    statsTrack(inv, p, old, newQty);
+    viewTrackUpdate(inv, p);
+    pthread_rwlock_unlock(&inv->inventoryLock);
+    metricRecord(METRIC_UPDATE, t0);
+    return TXN_OK;
+}
+
+// Takes qty units out of a product's stock (sale, transfer out) and its
+// lots. Fails rather than letting the quantity go negative.
+TxnResult stockTake(Inventory* inv, int id, int qty, LogAction action) {
+    if (qty <= 0) return TXN_INVALID_QTY;
+    pthread_rwlock_rdlock(&inv->inventoryLock);
+    Product* p = searchProduct(inv, id);
+    if (p == NULL) {
+        pthread_rwlock_unlock(&inv->inventoryLock);
+        return TXN_NOT_FOUND;
+    }
+
+    LotStripe* st = lotStripe(inv, id);
+    int locked = atomic_load(&st->lotted) != 0;
+    if (locked) pthread_mutex_lock(&st->lock);
+    int cur = __atomic_load_n(&p->quantity, __ATOMIC_ACQUIRE);
+    do {
+        if (cur < qty) {
+            if (locked) pthread_mutex_unlock(&st->lock);
+            pthread_rwlock_unlock(&inv->inventoryLock);
+            return TXN_INSUFFICIENT_STOCK;
+        }
+    } while (!__atomic_compare_exchange_n(&p->quantity, &cur, cur - qty, 1, __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE));
+
+    long long cost;
+    if (locked) {
+        cost = lotTakeLocked(inv, p, cur, qty);
+    } else if (atomic_load(&st->lotted) == 0) {
+        cost = (long long)qty * priceCents(p->price);
+    } else {
+        pthread_mutex_lock(&st->lock);
+        locked = 1;
+        cost = lotSettleLocked(inv, p, qty);
+    }
+    if (locked) pthread_mutex_unlock(&st->lock);
+    if (action == LOG_SALE) atomic_fetch_add(&st->salesCostCents, cost);
+
+    journalAppendAdjust(inv, p, -qty);
+    ledgerRecord(inv, id, -qty, movementKind(action));
+    logEvent(inv, action, id, qty, p->name);
+    alertTrack(inv, p, cur, cur - qty);
+    statsTrack(inv, p, cur, cur - qty);
+    viewTrackUpdate(inv, p);
+    pthread_rwlock_unlock(&inv->inventoryLock);
+    return TXN_OK;
+}
+
+// Adds qty units to a product's stock (purchase, transfer in). A purchase
+// opens a lot (unitCostCents < 0: at list price); transferred units arrive
+// untracked.
+TxnResult stockGive(Inventory* inv, int id, int qty, LogAction action, long long unitCostCents, long long expiresMs) {
+    if (qty <= 0) return TXN_INVALID_QTY;
+    pthread_rwlock_rdlock(&inv->inventoryLock);
+    Product* p = searchProduct(inv, id);
+    if (p == NULL) {
+        pthread_rwlock_unlock(&inv->inventoryLock);
+        return TXN_NOT_FOUND;
+    }
+
+    // A purchase makes the product's lot heap before its units arrive, so
+    // lock-free takes running meanwhile notice (see Stock Lots)
+    LotStripe* st = lotStripe(inv, id);
+    ProductLots* pl = NULL;
+    if (action == LOG_PURCHASE) {
+        pthread_mutex_lock(&st->lock);
+        pl = lotProduct(st, id, priceCents(p->price), 1);
+    }
+    int cur = __atomic_load_n(&p->quantity, __ATOMIC_ACQUIRE);
+    do {
+        if (cur > 0x7fffffff - qty) {
+            if (pl != NULL && pl->count == 0) lotDrop(st, (int)(pl - st->products));
+            if (action == LOG_PURCHASE) pthread_mutex_unlock(&st->lock);
+            pthread_rwlock_unlock(&inv->inventoryLock);
+            return TXN_INVALID_QTY;
+        }
+    } while (!__atomic_compare_exchange_n(&p->quantity, &cur, cur + qty, 1, __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE));
+    if (action == LOG_PURCHASE) {
+        lotReceiveLocked(inv, p, qty, unitCostCents >= 0 ? unitCostCents : priceCents(p->price), expiresMs);
+        pthread_mutex_unlock(&st->lock);
+    }
+
+    journalAppendAdjust(inv, p, qty);
+    ledgerRecord(inv, id, qty, movementKind(action));
+    logEvent(inv, action, id, qty, p->name);
+    alertTrack(inv, p, cur, cur + qty);
+    statsTrack(inv, p, cur, cur + qty);
+    viewTrackUpdate(inv, p);
+    pthread_rwlock_unlock(&inv->inventoryLock);
+    return TXN_OK;
+}
+
+TxnResult processSale(Inventory* inv, int id, int qty) {
+    long long t0 = metricStart();
+    TxnResult r = stockTake(inv, id, qty, LOG_SALE);
+    metricRecord(METRIC_SALE, t0);
+    return r;
+}
+
+// Receives qty units as a new lot at the product's list price.
+TxnResult processPurchase(Inventory* inv, int id, int qty) {
+    return processPurchaseLot(inv, id, qty, -1, 0);
+}
+
+// Receives qty units as a lot costing unitCostCents each (< 0: the list
+// price) that expires at expiresMs (0: never; see Stock Lots).
+TxnResult processPurchaseLot(Inventory* inv, int id, int qty, long long unitCostCents, long long expiresMs) {
+    long long t0 = metricStart();
+    TxnResult r = expiresMs < 0 ? TXN_INVALID_QTY : stockGive(inv, id, qty, LOG_PURCHASE, unitCostCents, expiresMs);
+    metricRecord(METRIC_PURCHASE, t0);
+    return r;
+}
+
+// Changes the level below which a product shows up as a low stock alert.
+TxnResult setReorderLevel(Inventory* inv, int id, int level) {
+    if (level < 0) return TXN_INVALID_QTY;
+    pthread_rwlock_rdlock(&inv->inventoryLock);
+    Product* p = searchProduct(inv, id);
+    if (p == NULL) {
+        pthread_rwlock_unlock(&inv->inventoryLock);
+        return TXN_NOT_FOUND;
+    }
+
+    __atomic_store_n(&p->reorderLevel, level, __ATOMIC_RELEASE);
+    journalWrite(inv, JOURNAL_SET_REORDER, p, level);
+    logEvent(inv, LOG_REORDER, id, level, p->name);
+    alertRefresh(inv, p);
+    viewTrackUpdate(inv, p);
+    pthread_rwlock_unlock(&inv->inventoryLock);
+    return TXN_OK;
+}
+
+// Returns 1 if the product existed. O(1) apart from the view and name
+// indexes: the last product fills the hole (see storeRemoveAt).
+int deleteProduct(Inventory* inv, int id) {
+    long long t0 = metricStart();
+    pthread_rwlock_wrlock(&inv->inventoryLock);
+    int index = indexFind(inv, id);
+    
+    if (index != -1) {
+        logEvent(inv, LOG_DELETE, id, inv->products[index].quantity, inv->products[index].name);
+        journalAppend(inv, JOURNAL_DELETE, &inv->products[index]);
+        ledgerRecord(inv, id, -inv->products[index].quantity, MOVE_DELETE);
+        
+        viewTrackRemove(inv, &inv->products[index]);
+        nameTrackRemove(inv, &inv->products[index]);
+        alertRemoveId(inv, id);
+        statsRemoveProduct(inv, &inv->products[index]);
+        lotForgetLocked(inv, id);
+        storeRemoveAt(inv, index);
+    }
+    pthread_rwlock_unlock(&inv->inventoryLock);
+    metricRecord(METRIC_DELETE, t0);
+    return index != -1;
+}
+
+// ---------------- CSV Import ----------------
+// Reads the "ID,Name,Quantity,Price,Type" format exportToCSV writes (the
+// header line is optional, Type may also be 0/1). The file is streamed in
+// blocks; each block is cut at line boundaries into one chunk per thread
+// and parsed with the hand-rolled field parsers below. Names are whatever
+// lies between the first comma and the last three, so commas inside a name
+// survive a round trip; a "quoted" name is unquoted. Valid rows are then
+// added in file order under one write lock, skipping ids that repeat in
+// the file or already exist, and persisted with a single checkpoint
+// instead of a journal record (or a save) per product.
+
+#define IMPORT_BLOCK (8 << 20)
+#define IMPORT_MAX_THREADS 16
+#define IMPORT_MAX_LINE 512
+#define IMPORT_REPORT_ERRORS 20
+
+typedef struct {
+    Product product;
+    long long line;         // 1-based line in the file
+} ImportRow;
+
+typedef struct {
+    const char* start;      // Whole lines only
+    const char* end;
+    long long firstLine;    // Line number of `start`, 0 while unknown
+    ImportRow* rows;
+    int count;
+    int capacity;
+    long long lines;
+    long long malformed;
+    long long badLines[IMPORT_REPORT_ERRORS];   // Chunk-relative, 1-based
+    int badCount;
+} ImportChunk;
+
+// Parses an optionally signed decimal int at *p, stopping at `end` or the
+// first non-digit. Returns 0 if there were no digits or it overflowed.
+int parseIntField(const char** p, const char* end, int* out) {
+    const char* c = *p;
+    while (c < end && (*c == ' ' || *c == '\t')) c++;
+    int neg = 0;
+    if (c < end && (*c == '-' || *c == '+')) neg = (*c++ == '-');
+    const char* digits = c;
+    long long v = 0;
+    while (c < end && *c >= '0' && *c <= '9') {
+        v = v * 10 + (*c++ - '0');
+        if (v > 0x7fffffffLL) return 0;
+    }
+    if (c == digits) return 0;
+    while (c < end && (*c == ' ' || *c == '\t')) c++;
+    *out = (int)(neg ? -v : v);
+    *p = c;
+    return 1;
+}
+
+// Same for a decimal number without exponent ("12", "12.5", ".75").
+int parseFloatField(const char** p, const char* end, float* out) {
+    const char* c = *p;
+    while (c < end && (*c == ' ' || *c == '\t')) c++;
+    int neg = 0;
+    if (c < end && (*c == '-' || *c == '+')) neg = (*c++ == '-');
+    double v = 0, scale = 1;
+    int digits = 0;
+    while (c < end && *c >= '0' && *c <= '9') {
+        v = v * 10 + (*c++ - '0');
+        digits++;
+    }
+    if (c < end && *c == '.') {
+        c++;
+        while (c < end && *c >= '0' && *c <= '9') {
+            v = v * 10 + (*c++ - '0');
+            scale *= 10;
+            digits++;
+        }
+    }
+    if (digits == 0 || v / scale > 3.0e38) return 0;
+    while (c < end && (*c == ' ' || *c == '\t')) c++;
+    *out = (float)((neg ? -v : v) / scale);
+    *p = c;
+    return 1;
+}
+
+// Parses one CSV row (without its newline) into p.
+int parseCsvLine(const char* line, const char* end, Product* p) {
+    const char* c = line;
+    memset(p, 0, sizeof(*p));
+    if (!parseIntField(&c, end, &p->id) || p->id <= 0 || c >= end || *c++ != ',') return 0;
+
+    // The last three commas delimit quantity, price and type
+    const char* commas[3];
+    int found = 0;
+    for (const char* s = end - 1; s >= c && found < 3; s--) {
+        if (*s == ',') commas[found++] = s;
+    }
+    if (found < 3) return 0;
+    const char* typeStart = commas[0] + 1;
+    const char* priceStart = commas[1] + 1;
+    const char* qtyStart = commas[2] + 1;
+
+    // Name, trimmed and unquoted
+    const char* nameStart = c;
+    const char* nameEnd = commas[2];
+    while (nameStart < nameEnd && *nameStart == ' ') nameStart++;
+    while (nameEnd > nameStart && nameEnd[-1] == ' ') nameEnd--;
+    int quoted = nameEnd - nameStart >= 2 && *nameStart == '"' && nameEnd[-1] == '"';
+    if (quoted) {
+        nameStart++;
+        nameEnd--;
+    }
+    size_t len = 0;
+    for (const char* s = nameStart; s < nameEnd; s++) {
+        if (quoted && *s == '"' && s + 1 < nameEnd && s[1] == '"') s++;    // "" -> "
+        if (len >= sizeof(p->name) - 1) return 0;
+        p->name[len++] = *s;
+    }
+    if (len == 0) return 0;
+
+    c = qtyStart;
+    if (!parseIntField(&c, commas[1], &p->quantity) || c != commas[1] || p->quantity < 0) return 0;
+    c = priceStart;
+    if (!parseFloatField(&c, commas[0], &p->price) || c != commas[0] || p->price < 0 || p->price > MAX_PRICE) return 0;
+
+    while (typeStart < end && *typeStart == ' ') typeStart++;
+    char t = typeStart < end ? foldChar(*typeStart) : '\0';
+    if (t == 'r' || t == '0') p->type = RAW_MATERIAL;
+    else if (t == 'f' || t == '1') p->type = FINISHED_GOOD;
+    else return 0;
+
+    p->reorderLevel = LOW_STOCK_THRESHOLD;
+    return 1;
+}
+
+void* importChunkMain(void* arg) {
+    ImportChunk* ch = arg;
+    const char* line = ch->start;
+    while (line < ch->end) {
+        const char* nl = memchr(line, '\n', (size_t)(ch->end - line));
+        const char* lineEnd = nl ? nl : ch->end;
+        const char* next = nl ? nl + 1 : ch->end;
+        if (lineEnd > line && lineEnd[-1] == '\r') lineEnd--;
+        ch->lines++;
+
+        if (lineEnd > line) {
+            if (ch->count == ch->capacity) {
+                int newCap = ch->capacity ? ch->capacity * 2 : 4096;
+                ImportRow* grown = realloc(ch->rows, (size_t)newCap * sizeof(ImportRow));
+                if (grown == NULL) break;
+                ch->rows = grown;
+                ch->capacity = newCap;
+            }
+            ImportRow* row = &ch->rows[ch->count];
+            if (parseCsvLine(line, lineEnd, &row->product)) {
+                row->line = ch->lines;
+                ch->count++;
+            } else if (!(ch->firstLine == 1 && ch->lines == 1 && (*line < '0' || *line > '9'))) {
+                // (A non-numeric first line of the file is the header)
+                if (ch->badCount < IMPORT_REPORT_ERRORS) ch->badLines[ch->badCount++] = ch->lines;
+                ch->malformed++;
+            }
+        }
+        line = next;
+    }
+    return NULL;
+}
+
+int importThreadCount() {
+#ifdef _WIN32
+    int n = 4;
+#else
+    int n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (n < 1) n = 1;
+    return n > IMPORT_MAX_THREADS ? IMPORT_MAX_THREADS : n;
+}
+
+// Imports every valid row of a CSV file. Returns 0 if the file can't be
+// read, memory runs out (report->outOfMemory rows are lost) or the result
+// can't be saved; per-row problems go in the report (the first few are
+// listed on stderr) and don't stop the import.
+int importCSV(Inventory* inv, const char* path, ImportReport* report) {
+    long long t0 = metricStart();
+    memset(report, 0, sizeof(*report));
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) return 0;
+
+    int threads = importThreadCount();
+    ImportChunk chunks[IMPORT_MAX_THREADS];
+    memset(chunks, 0, sizeof(chunks));
+    ImportRow* rows = NULL;
+    long long rowCount = 0, rowCapacity = 0;
+    char* buf = malloc(IMPORT_BLOCK + IMPORT_MAX_LINE);
+    size_t carry = 0;
+    long long lineBase = 0;         // Lines in earlier blocks
+    int reported = 0;
+    int skipping = 0;               // Dropping the rest of an overlong row, up to its newline
+
+    while (buf != NULL) {
+        size_t got = fread(buf + carry, 1, IMPORT_BLOCK, fp);
+        size_t len = carry + got;
+        if (len == 0) break;
+        size_t start = 0;
+        if (skipping) {
+            const char* nl = memchr(buf, '\n', len);
+            if (nl == NULL) {
+                carry = 0;
+                if (got == 0) break;
+                continue;
+            }
+            start = (size_t)(nl - buf) + 1;
+            skipping = 0;
+        }
+        // Parse up to the last newline; the tail waits for the next block
+        size_t usable = len;
+        int overlong = 0;
+        if (got > 0) {
+            while (usable > start && buf[usable - 1] != '\n') usable--;
+            // A tail longer than any valid row is one malformed line; the
+            // rest of it is skipped in the next block rather than parsed
+            overlong = len - usable > IMPORT_MAX_LINE;
+            if (usable == start && !overlong) {
+                carry = len - start;
+                memmove(buf, buf + start, carry);
+                continue;
+            }
+        }
+
+        // Cut into one chunk per thread at line boundaries
+        const char* pos = buf + start;
+        const char* end = buf + usable;
+        int used = 0;
+        for (int t = 0; t < threads && pos < end; t++) {
+            const char* cut = t == threads - 1 ? end : pos + (end - pos) / (threads - t);
+            if (cut < end) {
+                const char* nl = memchr(cut, '\n', (size_t)(end - cut));
+                cut = nl ? nl + 1 : end;
+            }
+            ImportChunk* ch = &chunks[t];
+            ch->start = pos;
+            ch->end = cut;
+            ch->firstLine = (lineBase == 0 && t == 0) ? 1 : 0;
+            ch->count = 0;
+            ch->lines = ch->malformed = 0;
+            ch->badCount = 0;
+            pos = cut;
+            used++;
+        }
+        pthread_t tids[IMPORT_MAX_THREADS];
+        int started[IMPORT_MAX_THREADS] = {0};
+        for (int t = 1; t < used; t++) started[t] = pthread_create(&tids[t], NULL, importChunkMain, &chunks[t]) == 0;
+        importChunkMain(&chunks[0]);
+        for (int t = 1; t < used; t++) {
+            if (started[t]) pthread_join(tids[t], NULL);
+            else importChunkMain(&chunks[t]);
+        }
+
+        // Gather rows in file order with absolute line numbers
+        for (int t = 0; t < used; t++) {
+            ImportChunk* ch = &chunks[t];
+            if (rowCount + ch->count > rowCapacity) {
+                long long newCap = rowCapacity ? rowCapacity * 2 : 65536;
+                while (newCap < rowCount + ch->count) newCap *= 2;
+                ImportRow* grown = realloc(rows, (size_t)newCap * sizeof(ImportRow));
+                if (grown != NULL) {
+                    rows = grown;
+                    rowCapacity = newCap;
+                }
+            }
+            int copied = 0;
+            for (; copied < ch->count && rowCount < rowCapacity; copied++) {
+                rows[rowCount] = ch->rows[copied];
+                rows[rowCount++].line += lineBase;
+            }
+            report->outOfMemory += ch->count - copied;
+            for (int i = 0; i < ch->badCount && reported < IMPORT_REPORT_ERRORS; i++, reported++) {
+                fprintf(stderr, "line %lld: malformed row\n", lineBase + ch->badLines[i]);
+            }
+            report->malformed += ch->malformed;
+            lineBase += ch->lines;
+        }
+        if (overlong) {
+            lineBase++;
+            report->malformed++;
+            if (reported++ < IMPORT_REPORT_ERRORS) fprintf(stderr, "line %lld: malformed row\n", lineBase);
+            skipping = 1;
+            usable = len;
+        }
+
+        carry = len - usable;
+        memmove(buf, buf + usable, carry);
+        if (got == 0) break;
+    }
+    fclose(fp);
+    free(buf);
+    for (int t = 0; t < IMPORT_MAX_THREADS; t++) free(chunks[t].rows);
+    report->lines = lineBase;
+
+    // One pass under the write lock: dedupe and append
+    IdMap fileIds = { NULL, 0, 0 };
+    idMapClear(&fileIds, (int)rowCount);
+    pthread_rwlock_wrlock(&inv->inventoryLock);
+    int hadNameIndex = inv->nameReady;
+    if (!reserveInventory(inv, inv->productCount + (int)rowCount)) {
+        report->outOfMemory += rowCount;
+        rowCount = 0;
+    }
+    for (long long i = 0; i < rowCount; i++) {
+        const Product* p = &rows[i].product;
+        const char* problem = NULL;
+        if (idMapGet(&fileIds, p->id) >= 0) {
+            report->duplicates++;
+            problem = "duplicate id in file";
+        } else if (indexFind(inv, p->id) >= 0) {
+            report->existing++;
+            problem = "id already exists";
+        }
+        idMapPut(&fileIds, p->id, 0);
+        if (problem != NULL) {
+            if (reported++ < IMPORT_REPORT_ERRORS) fprintf(stderr, "line %lld: %s (ID %d)\n", rows[i].line, problem, p->id);
+            continue;
+        }
+        if (storeAppend(inv, p) < 0) {
+            report->outOfMemory += rowCount - i;
+            break;
+        }
+        ledgerRecord(inv, p->id, p->quantity, MOVE_IMPORT);
+        report->imported++;
+    }
+    if (report->imported > 0) {
+        alertRebuild(inv);
+        statsRebuild(inv);
+        // Cheaper to rebuild the screen indexes than to insert row by row
+        viewIndexDrop(inv);
+        nameIndexDrop(inv);
+    }
+    pthread_rwlock_unlock(&inv->inventoryLock);
+    if (report->imported > 0 && hadNameIndex) {
+        pthread_t indexer;
+        if (pthread_create(&indexer, NULL, nameIndexMain, inv) == 0) pthread_detach(indexer);
+    }
+    free(fileIds.slots);
+    free(rows);
+    if (reported > IMPORT_REPORT_ERRORS) fprintf(stderr, "... %d more problems not shown\n", reported - IMPORT_REPORT_ERRORS);
+    if (report->outOfMemory > 0) printf("Out of memory importing %s: %lld rows not imported!\n", path, report->outOfMemory);
+
+    if (report->imported == 0) return report->outOfMemory == 0;
+    char msg[80];
+    snprintf(msg, sizeof(msg), "Imported %lld products from CSV", report->imported);
+    logActivity(inv, msg);
+    metricRecord(METRIC_IMPORT, t0);
+    return journalCheckpoint(inv) && report->outOfMemory == 0;
+}
+
+// ---------------- CSV Export ----------------
+// Exports work on a private copy of the matching products, taken under the
+// write lock so quantities are consistent with each other. Rows are then
+// formatted in parallel, one slice per thread into its own buffer, and the
+// buffers are written in order with one fwrite each. exportStart runs the
+// formatting and writing on a background thread so the GUI keeps drawing.
+
+#define EXPORT_SLICE_ROWS 65536     // Rows formatted per thread per round
+// Longest formatted row: id, a name of nothing but quotes (each doubled,
+// plus the surrounding pair), quantity, a clamped price and the longer
+// type, with the four commas
+#define EXPORT_ROW_MAX (11 + 2 * (sizeof(((Product*)0)->name) - 1) + 2 + 11 + 12 + sizeof(",Finished Good\n") - 1 + 3)
+
+typedef struct {
+    Product* rows;
+    int count;
+    FILE* out;
+    int closeOut;           // fclose `out` when done (not for stdout)
+    char path[256];
+    long long startNs;      // metricStart() when the snapshot was taken
+    Inventory* inv;
+} ExportJob;
+
+typedef struct {
+    const Product* rows;
+    int count;
+    char* buf;
+    size_t len;
+} ExportSlice;
+
+int exportMatch(const ExportFilter* f, const Product* p) {
+    if (f == NULL) return 1;
+    if (f->type >= 0 && (int)p->type != f->type) return 0;
+    if (f->lowStockOnly && p->quantity >= p->reorderLevel) return 0;
+    if (f->minId > 0 && p->id < f->minId) return 0;
+    if (f->maxId > 0 && p->id > f->maxId) return 0;
+    return 1;
+}
+
+// Writes v in decimal at out; returns the length.
+int formatInt(char* out, long long v) {
+    char tmp[24];
+    int n = 0, len = 0;
+    unsigned long long u = v < 0 ? (unsigned long long)(-(v + 1)) + 1 : (unsigned long long)v;
+    do {
+        tmp[n++] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u > 0);
+    if (v < 0) out[len++] = '-';
+    while (n > 0) out[len++] = tmp[--n];
+    return len;
+}
+
+// Formats one row as exportToCSV always has, quoting names that contain a
+// comma or quote. Returns the length.
+int formatCsvRow(char* out, const Product* p) {
+    char* c = out;
+    c += formatInt(c, p->id);
+    *c++ = ',';
+    if (strpbrk(p->name, ",\"") != NULL) {
+        *c++ = '"';
+        for (const char* s = p->name; *s; s++) {
+            if (*s == '"') *c++ = '"';
+            *c++ = *s;
+        }
+        *c++ = '"';
+    } else {
+        size_t len = strlen(p->name);
+        memcpy(c, p->name, len);
+        c += len;
+    }
+    *c++ = ',';
+    c += formatInt(c, p->quantity);
+    *c++ = ',';
+    // Price with two decimals, rounded like %.2f; clamped so a price that
+    // predates the MAX_PRICE check can't overflow the conversion
+    double price = p->price;
+    if (price != price) price = 0;
+    else if (price > MAX_PRICE) price = MAX_PRICE;
+    else if (price < -MAX_PRICE) price = -MAX_PRICE;
+    long long cents = (long long)(price * 100.0 + (price < 0 ? -0.5 : 0.5));
+    if (cents < 0) {
+        *c++ = '-';
+        cents = -cents;
+    }
+    c += formatInt(c, cents / 100);
+    *c++ = '.';
+    *c++ = (char)('0' + (cents / 10) % 10);
+    *c++ = (char)('0' + cents % 10);
+    const char* type = p->type == RAW_MATERIAL ? ",Raw Material\n" : ",Finished Good\n";
+    size_t typeLen = strlen(type);
+    memcpy(c, type, typeLen);
+    c += typeLen;
+    return (int)(c - out);
+}
+
+void* exportSliceMain(void* arg) {
+    ExportSlice* s = arg;
+    s->len = 0;
+    for (int i = 0; i < s->count; i++) s->len += (size_t)formatCsvRow(s->buf + s->len, &s->rows[i]);
+    return NULL;
+}
+
+// Copies the products matching f, in display order. Returns NULL if out of
+// memory.
+ExportJob* exportSnapshot(Inventory* inv, const ExportFilter* f) {
+    ExportJob* job = calloc(1, sizeof(ExportJob));
+    if (job == NULL) return NULL;
+    job->startNs = metricStart();
+    job->inv = inv;
+    pthread_rwlock_wrlock(&inv->inventoryLock);
+    job->rows = malloc((size_t)(inv->productCount > 0 ? inv->productCount : 1) * sizeof(Product));
+    if (job->rows != NULL) {
+        for (int k = 0; k < inv->orderLen; k++) {
+            int pos = inv->orderPos[k];
+            if (pos >= 0 && exportMatch(f, &inv->products[pos])) job->rows[job->count++] = inv->products[pos];
+        }
+    }
+    pthread_rwlock_unlock(&inv->inventoryLock);
+    if (job->rows == NULL) {
+        free(job);
+        return NULL;
+    }
+    return job;
+}
+
+// Formats and writes a job, then frees it. Returns 1 on success.
+int exportWrite(Inventory* inv, ExportJob* job) {
+    int threads = importThreadCount();
+    ExportSlice slices[IMPORT_MAX_THREADS];
+    int ok = 1;
+    for (int t = 0; t < threads; t++) {
+        slices[t].buf = malloc((size_t)EXPORT_SLICE_ROWS * EXPORT_ROW_MAX);
+        if (slices[t].buf == NULL) ok = 0;
+    }
+
+    atomic_store(&inv->exportRowsWritten, 0);
+    const char* header = "ID,Name,Quantity,Price,Type\n";
+    if (ok && fwrite(header, 1, strlen(header), job->out) != strlen(header)) ok = 0;
+    for (int next = 0; ok && next < job->count; ) {
+        int used = 0;
+        for (int t = 0; t < threads && next < job->count; t++) {
+            slices[t].rows = job->rows + next;
+            slices[t].count = job->count - next < EXPORT_SLICE_ROWS ? job->count - next : EXPORT_SLICE_ROWS;
+            next += slices[t].count;
+            used++;
+        }
+        pthread_t tids[IMPORT_MAX_THREADS];
+        int started[IMPORT_MAX_THREADS] = {0};
+        for (int t = 1; t < used; t++) started[t] = pthread_create(&tids[t], NULL, exportSliceMain, &slices[t]) == 0;
+        exportSliceMain(&slices[0]);
+        for (int t = 1; t < used; t++) {
+            if (started[t]) pthread_join(tids[t], NULL);
+            else exportSliceMain(&slices[t]);
+        }
+        for (int t = 0; t < used && ok; t++) {
+            if (fwrite(slices[t].buf, 1, slices[t].len, job->out) != slices[t].len) ok = 0;
+            atomic_fetch_add(&inv->exportRowsWritten, slices[t].count);
+        }
+    }
+    if (fflush(job->out) != 0) ok = 0;
+    if (job->closeOut && fclose(job->out) != 0) ok = 0;
+
+    for (int t = 0; t < threads; t++) free(slices[t].buf);
+    if (ok) logEvent(inv, LOG_EXPORT, 0, job->count, NULL);
+    else fprintf(stderr, "Error writing %s!\n", job->path);
+    metricRecord(METRIC_EXPORT, job->startNs);
+    free(job->rows);
+    free(job);
+    return ok;
+}
+
+// Exports the products matching f (NULL = all) to path, or to stdout if
+// path is "-". Returns the number of rows written, or -1 on error.
+long long exportCSV(Inventory* inv, const char* path, const ExportFilter* f) {
+    FILE* out = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+    if (out == NULL) return -1;
+    ExportJob* job = exportSnapshot(inv, f);
+    if (job == NULL) {
+        if (out != stdout) fclose(out);
+        return -1;
+    }
+    job->out = out;
+    job->closeOut = out != stdout;
+    snprintf(job->path, sizeof(job->path), "%s", path);
+    long long count = job->count;
+    return exportWrite(inv, job) ? count : -1;
+}
+
+void* exportJobMain(void* arg) {
+    ExportJob* job = arg;
+    Inventory* inv = job->inv;    // exportWrite frees the job
+    atomic_store(&inv->exportLastResult, exportWrite(inv, job));
+    atomic_store(&inv->exportBusy, 0);
+    return NULL;
+}
+
+// Starts a background export of the products matching f to path. The copy
+// is taken before returning; progress is in exportRowsWritten and the
+// outcome in exportLastResult. Returns 0 if one is already running or it
+// couldn't start.
+int exportStart(Inventory* inv, const char* path, const ExportFilter* f) {
+    int idle = 0;
+    if (!atomic_compare_exchange_strong(&inv->exportBusy, &idle, 1)) return 0;
+    FILE* out = fopen(path, "wb");
+    ExportJob* job = out ? exportSnapshot(inv, f) : NULL;
+    pthread_t worker;
+    if (job != NULL) {
+        job->out = out;
+        job->closeOut = 1;
+        snprintf(job->path, sizeof(job->path), "%s", path);
+        atomic_store(&inv->exportRowsWritten, 0);
+        atomic_store(&inv->exportLastResult, -1);
+        if (pthread_create(&worker, NULL, exportJobMain, job) == 0) {
+            pthread_detach(worker);
+            return 1;
+        }
+        free(job->rows);
+        free(job);
+    }
+    if (out) fclose(out);
+    atomic_store(&inv->exportBusy, 0);
+    return 0;
+}
+
+// Everything to CSVFILE, synchronously (server EXPORT op).
+void exportToCSV(Inventory* inv) {
+    exportCSV(inv, inv->csvPath, NULL);
+}
+
+void initializeSystem(Inventory* inv) {
+    loadInventory(inv);
+    loggerStart(inv);
+
+    pthread_t indexer;
+    if (pthread_create(&indexer, NULL, nameIndexMain, inv) == 0) pthread_detach(indexer);
+    else nameIndexBuild(inv);
+}
+
+// ---------------- Product Columns ----------------
+// The store is an array of Product records (it is the snapshot file's
+// layout, mapped in place), so a scan over quantities or prices also pulls
+// every name through the cache: 4 useful bytes in 72. Screens don't scan
+// any more (see Low Stock Alerts and Stock Statistics), but bulk analysis
+// over millions of products can take a columnar copy instead: one array
+// per field and the names interned into a single arena, each distinct name
+// stored once.
+//
+// The scan kernels below work on those arrays 8 products at a time with
+// GCC/Clang vector extensions, which become SSE2/AVX2 (or NEON) code
+// depending on the target flags, with a scalar loop for the tail and for
+// other compilers.
+
+#if defined(__GNUC__)
+#define COLUMNS_SIMD 1
+typedef int ColumnsInt8 __attribute__((vector_size(32)));
+typedef long long ColumnsLong4 __attribute__((vector_size(32)));     // Same bits as ColumnsInt8
+typedef long long ColumnsLong8 __attribute__((vector_size(64)));
+#endif
+
+// Appends a name to the arena, or finds the copy already there. `table`
+// holds arena offsets + 1 (0 = empty) and is at least twice the number of
+// distinct names. Returns COLUMNS_NO_NAME if the arena can't grow.
+#define COLUMNS_NO_NAME 0xffffffffU
+
+unsigned int columnsIntern(ProductColumns* c, unsigned int* table, unsigned int mask, const char* name) {
+    size_t len = strlen(name);
+    unsigned int slot = fnv1a(name, len, 2166136261U) & mask;
+    while (table[slot] != 0) {
+        const char* seen = c->names + table[slot] - 1;
+        if (strcmp(seen, name) == 0) return table[slot] - 1;
+        slot = (slot + 1) & mask;
+    }
+    if (c->namesLen + len + 1 > c->namesCapacity) {
+        size_t newCap = c->namesCapacity ? c->namesCapacity * 2 : 4096;
+        while (newCap < c->namesLen + len + 1) newCap *= 2;
+        char* grown = realloc(c->names, newCap);
+        if (grown == NULL) return COLUMNS_NO_NAME;
+        c->names = grown;
+        c->namesCapacity = newCap;
+    }
+    unsigned int offset = (unsigned int)c->namesLen;
+    memcpy(c->names + offset, name, len + 1);
+    c->namesLen += len + 1;
+    table[slot] = offset + 1;
+    return offset;
+}
+
+// Takes a columnar copy of the store (in array order). Returns 0 if out of
+// memory; release with columnsFree either way.
+int columnsBuild(Inventory* inv, ProductColumns* c) {
+    memset(c, 0, sizeof(*c));
+    pthread_rwlock_rdlock(&inv->inventoryLock);
+    int n = inv->productCount;
+    size_t cells = (size_t)n + 1;
+    c->id = malloc(cells * sizeof(int));
+    c->quantity = malloc(cells * sizeof(int));
+    c->reorderLevel = malloc(cells * sizeof(int));
+    c->type = malloc(cells * sizeof(int));
+    c->price = malloc(cells * sizeof(float));
+    c->priceCents = malloc(cells * sizeof(int));
+    c->nameOffset = malloc(cells * sizeof(unsigned int));
+    unsigned int tableSize = 16;
+    while (tableSize < cells * 2) tableSize *= 2;
+    unsigned int* table = calloc(tableSize, sizeof(unsigned int));
+    int ok = c->id && c->quantity && c->reorderLevel && c->type && c->price && c->priceCents && c->nameOffset && table;
+    for (int i = 0; i < n && ok; i++) {
+        const Product* p = &inv->products[i];
+        c->id[i] = p->id;
+        c->quantity[i] = __atomic_load_n(&p->quantity, __ATOMIC_RELAXED);
+        c->reorderLevel[i] = __atomic_load_n(&p->reorderLevel, __ATOMIC_RELAXED);
+        c->type[i] = p->type;
+        c->price[i] = p->price;
+        long long cents = priceCents(p->price);
+        c->priceCents[i] = cents > 0x7fffffffLL ? 0x7fffffff : cents < -0x7fffffffLL ? -0x7fffffff : (int)cents;
+        c->nameOffset[i] = columnsIntern(c, table, tableSize - 1, p->name);
+        if (c->nameOffset[i] == COLUMNS_NO_NAME) ok = 0;
+    }
+    pthread_rwlock_unlock(&inv->inventoryLock);
+    free(table);
+    c->count = ok ? n : 0;
+    return ok;
+}
+
+void columnsFree(ProductColumns* c) {
+    free(c->id);
+    free(c->quantity);
+    free(c->reorderLevel);
+    free(c->type);
+    free(c->price);
+    free(c->priceCents);
+    free(c->nameOffset);
+    free(c->names);
+    memset(c, 0, sizeof(*c));
+}
+
+// Positions of the products below their reorder level, in order. `out`
+// must have room for c->count entries. Returns how many.
+int columnsLowStock(const ProductColumns* c, int* out) {
+    int found = 0, i = 0;
+#ifdef COLUMNS_SIMD
+    for (; i + 8 <= c->count; i += 8) {
+        ColumnsInt8 q, r;
+        memcpy(&q, c->quantity + i, sizeof(q));
+        memcpy(&r, c->reorderLevel + i, sizeof(r));
+        ColumnsInt8 low = q < r;
+        // Most blocks have no low stock at all: test the mask as 4 words
+        ColumnsLong4 words = (ColumnsLong4)low;
+        if ((words[0] | words[1] | words[2] | words[3]) == 0) continue;
+        for (int k = 0; k < 8; k++) {
+            if (low[k]) out[found++] = i + k;
+        }
+    }
+#endif
+    for (; i < c->count; i++) {
+        if (c->quantity[i] < c->reorderLevel[i]) out[found++] = i;
+    }
+    return found;
+}
+
+// Total units and the largest quantity (0 for no products).
+void columnsQtySumMax(const ProductColumns* c, long long* sum, int* max) {
+    long long total = 0;
+    int best = c->count > 0 ? c->quantity[0] : 0;
+    int i = 0;
+#ifdef COLUMNS_SIMD
+    if (c->count >= 8) {
+        ColumnsLong8 sums = {0};
+        ColumnsInt8 maxes;
+        memcpy(&maxes, c->quantity, sizeof(maxes));
+        for (; i + 8 <= c->count; i += 8) {
+            ColumnsInt8 q;
+            memcpy(&q, c->quantity + i, sizeof(q));
+            sums += __builtin_convertvector(q, ColumnsLong8);
+            ColumnsInt8 more = q > maxes;
+            maxes = (q & more) | (maxes & ~more);
+        }
+        for (int k = 0; k < 8; k++) {
+            total += sums[k];
+            if (maxes[k] > best) best = maxes[k];
+        }
+    }
+#endif
+    for (; i < c->count; i++) {
+        total += c->quantity[i];
+        if (c->quantity[i] > best) best = c->quantity[i];
+    }
+    *sum = total;
+    *max = best;
+}
+
+// Units and stock value (quantity x price, in cents) per product type,
+// indexed like StockStats (0 = raw materials, 1 = finished goods).
+void columnsValuation(const ProductColumns* c, long long units[2], long long valueCents[2]) {
+    long long allUnits = 0, allValue = 0, finishedUnits = 0, finishedValue = 0;
+    int i = 0;
+#ifdef COLUMNS_SIMD
+    ColumnsLong8 u = {0}, v = {0}, fu = {0}, fv = {0};
+    for (; i + 8 <= c->count; i += 8) {
+        ColumnsInt8 q, cents, type;
+        memcpy(&q, c->quantity + i, sizeof(q));
+        memcpy(&cents, c->priceCents + i, sizeof(cents));
+        memcpy(&type, c->type + i, sizeof(type));
+        ColumnsLong8 wq = __builtin_convertvector(q, ColumnsLong8);
+        ColumnsLong8 value = wq * __builtin_convertvector(cents, ColumnsLong8);
+        ColumnsLong8 finished = __builtin_convertvector(type != RAW_MATERIAL, ColumnsLong8);
+        u += wq;
+        v += value;
+        fu += wq & finished;
+        fv += value & finished;
+    }
+    for (int k = 0; k < 8; k++) {
+        allUnits += u[k];
+        allValue += v[k];
+        finishedUnits += fu[k];
+        finishedValue += fv[k];
+    }
+#endif
+    for (; i < c->count; i++) {
+        long long value = (long long)c->quantity[i] * c->priceCents[i];
+        allUnits += c->quantity[i];
+        allValue += value;
+        if (c->type[i] != RAW_MATERIAL) {
+            finishedUnits += c->quantity[i];
+            finishedValue += value;
+        }
+    }
+    units[0] = allUnits - finishedUnits;
+    units[1] = finishedUnits;
+    valueCents[0] = allValue - finishedValue;
+    valueCents[1] = finishedValue;
+}
+
+// ---------------- Bills of Materials ----------------
+// A finished good (or subassembly) can list the components one unit of it
+// takes. In memory each parent has its own list, sorted by component and
+// found through an IdMap, so an edit only touches one product's lines.
+// BOMFILE is append-only: every edit adds a "parent,component,qtyPer"
+// line (qtyPer 0 removes) that overrides earlier ones, and loading
+// rewrites the file once overridden lines outnumber live ones. Edits take
+// inventoryLock exclusively and refuse anything that would make a product
+// part of itself, so the graph always stays acyclic.
+//
+// produceProduct builds a product from stock: it consumes the direct
+// components and adds the finished units, all or nothing. mrpPlan answers
+// what a set of orders would take (see Material Requirements Planning).
+
+// The list of `parent`'s lines, created empty if `create` is set.
+BomList* bomList(Inventory* inv, int parent, int create) {
+    int slot = idMapGet(&inv->bomParents, parent);
+    if (slot >= 0) return &inv->bomLists[slot];
+    if (!create) return NULL;
+    if (inv->bomListCount == inv->bomListCapacity) {
+        int newCap = inv->bomListCapacity ? inv->bomListCapacity * 2 : 64;
+        BomList* grown = realloc(inv->bomLists, (size_t)newCap * sizeof(BomList));
+        if (grown == NULL) return NULL;
+        inv->bomLists = grown;
+        inv->bomListCapacity = newCap;
+    }
+    BomList* list = &inv->bomLists[inv->bomListCount];
+    memset(list, 0, sizeof(*list));
+    list->parent = parent;
+    idMapPut(&inv->bomParents, parent, inv->bomListCount++);
+    return list;
+}
+
+// Lines of `parent` (NULL if it has none); *count gets how many.
+const BomLine* bomFind(Inventory* inv, int parent, int* count) {
+    BomList* list = bomList(inv, parent, 0);
+    *count = list != NULL ? list->count : 0;
+    return *count > 0 ? list->lines : NULL;
+}
+
+// Sets one line in memory (qtyPer 0 removes it). Returns 0 if out of memory.
+int bomApply(Inventory* inv, int parent, int component, int qtyPer) {
+    BomList* list = bomList(inv, parent, qtyPer > 0);
+    if (list == NULL) return qtyPer == 0;
+    int at = 0;
+    while (at < list->count && list->lines[at].component < component) at++;
+    int found = at < list->count && list->lines[at].component == component;
+    if (qtyPer == 0) {
+        if (found) {
+            memmove(&list->lines[at], &list->lines[at + 1], (size_t)(list->count - at - 1) * sizeof(BomLine));
+            list->count--;
+        }
+        return 1;
+    }
+    if (found) {
+        list->lines[at].qtyPer = qtyPer;
+        return 1;
+    }
+    if (list->count == list->capacity) {
+        int newCap = list->capacity ? list->capacity * 2 : 4;
+        BomLine* grown = realloc(list->lines, (size_t)newCap * sizeof(BomLine));
+        if (grown == NULL) return 0;
+        list->lines = grown;
+        list->capacity = newCap;
+    }
+    memmove(&list->lines[at + 1], &list->lines[at], (size_t)(list->count - at) * sizeof(BomLine));
+    BomLine b = { parent, component, qtyPer };
+    list->lines[at] = b;
+    list->count++;
+    return 1;
+}
+
+void bomRelease(Inventory* inv) {
+    for (int i = 0; i < inv->bomListCount; i++) free(inv->bomLists[i].lines);
+    inv->bomListCount = 0;
+    idMapClear(&inv->bomParents, 0);
+    inv->bomLiveLines = inv->bomFileLines = 0;
+}
+
+// Rewrites BOMFILE with only the live lines (temp file + sync + rename).
+int bomCompact(Inventory* inv) {
+    char tmpPath[INVENTORY_PATH_LEN + 4];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", inv->bomPath);
+    FILE* fp = fopen(tmpPath, "w");
+    if (fp == NULL) return 0;
+    for (int i = 0; i < inv->bomListCount; i++) {
+        const BomList* list = &inv->bomLists[i];
+        for (int j = 0; j < list->count; j++) {
+            fprintf(fp, "%d,%d,%d\n", list->parent, list->lines[j].component, list->lines[j].qtyPer);
+        }
+    }
+    if (syncFile(fp) != 0 || fclose(fp) != 0 || replaceFile(tmpPath, inv->bomPath) != 0) {
+        remove(tmpPath);
+        return 0;
+    }
+    inv->bomFileLines = inv->bomLiveLines;
+    return 1;
+}
+
+void bomLoad(Inventory* inv) {
+    bomRelease(inv);
+    FILE* fp = fopen(inv->bomPath, "r");
+    if (fp == NULL) return;
+    char line[128];
+    int parent, component, qtyPer;
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%d,%d,%d", &parent, &component, &qtyPer) != 3 || qtyPer < 0) continue;
+        bomApply(inv, parent, component, qtyPer);
+        inv->bomFileLines++;
+    }
+    fclose(fp);
+    for (int i = 0; i < inv->bomListCount; i++) inv->bomLiveLines += inv->bomLists[i].count;
+    if (inv->bomFileLines > 2 * inv->bomLiveLines + 64) bomCompact(inv);
+}
+
+// Returns 1 if `target` is `from` or one of its components, at any depth.
+int bomReaches(Inventory* inv, int from, int target) {
+    IdMap seen = { NULL, 0, 0 };
+    int* stack = malloc(64 * sizeof(int));
+    int depth = 0, capacity = 64, found = 0;
+    if (stack == NULL || !idMapClear(&seen, 64)) found = 1;     // Can't tell: refuse
+    else stack[depth++] = from;
+    while (depth > 0 && !found) {
+        int id = stack[--depth];
+        if (id == target) found = 1;
+        if (found || idMapGet(&seen, id) >= 0) continue;
+        idMapPut(&seen, id, 0);
+        int count;
+        const BomLine* lines = bomFind(inv, id, &count);
+        for (int i = 0; i < count && !found; i++) {
+            if (depth == capacity) {
+                int* grown = realloc(stack, (size_t)capacity * 2 * sizeof(int));
+                if (grown == NULL) {
+                    found = 1;
+                    break;
+                }
+                stack = grown;
+                capacity *= 2;
+            }
+            stack[depth++] = lines[i].component;
+        }
+    }
+    free(stack);
+    free(seen.slots);
+    return found;
+}
+
+// Sets how many units of `component` one unit of `parent` takes (0 removes
+// the line). Returns 0 if a product is missing or it would make a cycle.
+int bomSet(Inventory* inv, int parent, int component, int qtyPer) {
+    if (qtyPer < 0) return 0;
+    pthread_rwlock_wrlock(&inv->inventoryLock);
+    int count, ok = 1;
+    const BomLine* lines = bomFind(inv, parent, &count);
+    int existed = 0;
+    for (int i = 0; i < count; i++) existed |= lines[i].component == component;
+
+    if (qtyPer > 0 && (indexFind(inv, parent) < 0 || indexFind(inv, component) < 0)) {
+        printf("Error: both products must exist!\n");
+        ok = 0;
+    } else if (qtyPer > 0 && !existed && bomReaches(inv, component, parent)) {
+        printf("Error: product %d is already made from product %d!\n", component, parent);
+        ok = 0;
+    } else if (qtyPer == 0 && !existed) {
+        ok = 1;     // Nothing to remove
+    } else {
+        FILE* fp = fopen(inv->bomPath, "a");
+        ok = fp != NULL && fprintf(fp, "%d,%d,%d\n", parent, component, qtyPer) > 0;
+        if (fp != NULL) ok = syncFile(fp) == 0 && fclose(fp) == 0 && ok;
+        if (!ok) printf("Error saving bill of materials!\n");
+        else if (!bomApply(inv, parent, component, qtyPer)) ok = 0;
+        else {
+            inv->bomFileLines++;
+            inv->bomLiveLines += qtyPer == 0 ? -1 : !existed;
+        }
+    }
+    pthread_rwlock_unlock(&inv->inventoryLock);
+    return ok;
+}
+
+// Copies up to `max` lines of parent's bill. Returns how many it has.
+int bomCopy(Inventory* inv, int parent, BomLine* out, int max) {
+    pthread_rwlock_rdlock(&inv->inventoryLock);
+    int count;
+    const BomLine* lines = bomFind(inv, parent, &count);
+    for (int i = 0; i < count && i < max; i++) out[i] = lines[i];
+    pthread_rwlock_unlock(&inv->inventoryLock);
+    return count;
+}
+
+// Applies a quantity change with its journal, ledger, log and index
+// updates. inventoryLock must be held exclusively.
+void stockAdjustLocked(Inventory* inv, Product* p, int delta, LogAction action) {
+    int cur = p->quantity;
+    p->quantity = cur + delta;
+    journalAppendAdjust(inv, p, delta);
+    ledgerRecord(inv, p->id, delta, movementKind(action));
+    logEvent(inv, action, p->id, delta < 0 ? -delta : delta, p->name);
+    alertTrack(inv, p, cur, p->quantity);
+    statsTrack(inv, p, cur, p->quantity);
+    viewTrackUpdate(inv, p);
+}
+
+// Builds qty units of a product from its direct components, which must
+// all be in stock. Returns TXN_NOT_FOUND if it has no bill of materials.
+TxnResult produceProduct(Inventory* inv, int id, int qty) {
+    if (qty <= 0) return TXN_INVALID_QTY;
+    pthread_rwlock_wrlock(&inv->inventoryLock);
+    Product* p = searchProduct(inv, id);
+    int count;
+    const BomLine* lines = bomFind(inv, id, &count);
+    TxnResult r = p == NULL || count == 0 ? TXN_NOT_FOUND : TXN_OK;
+    if (r == TXN_OK && p->quantity > 0x7fffffff - qty) r = TXN_INVALID_QTY;
+    for (int i = 0; i < count && r == TXN_OK; i++) {
+        Product* c = searchProduct(inv, lines[i].component);
+        if (c == NULL) r = TXN_NOT_FOUND;
+        else if ((long long)lines[i].qtyPer * qty > c->quantity) r = TXN_INSUFFICIENT_STOCK;
+    }
+    if (r == TXN_OK) {
+        long long cost = 0;
+        for (int i = 0; i < count; i++) {
+            Product* c = searchProduct(inv, lines[i].component);
+            cost += lotTakeLocked(inv, c, c->quantity, lines[i].qtyPer * qty);
+            stockAdjustLocked(inv, c, -lines[i].qtyPer * qty, LOG_CONSUME);
+        }
+        lotReceiveLocked(inv, p, qty, (cost + qty / 2) / qty, 0);
+        stockAdjustLocked(inv, p, qty, LOG_PRODUCE);
+    }
+    pthread_rwlock_unlock(&inv->inventoryLock);
+    return r;
+}
+
+// ---------------- Material Requirements Planning ----------------
+// mrpPlan explodes a set of orders through the bills of materials: every
+// item gets a low-level code (its longest distance from an ordered item),
+// so by the time a level is processed all of its gross requirement is
+// known. Each item then nets against stock on hand; what is left is built
+// (adding to its components' requirements one level down) or, for items
+// with no bill, reported short. Items within a level don't depend on each
+// other, so large levels are split across threads, which add into the
+// components' requirements atomically.
+
+#define MRP_PARALLEL_MIN 2048       // Items in a level before it is split across threads
+
+typedef struct {
+    int* ids;                   // Dense item number -> product id
+    int* bomFirst;              // First of the item's lines in component/qtyPer
+    int* bomCount;
+    int* component;             // Per BOM line: dense item of the component
+    int* qtyPer;
+    int* level;
+    long long* stock;
+    atomic_llong* gross;
+    long long* fromStock;
+    long long* produce;
+    int* order;                 // Items by level
+} MrpWork;
+
+typedef struct {
+    MrpWork* w;
+    int from;
+    int to;                     // Range of w->order
+} MrpSlice;
+
+void* mrpSliceMain(void* arg) {
+    MrpSlice* s = arg;
+    MrpWork* w = s->w;
+    for (int k = s->from; k < s->to; k++) {
+        int i = w->order[k];
+        long long need = atomic_load_explicit(&w->gross[i], memory_order_relaxed);
+        long long take = need < w->stock[i] ? need : w->stock[i];
+        long long net = need - take;
+        w->fromStock[i] = take;
+        w->produce[i] = w->bomCount[i] > 0 ? net : 0;
+        if (net == 0) continue;
+        for (int j = w->bomFirst[i]; j < w->bomFirst[i] + w->bomCount[i]; j++) {
+            atomic_fetch_add_explicit(&w->gross[w->component[j]], net * w->qtyPer[j], memory_order_relaxed);
+        }
+    }
+    return NULL;
+}
+
+// Grows an int array to hold at least `needed` entries.
+int mrpGrow(int** array, int* capacity, int needed) {
+    if (needed <= *capacity) return 1;
+    int newCap = *capacity ? *capacity * 2 : 1024;
+    while (newCap < needed) newCap *= 2;
+    int* grown = realloc(*array, (size_t)newCap * sizeof(int));
+    if (grown == NULL) return 0;
+    *array = grown;
+    *capacity = newCap;
+    return 1;
+}
+
+int mrpLineCompare(const void* a, const void* b) {
+    const MrpLine* x = a;
+    const MrpLine* y = b;
+    if (x->level != y->level) return x->level - y->level;
+    return (x->id > y->id) - (x->id < y->id);
+}
+
+// Plans the orders against current stock. The plan's lines cover every
+// item involved; release them with mrpFree. Returns 0 if memory ran out.
+int mrpPlan(Inventory* inv, const MrpOrder* orders, int count, MrpPlan* plan) {
+    memset(plan, 0, sizeof(*plan));
+    MrpWork w;
+    memset(&w, 0, sizeof(w));
+    IdMap items = { NULL, 0, 0 };
+    int n = 0, lineCount = 0;
+    int idCap = 0, firstCap = 0, countCap = 0, compCap = 0, qtyCap = 0;
+
+    pthread_rwlock_rdlock(&inv->inventoryLock);
+    int ok = idMapClear(&items, count);
+
+    // Every item reachable from the orders, breadth first
+    for (int o = 0; o < count && ok; o++) {
+        if (idMapGet(&items, orders[o].id) >= 0) continue;
+        if (!(ok = mrpGrow(&w.ids, &idCap, n + 1))) break;
+        idMapPut(&items, orders[o].id, n);
+        w.ids[n++] = orders[o].id;
+    }
+    for (int i = 0; i < n && ok; i++) {
+        int lines;
+        const BomLine* bom = bomFind(inv, w.ids[i], &lines);
+        ok = mrpGrow(&w.bomFirst, &firstCap, i + 1) && mrpGrow(&w.bomCount, &countCap, i + 1) &&
+             mrpGrow(&w.component, &compCap, lineCount + lines) && mrpGrow(&w.qtyPer, &qtyCap, lineCount + lines);
+        if (!ok) break;
+        w.bomFirst[i] = lineCount;
+        w.bomCount[i] = lines;
+        for (int j = 0; j < lines && ok; j++) {
+            int dense = idMapGet(&items, bom[j].component);
+            if (dense < 0) {
+                if (!(ok = mrpGrow(&w.ids, &idCap, n + 1))) break;
+                dense = n;
+                idMapPut(&items, bom[j].component, n);
+                w.ids[n++] = bom[j].component;
+            }
+            w.component[lineCount] = dense;
+            w.qtyPer[lineCount++] = bom[j].qtyPer;
+        }
+    }
+
+    w.level = calloc((size_t)n + 1, sizeof(int));
+    w.stock = malloc(((size_t)n + 1) * sizeof(long long));
+    w.gross = calloc((size_t)n + 1, sizeof(atomic_llong));
+    w.fromStock = calloc((size_t)n + 1, sizeof(long long));
+    w.produce = calloc((size_t)n + 1, sizeof(long long));
+    w.order = malloc(((size_t)n + 1) * sizeof(int));
+    int* pending = calloc((size_t)n + 1, sizeof(int));      // Parents not yet leveled
+    int* sorted = malloc(((size_t)n + 1) * sizeof(int));
+    int* start = NULL;
+    int levels = 0;
+    ok = ok && w.level && w.stock && w.gross && w.fromStock && w.produce && w.order && pending && sorted;
+
+    if (ok) {
+        for (int i = 0; i < n; i++) {
+            const Product* p = searchProduct(inv, w.ids[i]);
+            w.stock[i] = p != NULL ? __atomic_load_n(&p->quantity, __ATOMIC_ACQUIRE) : 0;
+            for (int j = w.bomFirst[i]; j < w.bomFirst[i] + w.bomCount[i]; j++) pending[w.component[j]]++;
+        }
+        for (int o = 0; o < count; o++) {
+            if (orders[o].qty > 0) atomic_fetch_add(&w.gross[idMapGet(&items, orders[o].id)], orders[o].qty);
+        }
+
+        // Topological order (Kahn); an item's level is one below its deepest parent
+        int head = 0, tail = 0;
+        for (int i = 0; i < n; i++) if (pending[i] == 0) w.order[tail++] = i;
+        while (head < tail) {
+            int i = w.order[head++];
+            for (int j = w.bomFirst[i]; j < w.bomFirst[i] + w.bomCount[i]; j++) {
+                int c = w.component[j];
+                if (w.level[c] < w.level[i] + 1) w.level[c] = w.level[i] + 1;
+                if (--pending[c] == 0) w.order[tail++] = c;
+            }
+        }
+
+        if (tail < n) {
+            printf("Error: the bills of materials contain a cycle!\n");     // Only from a hand-edited BOMFILE
+            ok = 0;
+        }
+        for (int i = 0; i < n; i++) if (w.level[i] + 1 > levels) levels = w.level[i] + 1;
+        start = calloc((size_t)levels + 2, sizeof(int));
+        ok = ok && start != NULL;
+    }
+    if (ok) {
+        // Group by level (stable counting sort), then run the levels in order
+        for (int i = 0; i < n; i++) start[w.level[i] + 1]++;
+        for (int l = 0; l < levels; l++) start[l + 1] += start[l];
+        memcpy(pending, start, (size_t)levels * sizeof(int));
+        for (int k = 0; k < n; k++) sorted[pending[w.level[w.order[k]]]++] = w.order[k];
+        int* topo = w.order;
+        w.order = sorted;
+        sorted = topo;
+
+        int threads = importThreadCount();
+        for (int l = 0; l < levels; l++) {
+            int from = start[l], size = start[l + 1] - start[l];
+            int used = size >= MRP_PARALLEL_MIN ? threads : 1;
+            MrpSlice slices[IMPORT_MAX_THREADS];
+            pthread_t tids[IMPORT_MAX_THREADS];
+            int started[IMPORT_MAX_THREADS] = {0};
+            for (int t = 0; t < used; t++) {
+                slices[t].w = &w;
+                slices[t].from = from + (int)((long long)size * t / used);
+                slices[t].to = from + (int)((long long)size * (t + 1) / used);
+            }
+            for (int t = 1; t < used; t++) started[t] = pthread_create(&tids[t], NULL, mrpSliceMain, &slices[t]) == 0;
+            mrpSliceMain(&slices[0]);
+            for (int t = 1; t < used; t++) {
+                if (started[t]) pthread_join(tids[t], NULL);
+                else mrpSliceMain(&slices[t]);
+            }
+        }
+        plan->levels = levels;
+    }
+    pthread_rwlock_unlock(&inv->inventoryLock);
+
+    if (ok && (plan->lines = malloc(((size_t)n + 1) * sizeof(MrpLine))) != NULL) {
+        for (int i = 0; i < n; i++) {
+            MrpLine* line = &plan->lines[i];
+            line->id = w.ids[i];
+            line->level = w.level[i];
+            line->gross = atomic_load(&w.gross[i]);
+            line->fromStock = w.fromStock[i];
+            line->produce = w.produce[i];
+            line->shortage = line->gross - line->fromStock - line->produce;
+            if (line->shortage > 0) plan->shortItems++;
+        }
+        plan->count = n;
+        qsort(plan->lines, (size_t)n, sizeof(MrpLine), mrpLineCompare);
+    } else {
+        ok = 0;
+    }
+
+    free(items.slots);
+    free(w.ids);
+    free(w.bomFirst);
+    free(w.bomCount);
+    free(w.component);
+    free(w.qtyPer);
+    free(w.level);
+    free(w.stock);
+    free(w.gross);
+    free(w.fromStock);
+    free(w.produce);
+    free(w.order);
+    free(pending);
+    free(sorted);
+    free(start);
+    return ok;
+}
+
+void mrpFree(MrpPlan* plan) {
+    free(plan->lines);
+    memset(plan, 0, sizeof(*plan));
+}
+
+// ---------------- Activity Log Replay ----------------
+// Rebuilds the store from LOGFILE alone, as of any point in time, for when
+// the snapshot and journal are lost. The file is mapped and cut at line
+// boundaries into one chunk per thread (as in CSV Import). Each thread
+// folds its chunk into one ReplayState per product it touches: either a
+// quantity delta (sales, purchases, transfers, production) or, once an
+// add, stock update or delete is seen, an absolute quantity plus the
+// deltas after it.
+// Those fold together associatively, so the per-chunk states are merged
+// in file order and only the products touched are ever applied, however
+// long the log.
+//
+// The log only carries ids, names, quantities and reorder levels. Price
+// and type are kept from the product with the same id already in the
+// store, if any. Add lines written before they carried the quantity
+// ("Added product: X (ID: k)") start the product at 0 units.
+
+typedef struct {
+    int id;
+    signed char present;        // 1 = exists, 0 = deleted
+    char hasQty;                // qty is absolute (else a delta on an unknown start)
+    char hasReorder;
+    int reorder;                // -1 = reset by an add or delete, level unknown
+    long long qty;
+    const char* name;           // Points into the mapped log
+    int nameLen;
+} ReplayState;
+
+typedef struct {
+    const char* start;          // Whole lines only
+    const char* end;
+    long long until;            // Ignore lines stamped later (epoch seconds, <0 = none)
+    IdMap ids;                  // id -> index in states
+    ReplayState* states;
+    int count;
+    int capacity;
+    ReplayReport report;
+    char lastStamp[24];         // Last ctime stamp parsed and its value
+    long long lastTime;
+    int hourKey;                // mktime is only called once per hour of log
+    long long hourTime;
+} ReplayChunk;
+
+// Parses a ctime() stamp ("Sat Oct 17 02:08:44 2026", local time) into
+// epoch seconds, or -1.
+long long replayParseTime(ReplayChunk* ch, const char* s, const char* end) {
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    if (end - s != 24) return -1;
+    if (memcmp(s, ch->lastStamp, 24) == 0) return ch->lastTime;
+
+    int mon = 0;
+    while (mon < 12 && memcmp(months + mon * 3, s + 4, 3) != 0) mon++;
+    int day = (s[8] == ' ' ? 0 : s[8] - '0') * 10 + (s[9] - '0');
+    int hour = (s[11] - '0') * 10 + (s[12] - '0');
+    int min = (s[14] - '0') * 10 + (s[15] - '0');
+    int sec = (s[17] - '0') * 10 + (s[18] - '0');
+    int year = (s[20] - '0') * 1000 + (s[21] - '0') * 100 + (s[22] - '0') * 10 + (s[23] - '0');
+    if (mon == 12 || day < 1 || day > 31 || hour > 23 || min > 59 || sec > 60 || year < 1970) return -1;
+
+    int key = ((year * 12 + mon) * 31 + day) * 24 + hour;
+    if (key != ch->hourKey) {
+        struct tm tm;
+        memset(&tm, 0, sizeof(tm));
+        tm.tm_year = year - 1900;
+        tm.tm_mon = mon;
+        tm.tm_mday = day;
+        tm.tm_hour = hour;
+        tm.tm_isdst = -1;
+        ch->hourTime = (long long)mktime(&tm);
+        ch->hourKey = key;
+    }
+    memcpy(ch->lastStamp, s, 24);
+    ch->lastTime = ch->hourTime + min * 60 + sec;
+    return ch->lastTime;
+}
+
+// Skips `prefix` at *p. Returns 0 (leaving *p alone) if it isn't there.
+int skipPrefix(const char** p, const char* end, const char* prefix) {
+    size_t n = strlen(prefix);
+    if ((size_t)(end - *p) < n || memcmp(*p, prefix, n) != 0) return 0;
+    *p += n;
+    return 1;
+}
+
+// Finds the last " (ID: k)" in [a, end): the product name lies before it,
+// and may itself contain brackets. Returns its start and the id, or NULL.
+const char* replayIdTag(const char* a, const char* end, int* id, const char** after) {
+    for (const char* p = end - 8; p >= a; p--) {
+        if (*p != ' ' || memcmp(p, " (ID: ", 6) != 0) continue;
+        const char* q = p + 6;
+        if (!parseIntField(&q, end, id) || q >= end || *q != ')') continue;
+        *after = q + 1;
+        return p;
+    }
+    return NULL;
+}
+
+ReplayState* replayState(ReplayChunk* ch, int id) {
+    int slot = idMapGet(&ch->ids, id);
+    if (slot >= 0) return &ch->states[slot];
+    if (ch->count == ch->capacity) {
+        int newCap = ch->capacity ? ch->capacity * 2 : 1024;
+        ReplayState* grown = realloc(ch->states, (size_t)newCap * sizeof(ReplayState));
+        if (grown == NULL) return NULL;
+        ch->states = grown;
+        ch->capacity = newCap;
+    }
+    ReplayState* s = &ch->states[ch->count];
+    memset(s, 0, sizeof(*s));
+    s->id = id;
+    s->present = 1;
+    idMapPut(&ch->ids, id, ch->count++);
+    return s;
+}
+
+// Applies one "Action: ..." text. Returns 0 if it isn't a stock change.
+int replayAction(ReplayChunk* ch, const char* a, const char* end) {
+    int id, qty = 0, sign = 0, absolute = -1, reorderReset = 0;
+    const char* name = NULL;
+    const char* nameEnd = NULL;
+    const char* after;
+
+    if (skipPrefix(&a, end, "Sale: ") || skipPrefix(&a, end, "Transfer out: ") || skipPrefix(&a, end, "Consumed: ")) sign = -1;
+    else if (skipPrefix(&a, end, "Purchase: ") || skipPrefix(&a, end, "Transfer in: ") || skipPrefix(&a, end, "Produced: ")) sign = 1;
+
+    if (sign != 0) {
+        // "N units of NAME (ID: k)"
+        if (!parseIntField(&a, end, &qty) || !skipPrefix(&a, end, "units of ")) return 0;
+        name = a;
+        if ((nameEnd = replayIdTag(a, end, &id, &after)) == NULL) return 0;
+    } else if (skipPrefix(&a, end, "Updated stock for ID ")) {
+        if (!parseIntField(&a, end, &id) || !skipPrefix(&a, end, "to ") || !parseIntField(&a, end, &absolute)) return 0;
+    } else if (skipPrefix(&a, end, "Set reorder level for ID ")) {
+        int level;
+        if (!parseIntField(&a, end, &id) || !skipPrefix(&a, end, "to ") || !parseIntField(&a, end, &level)) return 0;
+        ReplayState* s = replayState(ch, id);
+        if (s == NULL) return 0;
+        s->hasReorder = 1;
+        s->reorder = level;
+        return 1;
+    } else if (skipPrefix(&a, end, "Added product: ")) {
+        // "NAME (ID: k) with N units" ("NAME (ID: k)" before quantities were logged)
+        name = a;
+        if ((nameEnd = replayIdTag(a, end, &id, &after)) == NULL) return 0;
+        absolute = 0;
+        if (!skipPrefix(&after, end, " with ") || !parseIntField(&after, end, &absolute)) ch->report.unknownAdds++;
+        reorderReset = 1;
+    } else if (skipPrefix(&a, end, "Deleted product: ")) {
+        name = a;
+        if ((nameEnd = replayIdTag(a, end, &id, &after)) == NULL) return 0;
+        ReplayState* s = replayState(ch, id);
+        if (s == NULL) return 0;
+        s->present = 0;
+        s->hasQty = 1;
+        s->qty = 0;
+        s->hasReorder = 1;
+        s->reorder = -1;
+        return 1;
+    } else {
+        return 0;
+    }
+
+    ReplayState* s = replayState(ch, id);
+    if (s == NULL) return 0;
+    s->present = 1;
+    if (name != NULL) {
+        s->name = name;
+        s->nameLen = (int)(nameEnd - name);
+    }
+    if (reorderReset) {
+        // The add line doesn't carry the level: fall back to the store's
+        s->hasReorder = 1;
+        s->reorder = -1;
+    }
+    if (absolute >= 0) {
+        s->hasQty = 1;
+        s->qty = absolute;
+    } else {
+        s->qty += (long long)sign * qty;
+    }
+    return 1;
+}
+
+void* replayChunkMain(void* arg) {
+    ReplayChunk* ch = arg;
+    ch->hourKey = -1;
+    idMapClear(&ch->ids, 1024);
+    const char* line = ch->start;
+    while (line < ch->end) {
+        const char* nl = memchr(line, '\n', (size_t)(ch->end - line));
+        const char* end = nl ? nl : ch->end;
+        const char* next = nl ? nl + 1 : ch->end;
+        if (end > line && end[-1] == '\r') end--;
+        ch->report.lines++;
+
+        // "[time] User: X | Action: ..."
+        const char* close = line < end && *line == '[' ? memchr(line, ']', (size_t)(end - line)) : NULL;
+        const char* bar = close ? memchr(close, '|', (size_t)(end - close)) : NULL;
+        const char* a = bar;
+        if (bar == NULL || !skipPrefix(&a, end, "| Action: ")) {
+            ch->report.malformed++;
+        } else {
+            long long t = replayParseTime(ch, line + 1, close);
+            if (ch->until >= 0 && t > ch->until) ch->report.later++;
+            else if (replayAction(ch, a, end)) ch->report.events++;
+        }
+        line = next;
+    }
+    return NULL;
+}
+
+// Folds `b` (later in the log) into `a`.
+void replayMerge(ReplayState* a, const ReplayState* b) {
+    if (b->hasQty) {
+        a->hasQty = 1;
+        a->qty = b->qty;
+    } else {
+        a->qty += b->qty;
+    }
+    a->present = b->present;
+    if (b->name != NULL) {
+        a->name = b->name;
+        a->nameLen = b->nameLen;
+    }
+    if (b->hasReorder) {
+        a->hasReorder = 1;
+        a->reorder = b->reorder;
+    }
+}
+
+int productIdCompare(const void* a, const void* b) {
+    int x = ((const Product*)a)->id, y = ((const Product*)b)->id;
+    return (x > y) - (x < y);
+}
+
+// Replaces the store with its state as of `until` (epoch seconds, <0 for
+// the end of the log), rebuilt from the activity log at `path`. Nothing is
+// written to disk. Returns 0 if the log can't be read.
+int replayActivityLog(Inventory* inv, const char* path, long long until, ReplayReport* report) {
+    memset(report, 0, sizeof(*report));
+    const char* base = NULL;
+    size_t size = 0;
+#ifdef _WIN32
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) return 0;
+    fseek(fp, 0, SEEK_END);
+    size = (size_t)ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char* heap = size > 0 ? malloc(size) : NULL;
+    if (size > 0 && (heap == NULL || fread(heap, 1, size, fp) != size)) {
+        free(heap);
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+    base = heap;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return 0;
+    }
+    size = (size_t)st.st_size;
+    if (size > 0) {
+        void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            return 0;
+        }
+        madvise(map, size, MADV_WILLNEED);
+        base = map;
+    }
+    close(fd);
+#endif
+
+    // Cut into one chunk per thread at line boundaries
+    int threads = importThreadCount();
+    ReplayChunk chunks[IMPORT_MAX_THREADS];
+    memset(chunks, 0, sizeof(chunks));
+    const char* pos = base;
+    const char* end = base + size;
+    int used = 0;
+    for (int t = 0; t < threads && pos < end; t++) {
+        const char* cut = t == threads - 1 ? end : pos + (end - pos) / (threads - t);
+        if (cut < end) {
+            const char* nl = memchr(cut, '\n', (size_t)(end - cut));
+            cut = nl ? nl + 1 : end;
+        }
+        chunks[t].start = pos;
+        chunks[t].end = cut;
+        chunks[t].until = until;
+        pos = cut;
+        used++;
+    }
+    pthread_t tids[IMPORT_MAX_THREADS];
+    int started[IMPORT_MAX_THREADS] = {0};
+    for (int t = 1; t < used; t++) started[t] = pthread_create(&tids[t], NULL, replayChunkMain, &chunks[t]) == 0;
+    if (used > 0) replayChunkMain(&chunks[0]);
+    for (int t = 1; t < used; t++) {
+        if (started[t]) pthread_join(tids[t], NULL);
+        else replayChunkMain(&chunks[t]);
+    }
+
+    // Merge the chunks in file order
+    ReplayChunk all;
+    memset(&all, 0, sizeof(all));
+    idMapClear(&all.ids, chunks[0].count);
+    int ok = 1;
+    for (int t = 0; t < used && ok; t++) {
+        ReplayChunk* ch = &chunks[t];
+        for (int i = 0; i < ch->count; i++) {
+            int slot = idMapGet(&all.ids, ch->states[i].id);
+            if (slot >= 0) {
+                replayMerge(&all.states[slot], &ch->states[i]);
+                continue;
+            }
+            ReplayState* s = replayState(&all, ch->states[i].id);
+            if (s == NULL) {
+                ok = 0;
+                break;
+            }
+            *s = ch->states[i];
+        }
+        report->lines += ch->report.lines;
+        report->events += ch->report.events;
+        report->malformed += ch->report.malformed;
+        report->later += ch->report.later;
+        report->unknownAdds += ch->report.unknownAdds;
+    }
+
+    // Live products, with price and type from the current store
+    Product* rebuilt = ok ? malloc((size_t)(all.count > 0 ? all.count : 1) * sizeof(Product)) : NULL;
+    int rebuiltCount = 0;
+    pthread_rwlock_wrlock(&inv->inventoryLock);
+    if (rebuilt != NULL) {
+        for (int i = 0; i < all.count; i++) {
+            const ReplayState* s = &all.states[i];
+            if (!s->present) continue;
+            Product* p = &rebuilt[rebuiltCount++];
+            memset(p, 0, sizeof(*p));
+            p->id = s->id;
+            int len = s->nameLen < (int)sizeof(p->name) - 1 ? s->nameLen : (int)sizeof(p->name) - 1;
+            if (s->name != NULL) memcpy(p->name, s->name, (size_t)len);
+            if (!s->hasQty) report->partial++;
+            p->quantity = s->qty < 0 ? 0 : s->qty > 0x7fffffffLL ? 0x7fffffff : (int)s->qty;
+            p->type = RAW_MATERIAL;
+            p->reorderLevel = LOW_STOCK_THRESHOLD;
+            int index = indexFind(inv, s->id);
+            if (index >= 0) {
+                const Product* old = &inv->products[index];
+                p->price = old->price;
+                p->type = old->type;
+                p->reorderLevel = old->reorderLevel;
+                if (s->name == NULL) memcpy(p->name, old->name, sizeof(p->name));
+            }
+            if (s->hasReorder && s->reorder >= 0) p->reorderLevel = s->reorder;
+        }
+        qsort(rebuilt, (size_t)rebuiltCount, sizeof(Product), productIdCompare);
+
+        releaseInventory(inv);
+        inv->productCount = 0;
+        if (reserveInventory(inv, rebuiltCount)) {
+            rebuildIndex(inv, 0);
+            for (int i = 0; i < rebuiltCount; i++) storeAppend(inv, &rebuilt[i]);
+        } else {
+            ok = 0;
+        }
+        alertRebuild(inv);
+        statsRebuild(inv);
+        lotRelease(inv);    // The replayed stock has no lot history
+        viewIndexDrop(inv);
+        nameIndexDrop(inv);
+        report->products = inv->productCount;
+    }
+    pthread_rwlock_unlock(&inv->inventoryLock);
+
+    free(rebuilt);
+    for (int t = 0; t < used; t++) {
+        free(chunks[t].ids.slots);
+        free(chunks[t].states);
+    }
+    free(all.ids.slots);
+    free(all.states);
+#ifdef _WIN32
+    free(heap);
+#else
+    if (size > 0) munmap((void*)base, size);
+#endif
+    return ok && rebuilt != NULL;
+}
+
+// ---------------- Inventory Context ----------------
+// An Inventory owns everything the functions above work on. inventoryCreate
+// only sets it up empty; loadInventory / initializeSystem read its files.
+// Its files are named as before (inventory.bin, inventory.journal...)
+// inside `dir`, so two inventories must not share a directory.
+
+void inventoryPath(char* out, const char* dir, const char* name) {
+    if (dir == NULL || dir[0] == '\0') snprintf(out, INVENTORY_PATH_LEN, "%s", name);
+    else snprintf(out, INVENTORY_PATH_LEN, "%s/%s", dir, name);
+}
+
+// Returns NULL if out of memory. dir NULL or "" = the working directory.
+Inventory* inventoryCreate(const char* dir) {
+    Inventory* inv = calloc(1, sizeof(Inventory));
+    if (inv == NULL) return NULL;
+    pthread_rwlock_init(&inv->inventoryLock, NULL);
+    pthread_mutex_init(&inv->alertMutex, NULL);
+    pthread_mutex_init(&inv->statsMutex, NULL);
+    pthread_mutex_init(&inv->viewMutex, NULL);
+    pthread_mutex_init(&inv->nameMutex, NULL);
+    pthread_mutex_init(&inv->journalMutex, NULL);
+    pthread_mutex_init(&inv->ledgerMutex, NULL);
+    for (int s = 0; s < LOT_STRIPES; s++) pthread_mutex_init(&inv->lotStripes[s].lock, NULL);
+    atomic_store(&inv->lotNextId, 1);
+    inv->ledgerLastCheckpoint = -1;
+    pthread_mutex_init(&inv->logViewMutex, NULL);
+    pthread_mutex_init(&inv->loggerMutex, NULL);
+    pthread_cond_init(&inv->loggerWake, NULL);
+    inv->maxQtyHeap.sign = 1;
+    inv->minQtyHeap.sign = -1;
+    inv->viewRowsFilter = FILTER_ALL;
+    inv->journalAutoCommit = 1;
+    inv->logViewOffset = -1;
+    atomic_store(&inv->exportLastResult, -1);
+    inventoryPath(inv->snapshotPath, dir, SNAPSHOTFILE);
+    inventoryPath(inv->journalPath, dir, JOURNALFILE);
+    inventoryPath(inv->ledgerPath, dir, LEDGERFILE);
+    inventoryPath(inv->ledgerIndexPath, dir, LEDGERINDEXFILE);
+    inventoryPath(inv->bomPath, dir, BOMFILE);
+    inventoryPath(inv->lotPath, dir, LOTFILE);
+    inventoryPath(inv->logPath, dir, LOGFILE);
+    inventoryPath(inv->textPath, dir, FILENAME);
+    inventoryPath(inv->csvPath, dir, CSVFILE);
+    return inv;
+}
+
+// Stops the logger, commits and closes the journal, and frees everything.
+// Waits for a background export to finish first. The name index thread
+// started by initializeSystem must have finished too (nameReady).
+void inventoryDestroy(Inventory* inv) {
+    if (inv == NULL) return;
+    while (atomic_load(&inv->exportBusy)) sleepMs(1);
+    loggerShutdown(inv);
+    journalClose(inv);
+    ledgerClose(inv);
+    free(inv->ledgerQty);
+    bomRelease(inv);
+    free(inv->bomLists);
+    free(inv->bomParents.slots);
+    lotClose(inv);
+    lotRelease(inv);
+    for (int s = 0; s < LOT_STRIPES; s++) {
+        free(inv->lotStripes[s].products);
+        free(inv->lotStripes[s].index.slots);
+    }
+    viewIndexDrop(inv);
+    nameIndexDrop(inv);
+    releaseInventory(inv);
+    free(inv->productIndex.slots);
+    free(inv->orderPos);
+    free(inv->slotOrder);
+    free(inv->alertHeap);
+    free(inv->alertSlots.slots);
+    free(inv->maxQtyHeap.items);
+    free(inv->maxQtyHeap.slots.slots);
+    free(inv->minQtyHeap.items);
+    free(inv->minQtyHeap.slots.slots);
+    free(inv->viewQtyKey.slots);
+    free(inv->viewRows);
+    free(inv->namePostings);
+    free(inv->nameTrigrams.slots);
+    pthread_rwlock_destroy(&inv->inventoryLock);
+    pthread_mutex_destroy(&inv->alertMutex);
+    pthread_mutex_destroy(&inv->statsMutex);
+    pthread_mutex_destroy(&inv->viewMutex);
+    pthread_mutex_destroy(&inv->nameMutex);
+    pthread_mutex_destroy(&inv->journalMutex);
+    pthread_mutex_destroy(&inv->ledgerMutex);
+    for (int s = 0; s < LOT_STRIPES; s++) pthread_mutex_destroy(&inv->lotStripes[s].lock);
+    pthread_mutex_destroy(&inv->logViewMutex);
+    pthread_mutex_destroy(&inv->loggerMutex);
+    pthread_cond_destroy(&inv->loggerWake);
+    free(inv);
+}
+
+// ---------------- Warehouses ----------------
+// A company with several plants and stores keeps one Inventory per site,
+// in <dir>/site1, <dir>/site2..., so stock is tracked per (product, site)
+// and each site has its own snapshot, journal and activity log. A product
+// id means the same part everywhere; a site only lists the products it
+// has stocked.
+//
+// Each site is owned by a worker thread. Work is posted to it as tasks
+// (run in order, as the posting user) and the worker commits the site's
+// journal in between, so sites proceed in parallel and never wait on each
+// other's fsyncs. Transfers run one leg on each site; company-wide queries
+// fan out to every site at once and merge the answers.
+
+void* warehouseMain(void* arg) {
+    Warehouse* w = arg;
+    int pending = 0;        // Journal records waiting for their group commit
+    for (;;) {
+        pthread_mutex_lock(&w->queueMutex);
+        if (w->head == NULL && w->running) {
+            if (pending) {
+                struct timespec until;
+                clock_gettime(CLOCK_REALTIME, &until);
+                long waitMs = JOURNAL_COMMIT_MS / 4 + 1;
+                until.tv_nsec += waitMs * 1000000L;
+                if (until.tv_nsec >= 1000000000L) { until.tv_sec++; until.tv_nsec -= 1000000000L; }
+                pthread_cond_timedwait(&w->queueWake, &w->queueMutex, &until);
+            } else {
+                pthread_cond_wait(&w->queueWake, &w->queueMutex);
+            }
+        }
+        WarehouseTask* task = w->head;
+        if (task != NULL) {
+            w->head = task->next;
+            if (w->head == NULL) w->tail = NULL;
+        }
+        int running = w->running;
+        pthread_mutex_unlock(&w->queueMutex);
+
+        if (task != NULL) {
+            currentUser = task->user;
+            task->run(w->inv, task->arg);
+            pthread_mutex_lock(&w->company->doneMutex);
+            task->done = 1;
+            pthread_cond_broadcast(&w->company->doneWake);
+            pthread_mutex_unlock(&w->company->doneMutex);
+        } else if (!running) {
+            break;
+        }
+        pending = journalTick(w->inv);
+    }
+    return NULL;
+}
+
+// Queues a task on a site's worker (1-based site). The task must stay
+// valid until companyWait returns for it.
+void companyPost(Company* c, int site, WarehouseTask* task) {
+    Warehouse* w = &c->sites[site - 1];
+    task->user = currentUser;
+    task->done = 0;
+    task->next = NULL;
+    pthread_mutex_lock(&w->queueMutex);
+    if (w->tail) w->tail->next = task;
+    else w->head = task;
+    w->tail = task;
+    pthread_cond_signal(&w->queueWake);
+    pthread_mutex_unlock(&w->queueMutex);
+}
+
+void companyWait(Company* c, WarehouseTask* task) {
+    pthread_mutex_lock(&c->doneMutex);
+    while (!task->done) pthread_cond_wait(&c->doneWake, &c->doneMutex);
+    pthread_mutex_unlock(&c->doneMutex);
+}
+
+void companyRun(Company* c, int site, void (*run)(Inventory* inv, void* arg), void* arg) {
+    WarehouseTask task;
+    task.run = run;
+    task.arg = arg;
+    companyPost(c, site, &task);
+    companyWait(c, &task);
+}
+
+// Runs `run` on every site at once, with the site's slot of `args` (an
+// array of argSize-byte items, one per site), and waits for all of them.
+void companyFanOut(Company* c, void (*run)(Inventory* inv, void* arg), void* args, size_t argSize) {
+    WarehouseTask tasks[MAX_WAREHOUSES];
+    for (int k = 0; k < c->count; k++) {
+        tasks[k].run = run;
+        tasks[k].arg = (char*)args + (size_t)k * argSize;
+        companyPost(c, k + 1, &tasks[k]);
+    }
+    for (int k = 0; k < c->count; k++) companyWait(c, &tasks[k]);
+}
+
+// Directory of a site, created if missing. Returns 0 if it can't be.
+int warehousePath(char* out, const char* dir, int site) {
+    struct stat st;
+    snprintf(out, INVENTORY_PATH_LEN, "%s/site%d", dir, site);
+    makeDir(dir);
+    makeDir(out);
+    return stat(out, &st) == 0;
+}
+
+// Highest site number that exists under dir (0 = none). Opening that
+// many sites creates any missing ones in between, empty.
+int warehouseCount(const char* dir) {
+    struct stat st;
+    char path[INVENTORY_PATH_LEN];
+    int count = 0;
+    for (int site = 1; site <= MAX_WAREHOUSES; site++) {
+        snprintf(path, sizeof(path), "%s/site%d", dir, site);
+        if (stat(path, &st) == 0) count = site;
+    }
+    return count;
+}
+
+void warehouseOpenTask(Inventory* inv, void* arg) {
+    (void)arg;
+    loadInventory(inv);
+    loggerStart(inv);
+}
+
+void warehouseCloseTask(Inventory* inv, void* arg) {
+    (void)arg;
+    loggerShutdown(inv);
+    journalCheckpoint(inv);
+}
+
+// Opens (creating as needed) sites 1..count under dir and loads them in
+// parallel. Returns NULL on error.
+Company* companyOpen(const char* dir, int count) {
+    if (count < 1 || count > MAX_WAREHOUSES) return NULL;
+    Company* c = calloc(1, sizeof(Company));
+    if (c == NULL) return NULL;
+    pthread_mutex_init(&c->doneMutex, NULL);
+    pthread_cond_init(&c->doneWake, NULL);
+    for (int k = 0; k < count; k++) {
+        Warehouse* w = &c->sites[k];
+        char path[INVENTORY_PATH_LEN];
+        if (!warehousePath(path, dir, k + 1) || (w->inv = inventoryCreate(path)) == NULL) {
+            printf("Error opening warehouse %d!\n", k + 1);
+            companyClose(c);
+            return NULL;
+        }
+        w->site = k + 1;
+        w->company = c;
+        pthread_mutex_init(&w->queueMutex, NULL);
+        pthread_cond_init(&w->queueWake, NULL);
+        w->running = 1;
+        c->count = k + 1;
+        if (pthread_create(&w->worker, NULL, warehouseMain, w) != 0) {
+            w->running = 0;
+            printf("Error starting warehouse %d!\n", k + 1);
+            companyClose(c);
+            return NULL;
+        }
+    }
+    char unused[MAX_WAREHOUSES];
+    companyFanOut(c, warehouseOpenTask, unused, 1);
+    c->loaded = 1;
+    return c;
+}
+
+// Checkpoints every site (in parallel), stops the workers and frees it all.
+void companyClose(Company* c) {
+    if (c == NULL) return;
+    // Only once loaded: checkpointing an unloaded site would overwrite its files
+    if (c->loaded) {
+        char unused[MAX_WAREHOUSES];
+        companyFanOut(c, warehouseCloseTask, unused, 1);
+    }
+    for (int k = 0; k < c->count; k++) {
+        Warehouse* w = &c->sites[k];
+        if (w->running) {
+            pthread_mutex_lock(&w->queueMutex);
+            w->running = 0;
+            pthread_cond_signal(&w->queueWake);
+            pthread_mutex_unlock(&w->queueMutex);
+            pthread_join(w->worker, NULL);
+        }
+        inventoryDestroy(w->inv);
+        pthread_mutex_destroy(&w->queueMutex);
+        pthread_cond_destroy(&w->queueWake);
+    }
+    pthread_mutex_destroy(&c->doneMutex);
+    pthread_cond_destroy(&c->doneWake);
+    free(c);
+}
+
+typedef struct {
+    int id;
+    int qty;
+    LogAction action;
+    Product product;        // Filled by the outgoing leg: the product as listed at the source
+    TxnResult result;
+} TransferLeg;
+
+void transferOutTask(Inventory* inv, void* arg) {
+    TransferLeg* leg = arg;
+    pthread_rwlock_rdlock(&inv->inventoryLock);
+    Product* p = searchProduct(inv, leg->id);
+    if (p != NULL) leg->product = *p;
+    pthread_rwlock_unlock(&inv->inventoryLock);
+    leg->result = p != NULL ? stockTake(inv, leg->id, leg->qty, leg->action) : TXN_NOT_FOUND;
+}
+
+void transferInTask(Inventory* inv, void* arg) {
+    TransferLeg* leg = arg;
+    pthread_rwlock_rdlock(&inv->inventoryLock);
+    int listed = searchProduct(inv, leg->id) != NULL;
+    pthread_rwlock_unlock(&inv->inventoryLock);
+    // First delivery to this site: list the product with the source's details
+    if (!listed) {
+        const Product* p = &leg->product;
+        addProduct(inv, p->id, p->name, 0, p->price, p->type, p->reorderLevel);
+    }
+    leg->result = stockGive(inv, leg->id, leg->qty, leg->action, -1, 0);
+}
+
+// Moves qty units of a product from one site to another (1-based). The
+// units leave the source first, so stock never goes negative there; if
+// the destination can't take them they go back. Each leg is journaled by
+// its own site: a crash between the two legs loses the units in transit,
+// and the activity logs show a "Transfer out" without its "Transfer in".
+TxnResult companyTransfer(Company* c, int from, int to, int id, int qty) {
+    if (from < 1 || from > c->count || to < 1 || to > c->count || from == to) return TXN_NOT_FOUND;
+    long long t0 = metricStart();
+    TransferLeg out = { .id = id, .qty = qty, .action = LOG_TRANSFER_OUT };
+    companyRun(c, from, transferOutTask, &out);
+    if (out.result != TXN_OK) {
+        metricRecord(METRIC_TRANSFER, t0);
+        return out.result;
+    }
+    TransferLeg in = out;
+    in.action = LOG_TRANSFER_IN;
+    companyRun(c, to, transferInTask, &in);
+    if (in.result != TXN_OK) {
+        TransferLeg back = in;
+        companyRun(c, from, transferInTask, &back);
+        if (back.result != TXN_OK) printf("Error returning %d units of product %d to site %d!\n", qty, id, from);
+    }
+    metricRecord(METRIC_TRANSFER, t0);
+    return in.result;
+}
+
+typedef struct {
+    int id;
+    int quantity;           // -1 = not stocked at this site
+} StockQuery;
+
+void stockQueryTask(Inventory* inv, void* arg) {
+    StockQuery* q = arg;
+    pthread_rwlock_rdlock(&inv->inventoryLock);
+    Product* p = searchProduct(inv, q->id);
+    q->quantity = p != NULL ? __atomic_load_n(&p->quantity, __ATOMIC_ACQUIRE) : -1;
+    pthread_rwlock_unlock(&inv->inventoryLock);
+}
+
+// Units of a product on hand across the company, or -1 if no site lists
+// it. perSite (optional, one per site) gets each site's quantity or -1.
+long long companyStock(Company* c, int id, int* perSite) {
+    StockQuery q[MAX_WAREHOUSES];
+    for (int k = 0; k < c->count; k++) q[k].id = id;
+    companyFanOut(c, stockQueryTask, q, sizeof(StockQuery));
+    long long total = -1;
+    for (int k = 0; k < c->count; k++) {
+        if (perSite) perSite[k] = q[k].quantity;
+        if (q[k].quantity >= 0) total = (total < 0 ? 0 : total) + q[k].quantity;
+    }
+    return total;
+}
+
+void statsTask(Inventory* inv, void* arg) {
+    QtyEntry maxQ, minQ;
+    statsRead(inv, arg, &maxQ, &minQ);
+}
+
+// Stock statistics summed over every site (a product stocked at two sites
+// counts twice in products/typeCount). perSite is optional.
+void companyStats(Company* c, StockStats* total, StockStats* perSite) {
+    StockStats sites[MAX_WAREHOUSES];
+    companyFanOut(c, statsTask, sites, sizeof(StockStats));
+    memset(total, 0, sizeof(*total));
+    for (int k = 0; k < c->count; k++) {
+        const StockStats* s = &sites[k];
+        total->products += s->products;
+        for (int t = 0; t < 2; t++) {
+            total->typeCount[t] += s->typeCount[t];
+            total->typeUnits[t] += s->typeUnits[t];
+            statsAddValue(&total->typeValueCents[t], s->typeValueCents[t]);
+        }
+        for (int b = 0; b < STATS_BUCKETS; b++) total->histogram[b] += s->histogram[b];
+        if (perSite) perSite[k] = *s;
+    }
+}
+
+typedef struct {
+    AlertEntry* alerts;
+    int max;
+    int shown;
+    int total;
+} AlertQuery;
+
+void alertQueryTask(Inventory* inv, void* arg) {
+    AlertQuery* q = arg;
+    q->shown = alertTop(inv, q->alerts, q->max, &q->total);
+}
+
+int companyAlertCompare(const void* a, const void* b) {
+    const CompanyAlert* x = a;
+    const CompanyAlert* y = b;
+    if (alertLess(&x->alert, &y->alert)) return -1;
+    if (alertLess(&y->alert, &x->alert)) return 1;
+    return (x->site > y->site) - (x->site < y->site);
+}
+
+// The `max` most critical low stock alerts across all sites, most critical
+// first; total gets the number of alerts company-wide. Each site hands over
+// its own top `max`, so only those are merged.
+int companyLowStock(Company* c, CompanyAlert* out, int max, int* total) {
+    *total = 0;
+    if (max <= 0) return 0;
+    AlertEntry* buf = malloc((size_t)c->count * (size_t)max * sizeof(AlertEntry));
+    CompanyAlert* merged = malloc((size_t)c->count * (size_t)max * sizeof(CompanyAlert));
+    if (buf == NULL || merged == NULL) {
+        free(buf);
+        free(merged);
+        return 0;
+    }
+    AlertQuery q[MAX_WAREHOUSES];
+    for (int k = 0; k < c->count; k++) {
+        q[k].alerts = buf + (size_t)k * max;
+        q[k].max = max;
+    }
+    companyFanOut(c, alertQueryTask, q, sizeof(AlertQuery));
+
+    int n = 0;
+    for (int k = 0; k < c->count; k++) {
+        *total += q[k].total;
+        for (int i = 0; i < q[k].shown; i++) {
+            merged[n].site = k + 1;
+            merged[n].alert = q[k].alerts[i];
+            n++;
+        }
+    }
+    qsort(merged, (size_t)n, sizeof(CompanyAlert), companyAlertCompare);
+    if (n > max) n = max;
+    memcpy(out, merged, (size_t)n * sizeof(CompanyAlert));
+    free(buf);
+    free(merged);
+    return n;
+}
@@ -0,0 +1,713 @@
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+// Inventory core: product store, indexes, journal, snapshots, logger and
+// CSV import/export, all held in an Inventory context. No raylib in here,
+// so it links into the GUI (main.c) as well as the headless tools
+// (bench.c), and a process can run any number of inventories side by side.
+
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     // accept4
+#endif
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <direct.h>
+#define makeDir(path) _mkdir(path)
+// Declared by hand: <windows.h> clashes with raylib names (Rectangle, CloseWindow...)
+int __stdcall MoveFileExA(const char* existing, const char* replacement, unsigned long flags);
+#define MOVEFILE_REPLACE_EXISTING 0x1
+#define fsync _commit
+#define ftruncate _chsize
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#define makeDir(path) mkdir(path, 0755)
+#endif
+
+// Constants
+#define INITIAL_CAPACITY 128
+#define LOW_STOCK_THRESHOLD 10
+#define MAX_PRICE 1000000.0f               // Highest unit price accepted, so price in cents x quantity fits a long long
+#define FILENAME "inventory.txt"
+#define LOGFILE "activity_log.txt"
+#define CSVFILE "inventory_export.csv"
+#define CSVIMPORTFILE "inventory_import.csv"
+#define REPLAYFILE "inventory_replayed.txt"
+#define SNAPSHOTFILE "inventory.bin"
+#define JOURNALFILE "inventory.journal"
+#define LEDGERFILE "inventory.ledger"
+#define LEDGERINDEXFILE "inventory.ledger.idx"
+#define BOMFILE "inventory.bom"
+#define LOTFILE "inventory.lots"
+#define JOURNAL_GROUP_COMMIT 64            // Commit after this many pending records...
+#define JOURNAL_COMMIT_MS 200              // ...or once the oldest pending record is this old
+#define JOURNAL_CHECKPOINT_RECORDS 50000   // Fold the journal into a snapshot after this many records
+#define LEDGER_BLOCK 4096                  // Stock movements per ledger block
+#define LEDGER_CHECKPOINT_BLOCKS 64        // Ledger blocks between quantity checkpoints (at least)
+#define LOT_STRIPES 256                    // Stock lot locks, by product id (power of two)
+#define LOG_RING_SIZE 4096                 // Pending log entries (power of two)
+#define LOG_VIEW_LINES 2048                // Recent log lines kept in memory for the Activity Log screen
+#define LOG_LINE_LEN 192
+#define METRICSFILE "metrics.csv"
+#define WAREHOUSE_DIR "warehouses"         // Warehouse k lives in warehouses/site<k>
+#define MAX_WAREHOUSES 64
+#define SERVER_PORT 7070                   // Default loopback TCP port for --serve
+#define SERVER_MAX_FRAME 4096
+#define SERVER_MAX_PENDING (4 * SERVER_MAX_FRAME)   // Unsent reply bytes before a client's input is paused
+#define MAX_USERNAME 50
+#define MAX_PASSWORD 50
+
+// Product Type Enumeration
+typedef enum {
+    RAW_MATERIAL,
+    FINISHED_GOOD
+} ProductType;
+
+// Result of a stock transaction
+typedef enum {
+    TXN_OK,
+    TXN_NOT_FOUND,
+    TXN_INSUFFICIENT_STOCK,
+    TXN_INVALID_QTY
+} TxnResult;
+
+// User Role Enumeration
+typedef enum {
+    ADMIN,
+    STAFF
+} UserRole;
+
+// Product Structure
+typedef struct {
+    int id;
+    char name[50];
+    int quantity;
+    float price;
+    ProductType type;
+    int reorderLevel;   // Low stock alert when quantity drops below this
+} Product;
+
+// Product is also the on-disk record of the binary snapshot, so its layout must not drift.
+_Static_assert(sizeof(Product) == 72, "Product layout is part of the snapshot format");
+
+// User Structure
+typedef struct {
+    char username[MAX_USERNAME];
+    char password[MAX_PASSWORD];
+    UserRole role;
+} User;
+
+// Id -> value hash map (see Product Store & Index in inventory.c)
+#define INDEX_EMPTY   -1
+#define INDEX_DELETED -2
+
+typedef struct {
+    int id;
+    int pos;    // Mapped value (>= 0), or INDEX_EMPTY / INDEX_DELETED
+} IndexSlot;
+
+typedef struct {
+    IndexSlot* slots;
+    int capacity;   // Power of two
+    int used;       // Live entries + tombstones (drives resizing)
+} IdMap;
+
+// Low stock alert, as listed by alertTop
+typedef struct {
+    int id;
+    int quantity;
+    int reorderLevel;
+} AlertEntry;
+
+#define STATS_BUCKETS 16    // [0], [1], [2-3], [4-7], ... [16384+]
+
+typedef struct {
+    int id;
+    int quantity;
+} QtyEntry;
+
+typedef struct {
+    int products;
+    int typeCount[2];               // Indexed by ProductType
+    long long typeUnits[2];
+    long long typeValueCents[2];    // quantity x price, in cents
+    long long histogram[STATS_BUCKETS];
+} StockStats;
+
+// Inventory screen ordering and filters
+typedef enum {
+    SORT_ID,
+    SORT_NAME,
+    SORT_QTY,
+    SORT_PRICE,
+    SORT_TYPE,
+    SORT_KEYS
+} SortKey;
+
+typedef enum {
+    FILTER_ALL,
+    FILTER_RAW,
+    FILTER_FINISHED,
+    FILTER_LOW_STOCK
+} ViewFilter;
+
+typedef enum {
+    LOG_LOGIN,
+    LOG_LOGOUT,
+    LOG_ADD,
+    LOG_UPDATE,
+    LOG_SALE,
+    LOG_PURCHASE,
+    LOG_DELETE,
+    LOG_EXPORT,
+    LOG_REORDER,
+    LOG_TRANSFER_OUT,   // Stock moved to / from another warehouse
+    LOG_TRANSFER_IN,
+    LOG_PRODUCE,        // Finished good built from its bill of materials
+    LOG_CONSUME,        // Component used up by a production run
+    LOG_MESSAGE         // Free text (logActivity)
+} LogAction;
+
+typedef struct {
+    int enabled;            // 0 drops every entry (stress tests, benchmarks)
+    int flushEvery;         // Flush after this many entries...
+    int flushIntervalMs;    // ...or when the oldest unflushed entry is this old
+    unsigned int critical;  // Bitmask of (1 << LogAction) flushed + synced immediately
+} LoggerConfig;
+
+typedef struct {
+    long long lines;
+    long long imported;
+    long long malformed;
+    long long duplicates;   // Id repeated within the file
+    long long existing;     // Id already in the inventory
+    long long outOfMemory;  // Valid rows dropped because memory ran out (the import fails)
+} ImportReport;
+
+typedef struct {
+    long long lines;
+    long long events;       // Stock changes applied
+    long long malformed;    // Not a "[time] User: X | Action: ..." line
+    long long later;        // Stamped after the requested time
+    long long unknownAdds;  // Adds logged without their quantity (started at 0)
+    long long partial;      // Products never added, updated or deleted in the log (started at 0)
+    int products;
+} ReplayReport;
+
+typedef struct {
+    int type;           // RAW_MATERIAL / FINISHED_GOOD, or -1 for both
+    int lowStockOnly;   // Only products below their reorder level
+    int minId;          // Inclusive id range; 0 = unbounded
+    int maxId;
+} ExportFilter;
+
+// Why a quantity changed, as recorded by the stock ledger
+typedef enum {
+    MOVE_ADD,
+    MOVE_DELETE,
+    MOVE_SALE,
+    MOVE_PURCHASE,
+    MOVE_UPDATE,
+    MOVE_TRANSFER_OUT,
+    MOVE_TRANSFER_IN,
+    MOVE_IMPORT,
+    MOVE_PRODUCE,
+    MOVE_CONSUME,
+    MOVE_BASE           // Brings the ledger in line with the store (history it never saw)
+} MovementKind;
+
+// Operations timed by the metrics histograms
+typedef enum {
+    METRIC_ADD,
+    METRIC_UPDATE,
+    METRIC_SALE,
+    METRIC_PURCHASE,
+    METRIC_DELETE,
+    METRIC_LOOKUP,      // Id lookup (searchProduct), sampled
+    METRIC_SEARCH,      // Name search
+    METRIC_SAVE,
+    METRIC_LOAD,
+    METRIC_IMPORT,
+    METRIC_EXPORT,
+    METRIC_TRANSFER,    // Cross-warehouse transfer, both halves
+    METRIC_JOURNAL,     // Journal commit (write + fsync)
+    METRIC_LOG,         // Activity log batch write
+    METRIC_FRAME,       // GUI frame work, recorded by main.c
+    METRIC_OPS
+} MetricOp;
+
+typedef struct {
+    long long count;
+    long long timed;    // Calls with a latency sample
+    double meanUs;
+    double p50Us;
+    double p99Us;
+    double maxUs;
+} MetricSummary;
+
+// Heap of id/quantity pairs (Stock Statistics in inventory.c)
+typedef struct {
+    QtyEntry* items;
+    int size;
+    int capacity;
+    IdMap slots;
+    int sign;               // 1 = max-heap, -1 = min-heap
+} QtyHeap;
+
+// Trigram posting list (Name Search Index)
+typedef struct {
+    int* ids;       // Sorted ascending
+    int count;
+    int capacity;
+} PostingList;
+
+// Activity log entry, as queued for the logger thread
+typedef struct {
+    time_t timestamp;
+    LogAction action;
+    int productId;
+    int quantity;
+    char user[MAX_USERNAME];
+    char text[80];      // Product name, or the message for LOG_MESSAGE
+} LogEntry;
+
+typedef struct {
+    atomic_size_t seq;
+    LogEntry entry;
+} LogCell;
+
+// One receipt of a product, consumed before later ones (Stock Lots)
+typedef struct {
+    int lot;                    // Receipt number, ascending
+    int qty;                    // Units left
+    long long unitCostCents;
+    long long receivedMs;       // ms since the epoch
+    long long expiresMs;        // 0 = does not expire
+} StockLot;
+
+// A product's open lots, as a heap in consumption order
+typedef struct {
+    int id;
+    long long priceCents;       // The product's list price (fixed while it exists)
+    StockLot* lots;
+    int count;
+    int capacity;
+    long long units;            // Units across the lots; the rest of the stock is untracked
+} ProductLots;
+
+// The open lots of the products whose ids hash to one stripe, with their lock
+typedef struct {
+    pthread_mutex_t lock;
+    atomic_int lotted;          // Products here with open lots; 0 = transactions skip the lock
+    ProductLots* products;
+    int count;
+    int capacity;
+    IdMap index;                // Product id -> products slot
+    long long lots;             // Running totals over the stripe's open lots
+    long long units;
+    long long costCents;
+    long long listCents;        // The same units at list price
+    atomic_llong salesCostCents;
+} LotStripe;
+
+// Stock valued at cost: lots at their own cost, untracked units at list price
+typedef struct {
+    long long lots;
+    long long lotUnits;
+    long long lotValueCents;
+    long long untrackedUnits;
+    long long untrackedValueCents;
+    long long valueCents;       // Both together
+    long long salesCostCents;   // Cost of the units sold since the inventory was loaded
+} LotValuation;
+
+// Columnar copy of the store for bulk scans (see Product Columns)
+typedef struct {
+    int count;
+    int* id;
+    int* quantity;
+    int* reorderLevel;
+    int* type;                  // ProductType
+    float* price;
+    int* priceCents;
+    unsigned int* nameOffset;   // Into names; equal names share one copy
+    char* names;                // NUL-terminated, interned
+    size_t namesLen;
+    size_t namesCapacity;
+} ProductColumns;
+
+// Bill of materials line: one unit of parent takes qtyPer units of component
+typedef struct {
+    int parent;
+    int component;
+    int qtyPer;
+} BomLine;
+
+// The bill of materials of one parent, sorted by component
+typedef struct {
+    int parent;
+    BomLine* lines;
+    int count;
+    int capacity;
+} BomList;
+
+// Material requirements for a planned order
+typedef struct {
+    int id;
+    int qty;
+} MrpOrder;
+
+// Outcome for one item of a material requirements plan
+typedef struct {
+    int id;
+    int level;              // 0 = ordered directly; components sit below every parent
+    long long gross;        // Units needed, from orders and parents being built
+    long long fromStock;    // Covered by stock on hand
+    long long produce;      // To build (items with a bill of materials)
+    long long shortage;     // Missing (items without one)
+} MrpLine;
+
+typedef struct {
+    MrpLine* lines;         // In level order, then id
+    int count;
+    int levels;
+    int shortItems;         // Lines with a shortage
+} MrpPlan;
+
+#define INVENTORY_PATH_LEN 256
+
+// One independent inventory: the product store with its indexes, its
+// journal, snapshot and log files, and its logger thread. Every core
+// function takes the inventory it works on, so a process can host several
+// (one per core, one per warehouse...) as long as each has its own
+// directory. Create with inventoryCreate; the fields are the core's
+// business, except where the header exposes them for reading.
+typedef struct Inventory {
+    // Product Store & Index
+    Product* products;              // Growable product store (see reserveInventory)
+    int productCount;
+    int inventoryCapacity;
+    void* inventoryMapBase;         // Set while products points into a mapped snapshot
+    size_t inventoryMapLen;
+    // Structural lock for the store. Transactions (sale, purchase, stock
+    // update) take it shared and change quantities with atomic operations;
+    // adding, deleting, growing and checkpointing take it exclusively.
+    pthread_rwlock_t inventoryLock;
+    IdMap productIndex;
+    int* orderPos;                  // Display order (see orderReset)
+    int orderLen;
+    int orderCapacity;
+    int* slotOrder;                 // Sized like the product array
+    int orderShuffled;              // Array order no longer matches display order
+
+    // Low Stock Alerts
+    AlertEntry* alertHeap;
+    int alertSize;
+    int alertCapacity;
+    IdMap alertSlots;
+    pthread_mutex_t alertMutex;
+
+    // Stock Statistics
+    StockStats stockStats;
+    QtyHeap maxQtyHeap;
+    QtyHeap minQtyHeap;
+    pthread_mutex_t statsMutex;
+
+    // Inventory View Index
+    int* viewOrder[SORT_KEYS];
+    int viewOrderLen;
+    int viewOrderCapacity;
+    IdMap viewQtyKey;
+    int viewReady;
+    unsigned int viewVersion;       // Bumped by every change to the orders
+    pthread_mutex_t viewMutex;
+    int* viewRows;                  // Filtered rows for the current sort/filter, rebuilt only when stale
+    int viewRowCount;
+    unsigned int viewRowsVersion;
+    SortKey viewRowsKey;
+    int viewRowsDescending;
+    ViewFilter viewRowsFilter;
+
+    // Name Search Index
+    int* nameOrder;                 // Ids sorted by folded name, then id
+    int nameOrderLen;
+    int nameOrderCapacity;
+    PostingList* namePostings;
+    int namePostingCount;
+    int namePostingCapacity;
+    IdMap nameTrigrams;             // Trigram key -> namePostings slot
+    int nameReady;
+    int nameFailed;                 // Last build ran out of memory; searches scan the store
+    pthread_mutex_t nameMutex;
+
+    // Transaction Journal
+    FILE* journalFp;
+    char journalBuf[1 << 16];
+    size_t journalBufLen;
+    int journalPending;             // Records appended but not yet committed
+    double journalOldestPendingMs;
+    int journalRecordCount;         // Records since the last checkpoint
+    unsigned long long journalLsn;
+    unsigned long long snapshotLsn; // Last LSN folded into the loaded snapshot
+    int journalAutoCommit;          // 0 = caller commits explicitly (batch mode)
+    int journalCheckpointDue;
+    pthread_mutex_t journalMutex;
+
+    // Stock Ledger
+    FILE* ledgerFp;
+    long long ledgerBufTime[LEDGER_BLOCK];  // Movements not yet written, by column
+    int ledgerBufId[LEDGER_BLOCK];
+    int ledgerBufDelta[LEDGER_BLOCK];
+    unsigned char ledgerBufKind[LEDGER_BLOCK];
+    int ledgerBufLen;
+    long long ledgerLastMs;         // Timestamps never go backwards
+    FILE* ledgerIndexFp;            // LEDGERINDEXFILE: one entry per block
+    int ledgerEntries;              // Blocks listed in it
+    int ledgerLastCheckpoint;       // Entry of the newest checkpoint, -1 = none
+    int ledgerBlocksSince;          // Data blocks after it...
+    long long ledgerBytesSince;     // ...and their size
+    long long ledgerCheckpointBytes;// Size of the newest checkpoint
+    QtyEntry* ledgerQty;            // Running quantity of every product the ledger has seen
+    int ledgerQtyCount;
+    int ledgerQtyCapacity;
+    int ledgerQtyLost;              // Out of memory tracking them: no checkpoints until reopened
+    IdMap ledgerIds;                // Product id -> ledgerQty slot
+    pthread_mutex_t ledgerMutex;
+
+    // Stock Lots (inventoryLock, then the product's stripe lock)
+    LotStripe lotStripes[LOT_STRIPES];
+    FILE* lotFp;
+    atomic_int lotNextId;
+    atomic_llong lotFileLines;      // Lines in LOTFILE, including used-up lots
+
+    // Bills of Materials (guarded by inventoryLock, like the store)
+    BomList* bomLists;
+    int bomListCount;
+    int bomListCapacity;
+    IdMap bomParents;               // Parent id -> bomLists slot
+    int bomLiveLines;
+    int bomFileLines;               // Lines in BOMFILE, including overridden ones
+
+    // Activity Log View
+    char logViewLines[LOG_VIEW_LINES][LOG_LINE_LEN];
+    long logViewTotal;              // Lines ever pushed; newest is (logViewTotal - 1) % LOG_VIEW_LINES
+    long logViewOffset;             // Bytes of logPath consumed so far (-1 = not seeded yet)
+    pthread_mutex_t logViewMutex;
+
+    // Activity Logger
+    LogCell logRing[LOG_RING_SIZE];
+    atomic_size_t logHead;          // Next position to write (producers)
+    atomic_size_t logTail;          // Next position to read (logger thread)
+    atomic_size_t logSynced;        // Entries known to be written and synced
+    atomic_int logFlushRequested;
+    atomic_int loggerRunning;
+    pthread_t loggerThread;
+    pthread_mutex_t loggerMutex;
+    pthread_cond_t loggerWake;
+
+    // CSV Export
+    atomic_int exportBusy;          // A background export is running
+    atomic_llong exportRowsWritten; // Progress of the current export
+    atomic_int exportLastResult;    // -1 none yet, 0 failed, 1 ok
+
+    // Files, inside the directory given to inventoryCreate
+    char snapshotPath[INVENTORY_PATH_LEN];
+    char journalPath[INVENTORY_PATH_LEN];
+    char ledgerPath[INVENTORY_PATH_LEN];
+    char ledgerIndexPath[INVENTORY_PATH_LEN];
+    char bomPath[INVENTORY_PATH_LEN];
+    char lotPath[INVENTORY_PATH_LEN];
+    char logPath[INVENTORY_PATH_LEN];
+    char textPath[INVENTORY_PATH_LEN];
+    char csvPath[INVENTORY_PATH_LEN];
+} Inventory;
+
+// Work for a warehouse's worker thread (see Warehouses in inventory.c)
+typedef struct WarehouseTask {
+    void (*run)(Inventory* inv, void* arg);
+    void* arg;
+    User user;                      // Runs as the user who posted it
+    int done;
+    struct WarehouseTask* next;
+} WarehouseTask;
+
+struct Company;
+
+// One site: its own inventory (store, journal, log) and the thread that owns it
+typedef struct {
+    Inventory* inv;
+    int site;                       // 1-based
+    struct Company* company;
+    pthread_t worker;
+    pthread_mutex_t queueMutex;
+    pthread_cond_t queueWake;
+    WarehouseTask* head;
+    WarehouseTask* tail;
+    int running;
+} Warehouse;
+
+// All the warehouses of a company, sharded by site
+typedef struct Company {
+    int count;
+    Warehouse sites[MAX_WAREHOUSES];
+    int loaded;                     // Every site's files have been loaded
+    pthread_mutex_t doneMutex;      // Task completion, for companyWait
+    pthread_cond_t doneWake;
+} Company;
+
+// Low stock alert somewhere in the company
+typedef struct {
+    int site;
+    AlertEntry alert;
+} CompanyAlert;
+
+// Process-wide state (shared by every Inventory)
+extern _Thread_local User currentUser;
+extern int isLoggedIn;
+extern User users[];
+extern int userCount;
+
+extern LoggerConfig loggerConfig;
+extern int metricsEnabled;
+extern double metricsStartMs;
+extern const char* metricNames[METRIC_OPS];
+
+// Inventory Context
+Inventory* inventoryCreate(const char* dir);
+void inventoryDestroy(Inventory* inv);
+
+// Product Store & Index
+int idMapGet(const IdMap* m, int id);
+void releaseInventory(Inventory* inv);
+int reserveInventory(Inventory* inv, int needed);
+void rebuildIndex(Inventory* inv, int count);
+int indexFind(Inventory* inv, int id);
+int storeAppend(Inventory* inv, const Product* p);
+
+// Low Stock Alerts
+void alertRebuild(Inventory* inv);
+int alertTop(Inventory* inv, AlertEntry* out, int max, int* total);
+
+// Stock Statistics
+void statsRebuild(Inventory* inv);
+void statsRead(Inventory* inv, StockStats* out, QtyEntry* maxOut, QtyEntry* minOut);
+
+// Inventory View Index
+void viewIndexBuild(Inventory* inv);
+int viewPage(Inventory* inv, SortKey key, int descending, ViewFilter filter, int first, int max, int* ids, int* total);
+
+// Name Search Index
+char foldChar(char c);
+void* nameIndexMain(void* arg);
+int nameSearch(Inventory* inv, const char* query, int* ids, int max, int* prefixTotal);
+
+// Platform Helpers
+double nowMs();
+long long wallMs();
+void sleepMs(int ms);
+
+// Operation Metrics
+long long nowNs();
+long long metricStart();
+void metricRecord(MetricOp op, long long start);
+void metricRead(MetricOp op, MetricSummary* out);
+void metricsReset();
+int metricsDump(const char* path);
+
+// Transaction Journal
+void journalCommit(Inventory* inv);
+void journalReset(Inventory* inv);
+void journalClose(Inventory* inv);
+int journalCheckpoint(Inventory* inv);
+int journalTick(Inventory* inv);
+
+// Stock Ledger
+void ledgerCheckpoint(Inventory* inv);
+int ledgerQuantityAt(Inventory* inv, int id, long long t, int* qty);
+long long ledgerNetMovement(Inventory* inv, int id, long long from, long long to);
+
+// Stock Lots
+void lotLoad(Inventory* inv);
+void lotCheckpoint(Inventory* inv);
+int lotCopy(Inventory* inv, int id, StockLot* out, int max, int* untracked);
+void lotValuation(Inventory* inv, LotValuation* out);
+
+// Snapshot Files
+int loadTextInventory(Inventory* inv, const char* path);
+int saveTextInventory(Inventory* inv, const char* path);
+
+// Activity Log
+int logViewCopy(Inventory* inv, int skip, int max, char out[][LOG_LINE_LEN], int* available);
+long logViewLineCount(Inventory* inv);
+void loggerStart(Inventory* inv);
+void loggerFlush(Inventory* inv);
+void loggerShutdown(Inventory* inv);
+void logEvent(Inventory* inv, LogAction action, int productId, int quantity, const char* text);
+void logActivity(Inventory* inv, const char* action);
+
+// Core Logic
+void loadInventory(Inventory* inv);
+int saveInventory(Inventory* inv);
+int authenticateUser(Inventory* inv, const char* username, const char* password);
+int addProduct(Inventory* inv, int id, const char* name, int qty, float price, ProductType type, int reorderLevel);
+Product* searchProduct(Inventory* inv, int id);
+const char* txnResultMessage(TxnResult r);
+TxnResult updateStock(Inventory* inv, int id, int newQty);
+TxnResult processSale(Inventory* inv, int id, int qty);
+TxnResult processPurchase(Inventory* inv, int id, int qty);
+TxnResult processPurchaseLot(Inventory* inv, int id, int qty, long long unitCostCents, long long expiresMs);
+TxnResult setReorderLevel(Inventory* inv, int id, int level);
+int deleteProduct(Inventory* inv, int id);
+void initializeSystem(Inventory* inv);
+
+// CSV Import / Export
+int parseIntField(const char** p, const char* end, int* out);
+int importCSV(Inventory* inv, const char* path, ImportReport* report);
+long long exportCSV(Inventory* inv, const char* path, const ExportFilter* f);
+int exportStart(Inventory* inv, const char* path, const ExportFilter* f);
+void exportToCSV(Inventory* inv);
+
+// Product Columns
+int columnsBuild(Inventory* inv, ProductColumns* c);
+void columnsFree(ProductColumns* c);
+int columnsLowStock(const ProductColumns* c, int* out);
+void columnsQtySumMax(const ProductColumns* c, long long* sum, int* max);
+void columnsValuation(const ProductColumns* c, long long units[2], long long valueCents[2]);
+
+// Bills of Materials
+void bomLoad(Inventory* inv);
+int bomSet(Inventory* inv, int parent, int component, int qtyPer);
+int bomCopy(Inventory* inv, int parent, BomLine* out, int max);
+TxnResult produceProduct(Inventory* inv, int id, int qty);
+int mrpPlan(Inventory* inv, const MrpOrder* orders, int count, MrpPlan* plan);
+void mrpFree(MrpPlan* plan);
+
+// Activity Log Replay
+int replayActivityLog(Inventory* inv, const char* path, long long until, ReplayReport* report);
+
+// Warehouses
+int warehousePath(char* out, const char* dir, int site);
+int warehouseCount(const char* dir);
+Company* companyOpen(const char* dir, int count);
+void companyClose(Company* c);
+void companyPost(Company* c, int site, WarehouseTask* task);
+void companyWait(Company* c, WarehouseTask* task);
+void companyRun(Company* c, int site, void (*run)(Inventory* inv, void* arg), void* arg);
+TxnResult companyTransfer(Company* c, int from, int to, int id, int qty);
+long long companyStock(Company* c, int id, int* perSite);
+void companyStats(Company* c, StockStats* total, StockStats* perSite);
+int companyLowStock(Company* c, CompanyAlert* out, int max, int* total);
+
+#endif
@@ -1,55 +1,20 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <time.h>
+#include "inventory.h"
 #include <raylib.h>
 
-// Constants
-#define MAX_PRODUCTS 100
-#define LOW_STOCK_THRESHOLD 10
-#define FILENAME "inventory.txt"
-#define LOGFILE "activity_log.txt"
-#define CSVFILE "inventory_export.csv"
-#define MAX_USERNAME 50
-#define MAX_PASSWORD 50
+#ifdef __linux__
+#include <errno.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#endif
 
 // Custom Colors not defined in standard Raylib
 #define DARKORANGE (Color){ 200, 120, 0, 255 }
 
-// Product Type Enumeration
-typedef enum {
-    RAW_MATERIAL,
-    FINISHED_GOOD
-} ProductType;
-
-// User Role Enumeration
-typedef enum {
-    ADMIN,
-    STAFF
-} UserRole;
-
-// Product Structure
-typedef struct {
-    int id;
-    char name[50];
-    int quantity;
-    float price;
-    ProductType type;
-} Product;
-
-// User Structure
-typedef struct {
-    char username[MAX_USERNAME];
-    char password[MAX_PASSWORD];
-    UserRole role;
-} User;
-
-// Global Variables
-Product inventory[MAX_PRODUCTS];
-int productCount = 0;
-User currentUser;
-int isLoggedIn = 0;
-
 // Screen States
 typedef enum {
     LOGIN_SCREEN,
@@ -63,17 +28,14 @@ typedef enum {
     SEARCH_PRODUCT,
     VIEW_CHARTS,
     ACTIVITY_LOG_SCREEN,
-    EXPORT_CSV_SCREEN
+    EXPORT_CSV_SCREEN,
+    METRICS_SCREEN
 } ScreenState;
 
 ScreenState currentScreen = LOGIN_SCREEN;
 
-// Hardcoded Users
-User users[] = {
-    {"admin", "admin123", ADMIN},
-    {"staff", "staff123", STAFF}
-};
-int userCount = 2;
+// The inventory this process works on (GUI, server or command), in the working directory
+Inventory* store = NULL;
 
 // ---------------- Helper Function for Input ----------------
 // Handles typing into a string buffer. 
@@ -115,177 +77,92 @@ void DrawInputBox(const char* label, int y, char* buffer, int myFocusID, int* cu
     }
 }
 
-// ---------------- Core Logic Functions ----------------
-
-void loadInventory() {
-    FILE* fp = fopen(FILENAME, "r");
-    if (fp == NULL) {
-        productCount = 0;
-        return;
-    }
-    
-    productCount = 0;
-    while (fscanf(fp, "%d,%49[^,],%d,%f,%d\n", 
-                  &inventory[productCount].id,
-                  inventory[productCount].name,
-                  &inventory[productCount].quantity,
-                  &inventory[productCount].price,
-                  (int*)&inventory[productCount].type) == 5) {
-        productCount++;
-        if (productCount >= MAX_PRODUCTS) break;
-    }
-    
-    fclose(fp);
+// ---------------- Screen Refresh ----------------
+// Screens are drawn into screenCache, and only when something could have
+// changed what they show: input, a screen switch, new data (journal LSN,
+// log lines, export progress, index builds) or a refresh a screen asked
+// for with screenRefreshIn. Other frames just put the cached image back
+// on the window. When there is no background work either, the loop blocks
+// in EndDrawing until the next input event (raylib event waiting), so an
+// idle station uses next to no CPU.
+
+#define ACTIVE_FPS 60
+#define BUSY_FPS 10             // Background work but no input: export progress, journal commits
+#define SETTLE_FRAMES 2         // Redraws after input, for changes made late in a draw call
+
+RenderTexture2D screenCache;
+int screenCacheReady = 0;
+ScreenState screenCacheScreen;
+unsigned long long screenWatched[6];   // Data the last draw was based on
+double screenRefreshAtMs = 0;           // 0 = no refresh requested
+int screenSettle = 0;
+int screenWaiting = 0;                  // Event waiting is on
+int screenFps = ACTIVE_FPS;
+
+// Asks for the current screen to be redrawn within `ms` even without input.
+void screenRefreshIn(int ms) {
+    double at = nowMs() + ms;
+    if (screenRefreshAtMs == 0 || at < screenRefreshAtMs) screenRefreshAtMs = at;
 }
 
-void saveInventory() {
-    FILE* fp = fopen(FILENAME, "w");
-    if (fp == NULL) {
-        printf("Error saving inventory!\n");
-        return;
-    }
-    
-    for (int i = 0; i < productCount; i++) {
-        fprintf(fp, "%d,%s,%d,%.2f,%d\n",
-                inventory[i].id,
-                inventory[i].name,
-                inventory[i].quantity,
-                inventory[i].price,
-                inventory[i].type);
+int screenInput() {
+    int input = 0;
+    while (GetKeyPressed() != 0) input = 1;     // Drains the key queue; IsKeyPressed still works
+    Vector2 delta = GetMouseDelta();
+    if (delta.x != 0 || delta.y != 0 || GetMouseWheelMove() != 0) input = 1;
+    for (int b = MOUSE_BUTTON_LEFT; b <= MOUSE_BUTTON_RIGHT; b++) {
+        if (IsMouseButtonPressed(b) || IsMouseButtonReleased(b)) input = 1;
     }
-    
-    fclose(fp);
+    return input;
 }
 
-void logActivity(const char* action) {
-    FILE* fp = fopen(LOGFILE, "a");
-    if (fp == NULL) return;
-    
-    time_t now = time(NULL);
-    char* timeStr = ctime(&now);
-    if (timeStr) timeStr[strlen(timeStr) - 1] = '\0'; // Remove newline
-    
-    fprintf(fp, "[%s] User: %s | Action: %s\n", timeStr ? timeStr : "Unknown", currentUser.username, action);
-    fclose(fp);
-}
-
-int authenticateUser(const char* username, const char* password) {
-    for (int i = 0; i < userCount; i++) {
-        if (strcmp(users[i].username, username) == 0 &&
-            strcmp(users[i].password, password) == 0) {
-            currentUser = users[i];
-            isLoggedIn = 1;
-            logActivity("Logged in");
-            return 1;
-        }
-    }
-    return 0;
-}
-
-void addProduct(Product* inv, int* count, int id, const char* name, int qty, float price, ProductType type) {
-    if (*count >= MAX_PRODUCTS) return;
-    
-    inv[*count].id = id;
-    strcpy(inv[*count].name, name);
-    inv[*count].quantity = qty;
-    inv[*count].price = price;
-    inv[*count].type = type;
-    (*count)++;
-    
-    saveInventory();
-    char logMsg[200];
-    sprintf(logMsg, "Added product: %s (ID: %d)", name, id);
-    logActivity(logMsg);
-}
-
-Product* searchProduct(Product* inv, int count, int id) {
-    for (int i = 0; i < count; i++) {
-        if (inv[i].id == id) {
-            return &inv[i];
-        }
+// Decides whether this frame redraws the screen.
+int screenNeedsDraw() {
+    unsigned long long watched[6] = {
+        __atomic_load_n(&store->journalLsn, __ATOMIC_RELAXED),
+        (unsigned long long)logViewLineCount(store),
+        (unsigned long long)atomic_load(&store->exportRowsWritten),
+        (unsigned long long)atomic_load(&store->exportBusy),
+        (unsigned long long)__atomic_load_n(&store->nameReady, __ATOMIC_RELAXED),
+        (unsigned long long)store->productCount
+    };
+    int draw = !screenCacheReady || currentScreen != screenCacheScreen ||
+               memcmp(watched, screenWatched, sizeof(watched)) != 0;
+    if (screenInput()) {
+        draw = 1;
+        screenSettle = SETTLE_FRAMES;
+    } else if (screenSettle > 0) {
+        draw = 1;
+        screenSettle--;
     }
-    return NULL;
-}
-
-void updateStock(Product* inv, int count, int id, int newQty) {
-    Product* p = searchProduct(inv, count, id);
-    if (p != NULL) {
-        p->quantity = newQty;
-        saveInventory();
-        char logMsg[200];
-        sprintf(logMsg, "Updated stock for ID %d to %d units", id, newQty);
-        logActivity(logMsg);
+    if (screenRefreshAtMs != 0 && nowMs() >= screenRefreshAtMs) draw = 1;
+    if (draw) {
+        memcpy(screenWatched, watched, sizeof(watched));
+        screenCacheScreen = currentScreen;
+        screenRefreshAtMs = 0;      // The draw asks again if it still needs one
     }
+    return draw;
 }
 
-void processSale(Product* inv, int count, int id, int qty) {
-    Product* p = searchProduct(inv, count, id);
-    if (p != NULL) {
-        if (p->quantity >= qty) {
-            p->quantity -= qty;
-            saveInventory();
-            char logMsg[200];
-            sprintf(logMsg, "Sale: %d units of %s (ID: %d)", qty, p->name, id);
-            logActivity(logMsg);
-        }
+// Picks the frame pacing for the next frame: full rate while the user is
+// interacting, a slow tick while background work is pending, otherwise
+// block until input arrives.
+void screenPace(int journalWaiting) {
+    int busy = journalWaiting || atomic_load(&store->exportBusy) || screenRefreshAtMs != 0 ||
+               (currentScreen == SEARCH_PRODUCT && !__atomic_load_n(&store->nameReady, __ATOMIC_RELAXED));
+    int fps = screenSettle > 0 || !busy ? ACTIVE_FPS : BUSY_FPS;
+    int wait = screenSettle == 0 && !busy;
+    if (fps != screenFps) {
+        SetTargetFPS(fps);
+        screenFps = fps;
     }
-}
-
-void processPurchase(Product* inv, int count, int id, int qty) {
-    Product* p = searchProduct(inv, count, id);
-    if (p != NULL) {
-        p->quantity += qty;
-        saveInventory();
-        char logMsg[200];
-        sprintf(logMsg, "Purchase: %d units of %s (ID: %d)", qty, p->name, id);
-        logActivity(logMsg);
+    if (wait != screenWaiting) {
+        if (wait) EnableEventWaiting();
+        else DisableEventWaiting();
+        screenWaiting = wait;
     }
 }
 
-void deleteProduct(Product* inv, int* count, int id) {
-    int index = -1;
-    for (int i = 0; i < *count; i++) {
-        if (inv[i].id == id) {
-            index = i;
-            break;
-        }
-    }
-    
-    if (index != -1) {
-        char logMsg[200];
-        sprintf(logMsg, "Deleted product: %s (ID: %d)", inv[index].name, id);
-        
-        for (int i = index; i < *count - 1; i++) {
-            inv[i] = inv[i + 1];
-        }
-        (*count)--;
-        saveInventory();
-        logActivity(logMsg);
-    }
-}
-
-void exportToCSV(Product* inv, int count) {
-    FILE* fp = fopen(CSVFILE, "w");
-    if (fp == NULL) return;
-    
-    fprintf(fp, "ID,Name,Quantity,Price,Type\n");
-    for (int i = 0; i < count; i++) {
-        fprintf(fp, "%d,%s,%d,%.2f,%s\n",
-                inv[i].id,
-                inv[i].name,
-                inv[i].quantity,
-                inv[i].price,
-                inv[i].type == RAW_MATERIAL ? "Raw Material" : "Finished Good");
-    }
-    
-    fclose(fp);
-    logActivity("Exported inventory to CSV");
-}
-
-void initializeSystem() {
-    loadInventory();
-}
-
 // ---------------- GUI Drawing Functions ----------------
 
 void drawLoginScreen() {
@@ -334,7 +211,7 @@ void drawLoginScreen() {
     if (CheckCollisionPointRec(GetMousePosition(), loginBtn)) {
         DrawRectangleRec(loginBtn, DARKBLUE);
         if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-            if (authenticateUser(username, password)) {
+            if (authenticateUser(store, username, password)) {
                 currentScreen = MAIN_MENU;
                 strcpy(errorMsg, "");
                 username[0] = password[0] = '\0';
@@ -358,15 +235,15 @@ void drawMainMenu() {
     DrawText(welcome, 20, 20, 20, DARKBLUE);
     DrawText("MAIN MENU", 300, 60, 28, DARKBLUE);
     
-    Rectangle buttons[11];
+    Rectangle buttons[12];
     const char* btnLabels[] = {
         "Add Product", "View Inventory", "Update Stock", "Process Sale",
         "Process Purchase", "Delete Product", "Search Product", "View Charts",
-        "Activity Log", "Export CSV", "Logout"
+        "Activity Log", "Export/Import", "Metrics", "Logout"
     };
     
-    int startY = 120;
-    for (int i = 0; i < 11; i++) {
+    int startY = 110;
+    for (int i = 0; i < 12; i++) {
         buttons[i] = (Rectangle){300, (float)(startY + i * 40), 200, 35};
         
         // Role Access
@@ -389,7 +266,8 @@ void drawMainMenu() {
                 else if (i == 7) currentScreen = VIEW_CHARTS;
                 else if (i == 8) currentScreen = ACTIVITY_LOG_SCREEN;
                 else if (i == 9) currentScreen = EXPORT_CSV_SCREEN;
-                else if (i == 10) { isLoggedIn = 0; currentScreen = LOGIN_SCREEN; logActivity("Logged out"); }
+                else if (i == 10) currentScreen = METRICS_SCREEN;
+                else if (i == 11) { isLoggedIn = 0; currentScreen = LOGIN_SCREEN; logEvent(store, LOG_LOGOUT, 0, 0, NULL); loggerFlush(store); }
             }
         } else {
             DrawRectangleRec(buttons[i], BLUE);
@@ -397,16 +275,24 @@ void drawMainMenu() {
         DrawText(btnLabels[i], buttons[i].x + 40, buttons[i].y + 8, 18, WHITE);
     }
 
-    // Alerts
+    // Alerts (most critical first, straight from the alert heap)
     DrawText("LOW STOCK ALERTS:", 550, 100, 18, RED);
+    AlertEntry alerts[20];
+    int totalAlerts;
+    int shown = alertTop(store, alerts, 20, &totalAlerts);
     int alertY = 130;
-    for (int i = 0; i < productCount; i++) {
-        if (inventory[i].quantity < LOW_STOCK_THRESHOLD) {
-            char alert[100];
-            sprintf(alert, "- %s (%d left)", inventory[i].name, inventory[i].quantity);
-            DrawText(alert, 550, alertY, 14, ORANGE);
-            alertY += 20;
-        }
+    for (int i = 0; i < shown; i++) {
+        Product* p = searchProduct(store, alerts[i].id);
+        if (p == NULL) continue;
+        char alert[100];
+        sprintf(alert, "- %s (%d left)", p->name, alerts[i].quantity);
+        DrawText(alert, 550, alertY, 14, ORANGE);
+        alertY += 20;
+    }
+    if (totalAlerts > shown) {
+        char more[40];
+        sprintf(more, "+%d more", totalAlerts - shown);
+        DrawText(more, 550, alertY, 14, GRAY);
     }
 }
 
@@ -415,9 +301,10 @@ void drawAddProductScreen() {
     static char name[50] = "";
     static char qtyStr[20] = "";
     static char priceStr[20] = "";
+    static char levelStr[20] = "";
     static int typeSelected = 0;
     static char message[100] = "";
-    static int focus = 0; // 1:ID, 2:Name, 3:Qty, 4:Price
+    static int focus = 0; // 1:ID, 2:Name, 3:Qty, 4:Price, 5:Reorder level
 
     ClearBackground(RAYWHITE);
     DrawText("ADD PRODUCT", 300, 30, 26, DARKBLUE);
@@ -427,18 +314,24 @@ void drawAddProductScreen() {
     DrawInputBox("Name:", 150, name, 2, &focus, 300);
     DrawInputBox("Quantity:", 200, qtyStr, 3, &focus, 300);
     DrawInputBox("Price:", 250, priceStr, 4, &focus, 300);
+    DrawInputBox("Reorder Lvl:", 300, levelStr, 5, &focus, 300);
+    if (levelStr[0] == '\0' && focus != 5) {
+        char hint[30];
+        sprintf(hint, "(default %d)", LOW_STOCK_THRESHOLD);
+        DrawText(hint, 610, 306, 14, GRAY);
+    }
 
     // Type Selection
-    DrawText("Type:", 150, 300, 18, BLACK);
-    Rectangle rawBtn = {300, 300, 140, 30};
-    Rectangle finBtn = {450, 300, 150, 30};
+    DrawText("Type:", 150, 350, 18, BLACK);
+    Rectangle rawBtn = {300, 350, 140, 30};
+    Rectangle finBtn = {450, 350, 150, 30};
     
     DrawRectangleRec(rawBtn, typeSelected == 0 ? DARKBLUE : LIGHTGRAY);
-    DrawText("Raw Material", 310, 307, 14, typeSelected == 0 ? WHITE : BLACK);
+    DrawText("Raw Material", 310, 357, 14, typeSelected == 0 ? WHITE : BLACK);
     if (CheckCollisionPointRec(GetMousePosition(), rawBtn) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) typeSelected = 0;
 
     DrawRectangleRec(finBtn, typeSelected == 1 ? DARKBLUE : LIGHTGRAY);
-    DrawText("Finished Good", 460, 307, 14, typeSelected == 1 ? WHITE : BLACK);
+    DrawText("Finished Good", 460, 357, 14, typeSelected == 1 ? WHITE : BLACK);
     if (CheckCollisionPointRec(GetMousePosition(), finBtn) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) typeSelected = 1;
 
     // Handling Input Logic
@@ -446,53 +339,137 @@ void drawAddProductScreen() {
     if (focus == 2) HandleTextInput(name, 49, 0);
     if (focus == 3) HandleTextInput(qtyStr, 10, 1);
     if (focus == 4) HandleTextInput(priceStr, 10, 1);
+    if (focus == 5) HandleTextInput(levelStr, 10, 1);
 
     // Buttons
-    Rectangle addBtn = {320, 360, 160, 40};
+    Rectangle addBtn = {320, 410, 160, 40};
     if (CheckCollisionPointRec(GetMousePosition(), addBtn)) {
         DrawRectangleRec(addBtn, DARKGREEN);
         if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
             int id = atoi(idStr);
             int qty = atoi(qtyStr);
             float price = (float)atof(priceStr);
-            if (id > 0 && strlen(name) > 0) {
-                addProduct(inventory, &productCount, id, name, qty, price, typeSelected == 0 ? RAW_MATERIAL : FINISHED_GOOD);
-                sprintf(message, "Product added!");
-                idStr[0] = name[0] = qtyStr[0] = priceStr[0] = '\0';
+            int level = levelStr[0] ? atoi(levelStr) : LOW_STOCK_THRESHOLD;
+            if (id > 0 && strlen(name) > 0 && qty >= 0 && price >= 0 && price <= MAX_PRICE) {
+                if (addProduct(store, id, name, qty, price, typeSelected == 0 ? RAW_MATERIAL : FINISHED_GOOD, level)) {
+                    sprintf(message, "Product added!");
+                    idStr[0] = name[0] = qtyStr[0] = priceStr[0] = levelStr[0] = '\0';
+                } else sprintf(message, "Product ID already exists!");
             } else sprintf(message, "Invalid Input!");
         }
     } else DrawRectangleRec(addBtn, GREEN);
-    DrawText("ADD", 375, 373, 18, WHITE);
+    DrawText("ADD", 375, 423, 18, WHITE);
 
-    Rectangle backBtn = {320, 410, 160, 40};
+    Rectangle backBtn = {320, 460, 160, 40};
     if (CheckCollisionPointRec(GetMousePosition(), backBtn)) {
         DrawRectangleRec(backBtn, DARKGRAY);
         if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) { currentScreen = MAIN_MENU; message[0] = '\0'; }
     } else DrawRectangleRec(backBtn, GRAY);
-    DrawText("BACK", 365, 423, 18, WHITE);
+    DrawText("BACK", 365, 473, 18, WHITE);
 
-    DrawText(message, 250, 470, 16, GREEN);
+    DrawText(message, 250, 520, 16, GREEN);
 }
 
+#define VIEW_PAGE_ROWS 19
+
+// Formatted cells of one visible row, reused until the product changes
+typedef struct {
+    int id;
+    int quantity;
+    int reorderLevel;
+    char idText[12];
+    char qtyText[12];
+    char priceText[16];
+} ViewRow;
+
 void drawViewInventoryScreen() {
+    static int scroll = 0;      // First row shown
+    static SortKey sortKey = SORT_ID;
+    static int descending = 0;
+    static ViewFilter filter = FILTER_ALL;
+    static ViewRow cache[VIEW_PAGE_ROWS];
+
     ClearBackground(RAYWHITE);
     DrawText("INVENTORY LIST", 280, 20, 26, DARKBLUE);
-    DrawText("ID   Name                  Qty    Price   Type", 50, 60, 18, DARKGRAY);
-    DrawLine(40, 80, 760, 80, BLACK);
-    
-    int yPos = 100;
-    for (int i = 0; i < productCount && i < 20; i++) {
-        char line[150];
-        sprintf(line, "%-4d %-20s %-6d %-7.2f %s", 
-            inventory[i].id, inventory[i].name, inventory[i].quantity, 
-            inventory[i].price, inventory[i].type == RAW_MATERIAL ? "Raw" : "Fin");
+    if (!store->viewReady) viewIndexBuild(store);
+
+    // Filters
+    const char* filterLabels[] = {"All", "Raw", "Finished", "Low Stock"};
+    for (int f = 0; f < 4; f++) {
+        Rectangle btn = {50 + f * 110.0f, 55, 100, 25};
+        int hover = CheckCollisionPointRec(GetMousePosition(), btn);
+        DrawRectangleRec(btn, filter == (ViewFilter)f ? DARKBLUE : (hover ? SKYBLUE : LIGHTGRAY));
+        DrawText(filterLabels[f], btn.x + 10, btn.y + 5, 16, filter == (ViewFilter)f ? WHITE : BLACK);
+        if (hover && IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && filter != (ViewFilter)f) {
+            filter = (ViewFilter)f;
+            scroll = 0;
+        }
+    }
+
+    // Column headers sort; clicking the current one flips the direction
+    const char* colLabels[] = {"ID", "Name", "Qty", "Price", "Type"};
+    const int colX[] = {50, 130, 420, 520, 640};
+    for (int k = 0; k < SORT_KEYS; k++) {
+        Rectangle hdr = {(float)colX[k] - 5, 88, 90, 24};
+        char label[20];
+        sprintf(label, "%s%s", colLabels[k], sortKey == (SortKey)k ? (descending ? " v" : " ^") : "");
+        DrawText(label, colX[k], 92, 18, CheckCollisionPointRec(GetMousePosition(), hdr) ? BLUE : DARKGRAY);
+        if (CheckCollisionPointRec(GetMousePosition(), hdr) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+            if (sortKey == (SortKey)k) descending = !descending;
+            else {
+                sortKey = (SortKey)k;
+                descending = 0;
+            }
+            scroll = 0;
+        }
+    }
+    DrawLine(40, 114, 760, 114, BLACK);
+
+    // Mouse wheel scrolls, PgUp/PgDn pages, Home/End jump
+    scroll -= (int)GetMouseWheelMove() * 3;
+    if (IsKeyPressed(KEY_PAGE_UP)) scroll -= VIEW_PAGE_ROWS;
+    if (IsKeyPressed(KEY_PAGE_DOWN)) scroll += VIEW_PAGE_ROWS;
+    if (IsKeyPressed(KEY_HOME)) scroll = 0;
+    if (IsKeyPressed(KEY_END)) scroll = store->productCount;
+    if (scroll < 0) scroll = 0;
+
+    // Only the rows in the viewport are fetched and formatted
+    int ids[VIEW_PAGE_ROWS];
+    int total = 0;
+    int shown = viewPage(store, sortKey, descending, filter, scroll, VIEW_PAGE_ROWS, ids, &total);
+    if (scroll > 0 && scroll > total - VIEW_PAGE_ROWS) {
+        scroll = total > VIEW_PAGE_ROWS ? total - VIEW_PAGE_ROWS : 0;
+        shown = viewPage(store, sortKey, descending, filter, scroll, VIEW_PAGE_ROWS, ids, &total);
+    }
+
+    int yPos = 120;
+    for (int i = 0; i < shown; i++) {
+        Product* p = searchProduct(store, ids[i]);
+        if (p == NULL) continue;
+        ViewRow* row = &cache[i];
+        if (row->id != p->id || row->quantity != p->quantity || row->reorderLevel != p->reorderLevel) {
+            row->id = p->id;
+            row->quantity = p->quantity;
+            row->reorderLevel = p->reorderLevel;
+            sprintf(row->idText, "%d", p->id);
+            sprintf(row->qtyText, "%d", p->quantity);
+            sprintf(row->priceText, "%.2f", p->price);
+        }
         
-        Color rowColor = (inventory[i].quantity < LOW_STOCK_THRESHOLD) ? RED : BLACK;
-        DrawText(line, 50, yPos, 16, rowColor);
-        yPos += 22;
+        Color rowColor = (row->quantity < row->reorderLevel) ? RED : BLACK;
+        DrawText(row->idText, colX[0], yPos, 16, rowColor);
+        DrawText(p->name, colX[1], yPos, 16, rowColor);
+        DrawText(row->qtyText, colX[2], yPos, 16, rowColor);
+        DrawText(row->priceText, colX[3], yPos, 16, rowColor);
+        DrawText(p->type == RAW_MATERIAL ? "Raw" : "Fin", colX[4], yPos, 16, rowColor);
+        yPos += 20;
     }
     
-    if (productCount > 20) DrawText("...More items hidden...", 300, 530, 14, GRAY);
+    char status[80];
+    if (total == 0) sprintf(status, "No products");
+    else sprintf(status, "Rows %d-%d of %d", scroll + 1, scroll + shown, total);
+    DrawText(status, 50, 515, 14, GRAY);
+    DrawText("Wheel / PgUp / PgDn to scroll", 520, 515, 14, GRAY);
 
     Rectangle backBtn = {320, 550, 160, 40};
     if (CheckCollisionPointRec(GetMousePosition(), backBtn)) {
@@ -505,6 +482,7 @@ void drawViewInventoryScreen() {
 void drawUpdateStockScreen() {
     static char idStr[20] = "";
     static char qtyStr[20] = "";
+    static char levelStr[20] = "";
     static char message[100] = "";
     static int focus = 0; 
 
@@ -513,6 +491,7 @@ void drawUpdateStockScreen() {
 
     Rectangle idBox = {350, 145, 250, 30};
     Rectangle qtyBox = {350, 205, 250, 30};
+    Rectangle levelBox = {350, 260, 250, 30};
     
     DrawText("Product ID:", 200, 150, 18, BLACK);
     DrawRectangleRec(idBox, focus == 1 ? SKYBLUE : WHITE);
@@ -526,32 +505,50 @@ void drawUpdateStockScreen() {
     DrawText(qtyStr, 360, 212, 18, BLACK);
     if (CheckCollisionPointRec(GetMousePosition(), qtyBox) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) focus = 2;
 
+    DrawText("Reorder Level:", 200, 265, 18, BLACK);
+    DrawRectangleRec(levelBox, focus == 3 ? SKYBLUE : WHITE);
+    DrawRectangleLinesEx(levelBox, 1, BLACK);
+    DrawText(levelStr, 360, 267, 18, BLACK);
+    if (CheckCollisionPointRec(GetMousePosition(), levelBox) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) focus = 3;
+
     if (focus == 1) HandleTextInput(idStr, 10, 1);
     if (focus == 2) HandleTextInput(qtyStr, 10, 1);
+    if (focus == 3) HandleTextInput(levelStr, 10, 1);
 
-    Rectangle updateBtn = {300, 270, 200, 40};
+    Rectangle updateBtn = {190, 330, 200, 40};
     if (CheckCollisionPointRec(GetMousePosition(), updateBtn)) {
         DrawRectangleRec(updateBtn, DARKORANGE);
         if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
             int id = atoi(idStr);
             int qty = atoi(qtyStr);
-            updateStock(inventory, productCount, id, qty);
-            sprintf(message, "Stock updated!");
+            TxnResult r = updateStock(store, id, qty);
+            sprintf(message, "%s", r == TXN_OK ? "Stock updated!" : txnResultMessage(r));
         }
     } else DrawRectangleRec(updateBtn, ORANGE);
-    DrawText("UPDATE", 360, 283, 18, WHITE);
+    DrawText("UPDATE", 250, 343, 18, WHITE);
 
-    Rectangle backBtn = {300, 320, 200, 40};
+    Rectangle levelBtn = {410, 330, 200, 40};
+    if (CheckCollisionPointRec(GetMousePosition(), levelBtn)) {
+        DrawRectangleRec(levelBtn, DARKORANGE);
+        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+            int id = atoi(idStr);
+            TxnResult r = levelStr[0] ? setReorderLevel(store, id, atoi(levelStr)) : TXN_INVALID_QTY;
+            sprintf(message, "%s", r == TXN_OK ? "Reorder level set!" : txnResultMessage(r));
+        }
+    } else DrawRectangleRec(levelBtn, ORANGE);
+    DrawText("SET LEVEL", 455, 343, 18, WHITE);
+
+    Rectangle backBtn = {300, 380, 200, 40};
     if (CheckCollisionPointRec(GetMousePosition(), backBtn)) {
         DrawRectangleRec(backBtn, DARKGRAY);
         if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) { currentScreen = MAIN_MENU; message[0] = '\0'; }
     } else DrawRectangleRec(backBtn, GRAY);
-    DrawText("BACK", 370, 333, 18, WHITE);
-    DrawText(message, 220, 380, 16, GREEN);
+    DrawText("BACK", 370, 393, 18, WHITE);
+    DrawText(message, 220, 440, 16, GREEN);
 }
 
 // Generic Function to draw simple ID/Qty screens (Sale/Purchase)
-void drawTransactionScreen(const char* title, void (*processFunc)(Product*, int, int, int), Color btnColor) {
+void drawTransactionScreen(const char* title, TxnResult (*processFunc)(Inventory*, int, int), Color btnColor) {
     static char idStr[20] = "";
     static char qtyStr[20] = "";
     static char message[100] = "";
@@ -585,8 +582,7 @@ void drawTransactionScreen(const char* title, void (*processFunc)(Product*, int,
             int id = atoi(idStr);
             int qty = atoi(qtyStr);
             if (id > 0 && qty > 0) {
-                processFunc(inventory, productCount, id, qty);
-                sprintf(message, "Transaction Success!");
+                sprintf(message, "%s", txnResultMessage(processFunc(store, id, qty)));
             } else sprintf(message, "Invalid Input");
         }
     } else DrawRectangleRec(actBtn, btnColor);
@@ -624,7 +620,7 @@ void drawDeleteScreen() {
         DrawRectangleRec(delBtn, MAROON);
         if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
             int id = atoi(idStr);
-            deleteProduct(inventory, &productCount, id);
+            deleteProduct(store, id);
             sprintf(message, "Deletion Attempted");
         }
     } else DrawRectangleRec(delBtn, RED);
@@ -639,75 +635,154 @@ void drawDeleteScreen() {
     DrawText(message, 260, 350, 16, RED);
 }
 
+#define SEARCH_RESULTS 10
+
+// Search as you type: by name (prefix, then substring) and, for numeric
+// input, by exact id. Results are refreshed only when the query changes.
 void drawSearchScreen() {
-    static char idStr[20] = "";
-    static Product* foundProduct = NULL;
-    static int focus = 0;
+    static char query[50] = "";
+    static char lastQuery[50] = "";
+    static int lastCount = -1;      // Re-run when products come or go
+    static int results[SEARCH_RESULTS];
+    static int resultCount = 0;
+    static int prefixTotal = 0;
+    static int selectedId = 0;
+    static int focus = 1;
     
     ClearBackground(RAYWHITE);
     DrawText("SEARCH PRODUCT", 280, 30, 26, DARKBLUE);
 
-    Rectangle idBox = {380, 115, 200, 30};
-    DrawText("Product ID:", 250, 120, 18, BLACK);
-    DrawRectangleRec(idBox, focus == 1 ? SKYBLUE : WHITE);
-    DrawRectangleLinesEx(idBox, 1, BLACK);
-    DrawText(idStr, 390, 122, 18, BLACK);
-    if (CheckCollisionPointRec(GetMousePosition(), idBox) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) focus = 1;
-    if (focus == 1) HandleTextInput(idStr, 10, 1);
-
-    Rectangle searchBtn = {300, 170, 200, 40};
-    if (CheckCollisionPointRec(GetMousePosition(), searchBtn)) {
-        DrawRectangleRec(searchBtn, DARKBLUE);
-        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-            foundProduct = searchProduct(inventory, productCount, atoi(idStr));
+    Rectangle queryBox = {330, 95, 300, 30};
+    DrawText("Name or ID:", 190, 100, 18, BLACK);
+    DrawRectangleRec(queryBox, focus == 1 ? SKYBLUE : WHITE);
+    DrawRectangleLinesEx(queryBox, 1, BLACK);
+    DrawText(query, 340, 102, 18, BLACK);
+    if (CheckCollisionPointRec(GetMousePosition(), queryBox) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) focus = 1;
+    if (focus == 1) HandleTextInput(query, 49, 0);
+
+    // Without the index (out of memory) nameSearch scans the store instead
+    int indexed = __atomic_load_n(&store->nameReady, __ATOMIC_ACQUIRE) ||
+                  __atomic_load_n(&store->nameFailed, __ATOMIC_ACQUIRE);
+    if (!indexed) {
+        DrawText("Building name index...", 340, 130, 14, GRAY);
+        lastCount = -1;
+    } else if (strcmp(query, lastQuery) != 0 || store->productCount != lastCount) {
+        strcpy(lastQuery, query);
+        lastCount = store->productCount;
+        resultCount = 0;
+        int idHit = 0;
+        if (query[0] != '\0' && strspn(query, "0123456789") == strlen(query) &&
+            searchProduct(store, atoi(query)) != NULL) {
+            idHit = atoi(query);
+            results[resultCount++] = idHit;
         }
-    } else DrawRectangleRec(searchBtn, BLUE);
-    DrawText("SEARCH", 355, 183, 18, WHITE);
+        int byName[SEARCH_RESULTS];
+        int found = nameSearch(store, query, byName, SEARCH_RESULTS, &prefixTotal);
+        for (int i = 0; i < found && resultCount < SEARCH_RESULTS; i++) {
+            if (byName[i] != idHit) results[resultCount++] = byName[i];
+        }
+    }
+
+    int y = 145;
+    for (int i = 0; i < resultCount; i++) {
+        Product* p = searchProduct(store, results[i]);
+        if (p == NULL) continue;
+        Rectangle row = {150, (float)y, 500, 24};
+        int hover = CheckCollisionPointRec(GetMousePosition(), row);
+        if (hover || p->id == selectedId) DrawRectangleRec(row, p->id == selectedId ? SKYBLUE : LIGHTGRAY);
+        if (hover && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) selectedId = p->id;
+        char line[100];
+        sprintf(line, "%-6d %s", p->id, p->name);
+        DrawText(line, 160, y + 4, 16, BLACK);
+        y += 25;
+    }
+    if (query[0] != '\0' && resultCount == 0) DrawText("No matching products", 160, y + 4, 16, GRAY);
+    else if (prefixTotal > SEARCH_RESULTS) {
+        char more[sizeof(query) + 40];     // Room for the count and the text around the query
+        snprintf(more, sizeof(more), "%d names start with \"%s\"", prefixTotal, query);
+        DrawText(more, 160, y + 4, 14, GRAY);
+    }
 
+    Product* foundProduct = selectedId ? searchProduct(store, selectedId) : NULL;
     if (foundProduct != NULL) {
-        DrawRectangle(150, 240, 500, 200, LIGHTGRAY);
-        DrawRectangleLines(150, 240, 500, 200, DARKGRAY);
-        DrawText("PRODUCT FOUND", 320, 255, 20, DARKGREEN);
+        DrawRectangle(150, 420, 500, 80, LIGHTGRAY);
+        DrawRectangleLines(150, 420, 500, 80, DARKGRAY);
         
         char info[100];
-        sprintf(info, "Name: %s", foundProduct->name);
-        DrawText(info, 180, 290, 16, BLACK);
-        sprintf(info, "Qty: %d | Price: $%.2f", foundProduct->quantity, foundProduct->price);
-        DrawText(info, 180, 320, 16, BLACK);
+        sprintf(info, "Name: %s (ID %d)", foundProduct->name, foundProduct->id);
+        DrawText(info, 170, 432, 16, BLACK);
+        sprintf(info, "Qty: %d | Price: $%.2f | %s", foundProduct->quantity, foundProduct->price,
+                foundProduct->type == RAW_MATERIAL ? "Raw Material" : "Finished Good");
+        DrawText(info, 170, 462, 16, BLACK);
     }
 
-    Rectangle backBtn = {300, 470, 200, 40};
+    Rectangle backBtn = {300, 520, 200, 40};
     if (CheckCollisionPointRec(GetMousePosition(), backBtn)) {
         DrawRectangleRec(backBtn, DARKGRAY);
-        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) { currentScreen = MAIN_MENU; foundProduct = NULL; }
+        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) { currentScreen = MAIN_MENU; selectedId = 0; }
     } else DrawRectangleRec(backBtn, GRAY);
-    DrawText("BACK", 370, 483, 18, WHITE);
+    DrawText("BACK", 370, 533, 18, WHITE);
 }
 
 void drawChartsScreen() {
     ClearBackground(RAYWHITE);
     DrawText("DATA VISUALIZATION", 260, 20, 26, DARKBLUE);
+
+    // Everything below comes from the running totals, not a catalog scan
+    StockStats stats;
+    QtyEntry maxQ, minQ;
+    statsRead(store, &stats, &maxQ, &minQ);
+    char text[120];
     
-    // Bar Chart
-    DrawText("Stock Levels (First 8)", 80, 60, 18, BLACK);
+    // Bar Chart: how many products sit in each quantity range
+    sprintf(text, "Stock Levels (all %d products)", stats.products);
+    DrawText(text, 60, 60, 18, BLACK);
     DrawRectangleLines(50, 90, 350, 250, BLACK);
     
-    int maxQty = 1;
-    for(int i=0; i<productCount && i<8; i++) if(inventory[i].quantity > maxQty) maxQty = inventory[i].quantity;
+    long long maxBucket = 1;
+    for (int b = 0; b < STATS_BUCKETS; b++) if (stats.histogram[b] > maxBucket) maxBucket = stats.histogram[b];
     
-    for (int i = 0; i < productCount && i < 8; i++) {
-        int h = (inventory[i].quantity * 240) / maxQty;
-        DrawRectangle(60 + i * 40, 340 - h, 30, h, BLUE);
+    for (int b = 0; b < STATS_BUCKETS; b++) {
+        int h = (int)(stats.histogram[b] * 240 / maxBucket);
+        DrawRectangle(58 + b * 21, 340 - h, 16, h, b == 0 ? RED : BLUE);
+        if (b % 2 == 0) {
+            int low = b == 0 ? 0 : 1 << (b - 1);
+            if (low >= 1024) sprintf(text, "%dk", low / 1024);
+            else sprintf(text, "%d", low);
+            DrawText(text, 58 + b * 21, 345, 10, DARKGRAY);
+        }
     }
+    DrawText("units in stock (from)", 160, 360, 12, DARKGRAY);
 
-    // Basic Pie Chart (Simulated with Rectangles for simplicity without raymath)
+    // Type split as a proportional bar
     DrawText("Type Distribution", 470, 60, 18, BLACK);
-    int raw = 0, fin = 0;
-    for(int i=0; i<productCount; i++) (inventory[i].type == RAW_MATERIAL) ? raw++ : fin++;
+    Rectangle split = {470, 90, 280, 30};
+    int rawWidth = stats.products > 0 ? (int)(split.width * stats.typeCount[RAW_MATERIAL] / stats.products) : 0;
+    DrawRectangle((int)split.x, (int)split.y, rawWidth, (int)split.height, ORANGE);
+    DrawRectangle((int)split.x + rawWidth, (int)split.y, (int)split.width - rawWidth, (int)split.height, DARKGREEN);
+    DrawRectangleLinesEx(split, 1, BLACK);
     
-    char stats[100];
-    sprintf(stats, "Raw: %d | Finished: %d", raw, fin);
-    DrawText(stats, 470, 100, 16, DARKGRAY);
+    sprintf(text, "Raw: %d | Finished: %d", stats.typeCount[RAW_MATERIAL], stats.typeCount[FINISHED_GOOD]);
+    DrawText(text, 470, 130, 16, DARKGRAY);
+    sprintf(text, "Raw units: %lld (%.2f)", stats.typeUnits[RAW_MATERIAL], stats.typeValueCents[RAW_MATERIAL] / 100.0);
+    DrawText(text, 470, 155, 16, ORANGE);
+    sprintf(text, "Finished units: %lld (%.2f)", stats.typeUnits[FINISHED_GOOD], stats.typeValueCents[FINISHED_GOOD] / 100.0);
+    DrawText(text, 470, 180, 16, DARKGREEN);
+
+    // Totals
+    DrawText("Totals", 470, 220, 18, BLACK);
+    sprintf(text, "Units in stock: %lld", stats.typeUnits[0] + stats.typeUnits[1]);
+    DrawText(text, 470, 250, 16, DARKGRAY);
+    sprintf(text, "Stock value: %.2f", (stats.typeValueCents[0] + stats.typeValueCents[1]) / 100.0);
+    DrawText(text, 470, 275, 16, DARKGRAY);
+    if (stats.products > 0) {
+        Product* hi = searchProduct(store, maxQ.id);
+        Product* lo = searchProduct(store, minQ.id);
+        sprintf(text, "Most: %s (%d)", hi ? hi->name : "?", maxQ.quantity);
+        DrawText(text, 470, 300, 16, DARKGRAY);
+        sprintf(text, "Least: %s (%d)", lo ? lo->name : "?", minQ.quantity);
+        DrawText(text, 470, 325, 16, DARKGRAY);
+    }
     
     // Back Button
     Rectangle backBtn = {320, 500, 160, 40};
@@ -718,22 +793,130 @@ void drawChartsScreen() {
     DrawText("BACK", 375, 513, 18, WHITE);
 }
 
+// "850 us", "12.3 ms", "1.20 s"
+void formatLatency(char* out, double us) {
+    if (us < 1000) sprintf(out, "%.0f us", us);
+    else if (us < 1000000) sprintf(out, "%.1f ms", us / 1000);
+    else sprintf(out, "%.2f s", us / 1000000);
+}
+
+void drawMetricsScreen() {
+    static MetricSummary rows[METRIC_OPS];
+    static double readMs = 0;
+    static long long rateCount[METRIC_OPS];
+    static double rate[METRIC_OPS];
+    static double rateMs = 0;
+    static char message[100] = "";
+
+    ClearBackground(RAYWHITE);
+    DrawText("OPERATION METRICS", 270, 20, 26, DARKBLUE);
+
+    // Histograms are summed a few times a second, not every frame
+    screenRefreshIn(250);
+    double now = nowMs();
+    if (now - readMs >= 250) {
+        for (int op = 0; op < METRIC_OPS; op++) metricRead((MetricOp)op, &rows[op]);
+        readMs = now;
+    }
+    if (now - rateMs >= 1000) {
+        for (int op = 0; op < METRIC_OPS; op++) {
+            rate[op] = rateMs > 0 ? (rows[op].count - rateCount[op]) * 1000.0 / (now - rateMs) : 0;
+            rateCount[op] = rows[op].count;
+        }
+        rateMs = now;
+    }
+
+    const int cols[] = { 60, 210, 320, 420, 520, 620 };
+    const char* heads[] = { "Operation", "Count", "Ops/sec", "p50", "p99", "Max" };
+    for (int c = 0; c < 6; c++) DrawText(heads[c], cols[c], 65, 18, BLACK);
+    DrawLine(50, 88, 750, 88, GRAY);
+
+    char text[40];
+    for (int op = 0; op < METRIC_OPS; op++) {
+        int y = 95 + op * 22;
+        Color color = rows[op].count > 0 ? DARKGRAY : LIGHTGRAY;
+        DrawText(metricNames[op], cols[0], y, 16, color);
+        sprintf(text, "%lld", rows[op].count);
+        DrawText(text, cols[1], y, 16, color);
+        sprintf(text, "%.0f", rate[op]);
+        DrawText(text, cols[2], y, 16, color);
+        if (rows[op].timed == 0) continue;
+        formatLatency(text, rows[op].p50Us);
+        DrawText(text, cols[3], y, 16, color);
+        formatLatency(text, rows[op].p99Us);
+        DrawText(text, cols[4], y, 16, rows[op].p99Us > 16667 ? ORANGE : color);
+        formatLatency(text, rows[op].maxUs);
+        DrawText(text, cols[5], y, 16, color);
+    }
+
+    sprintf(text, "FPS: %d", GetFPS());
+    DrawText(text, 60, 445, 18, DARKBLUE);
+    DrawText("frame = work per redraw; lookups are timed 1 in 64", 200, 448, 14, GRAY);
+
+    Rectangle dumpBtn = {160, 500, 140, 40};
+    Rectangle resetBtn = {330, 500, 140, 40};
+    Rectangle backBtn = {500, 500, 140, 40};
+    Vector2 mouse = GetMousePosition();
+    int click = IsMouseButtonPressed(MOUSE_LEFT_BUTTON);
+
+    DrawRectangleRec(dumpBtn, CheckCollisionPointRec(mouse, dumpBtn) ? DARKBLUE : BLUE);
+    DrawText("DUMP", 205, 513, 18, WHITE);
+    if (click && CheckCollisionPointRec(mouse, dumpBtn)) {
+        if (metricsDump(METRICSFILE)) sprintf(message, "Metrics written to %s", METRICSFILE);
+        else sprintf(message, "Error writing %s!", METRICSFILE);
+    }
+
+    DrawRectangleRec(resetBtn, CheckCollisionPointRec(mouse, resetBtn) ? DARKGRAY : GRAY);
+    DrawText("RESET", 370, 513, 18, WHITE);
+    if (click && CheckCollisionPointRec(mouse, resetBtn)) {
+        metricsReset();
+        readMs = rateMs = 0;
+        memset(rateCount, 0, sizeof(rateCount));
+        message[0] = '\0';
+    }
+
+    DrawRectangleRec(backBtn, CheckCollisionPointRec(mouse, backBtn) ? DARKGRAY : GRAY);
+    DrawText("BACK", 545, 513, 18, WHITE);
+    if (click && CheckCollisionPointRec(mouse, backBtn)) {
+        message[0] = '\0';
+        currentScreen = MAIN_MENU;
+    }
+
+    DrawText(message, 160, 555, 18, DARKGREEN);
+}
+
 void drawActivityLogScreen() {
+    static int scroll = 0;      // Lines scrolled back from the newest
+    static char lines[22][LOG_LINE_LEN];
+    const int pageLines = 22;
+
     ClearBackground(RAYWHITE);
     DrawText("ACTIVITY LOG", 300, 20, 26, DARKBLUE);
-    
-    FILE* fp = fopen(LOGFILE, "r");
-    if (fp) {
-        char line[256];
-        int y = 70;
-        int count = 0;
-        while (fgets(line, sizeof(line), fp) && count < 20) {
-            line[strcspn(line, "\n")] = 0;
-            DrawText(line, 30, y, 10, BLACK);
+    screenRefreshIn(1000);      // The logger picks up lines other processes append
+
+    // Mouse wheel scrolls, PgUp/PgDn pages, Home/End jump
+    int wheel = (int)GetMouseWheelMove();
+    scroll += wheel * 3;
+    if (IsKeyPressed(KEY_PAGE_UP)) scroll += pageLines;
+    if (IsKeyPressed(KEY_PAGE_DOWN)) scroll -= pageLines;
+    if (IsKeyPressed(KEY_HOME)) scroll = LOG_VIEW_LINES;
+    if (IsKeyPressed(KEY_END)) scroll = 0;
+    if (scroll < 0) scroll = 0;
+
+    int available = 0;
+    int shown = logViewCopy(store, scroll, pageLines, lines, &available);
+    if (scroll > available - pageLines) scroll = available > pageLines ? available - pageLines : 0;
+
+    if (shown > 0) {
+        int y = 60;
+        for (int i = 0; i < shown; i++) {
+            DrawText(lines[i], 30, y, 10, BLACK);
             y += 18;
-            count++;
         }
-        fclose(fp);
+        char status[100];
+        sprintf(status, "Lines %d-%d of %d most recent (wheel / PgUp / PgDn / Home / End)",
+                available - scroll - shown + 1, available - scroll, available);
+        DrawText(status, 30, 470, 10, DARKGRAY);
     } else {
         DrawText("No logs yet.", 300, 200, 20, GRAY);
     }
@@ -741,59 +924,1363 @@ void drawActivityLogScreen() {
     Rectangle backBtn = {320, 500, 160, 40};
     if (CheckCollisionPointRec(GetMousePosition(), backBtn)) {
         DrawRectangleRec(backBtn, DARKGRAY);
-        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) currentScreen = MAIN_MENU;
+        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) { currentScreen = MAIN_MENU; scroll = 0; }
     } else DrawRectangleRec(backBtn, GRAY);
     DrawText("BACK", 375, 513, 18, WHITE);
 }
 
 void drawExportScreen() {
     static char message[100] = "";
+    static int typeFilter = -1;
+    static int lowStockOnly = 0;
+    static char minIdStr[20] = "";
+    static char maxIdStr[20] = "";
+    static int focus = 0;
+    static int waiting = 0;     // Our background export hasn't reported yet
     ClearBackground(RAYWHITE);
-    DrawText("EXPORT CSV", 300, 60, 26, DARKBLUE);
+    DrawText("EXPORT / IMPORT CSV", 250, 60, 26, DARKBLUE);
+
+    // Filters
+    DrawText("Type:", 150, 115, 18, BLACK);
+    const char* typeLabels[] = {"All", "Raw", "Finished"};
+    for (int i = 0; i < 3; i++) {
+        Rectangle btn = {250 + i * 110.0f, 110, 100, 28};
+        int selected = typeFilter == i - 1;
+        DrawRectangleRec(btn, selected ? DARKBLUE : LIGHTGRAY);
+        DrawText(typeLabels[i], btn.x + 10, btn.y + 6, 16, selected ? WHITE : BLACK);
+        if (CheckCollisionPointRec(GetMousePosition(), btn) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) typeFilter = i - 1;
+    }
+    Rectangle lowBtn = {250, 150, 210, 28};
+    DrawRectangleRec(lowBtn, lowStockOnly ? DARKBLUE : LIGHTGRAY);
+    DrawText(lowStockOnly ? "Low stock only: ON" : "Low stock only: OFF", 260, 156, 16, lowStockOnly ? WHITE : BLACK);
+    if (CheckCollisionPointRec(GetMousePosition(), lowBtn) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) lowStockOnly = !lowStockOnly;
+
+    DrawText("IDs:", 150, 195, 18, BLACK);
+    Rectangle minBox = {250, 190, 100, 28};
+    Rectangle maxBox = {390, 190, 100, 28};
+    DrawRectangleRec(minBox, focus == 1 ? SKYBLUE : WHITE);
+    DrawRectangleLinesEx(minBox, 1, BLACK);
+    DrawText(minIdStr[0] ? minIdStr : "from", 258, 195, 16, minIdStr[0] ? BLACK : GRAY);
+    DrawText("-", 365, 195, 18, BLACK);
+    DrawRectangleRec(maxBox, focus == 2 ? SKYBLUE : WHITE);
+    DrawRectangleLinesEx(maxBox, 1, BLACK);
+    DrawText(maxIdStr[0] ? maxIdStr : "to", 398, 195, 16, maxIdStr[0] ? BLACK : GRAY);
+    if (CheckCollisionPointRec(GetMousePosition(), minBox) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) focus = 1;
+    if (CheckCollisionPointRec(GetMousePosition(), maxBox) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) focus = 2;
+    if (focus == 1) HandleTextInput(minIdStr, 10, 1);
+    if (focus == 2) HandleTextInput(maxIdStr, 10, 1);
     
+    // Exports run in the background; the button is disabled meanwhile
+    int busy = atomic_load(&store->exportBusy);
     Rectangle expBtn = {280, 240, 240, 50};
-    if (CheckCollisionPointRec(GetMousePosition(), expBtn)) {
+    if (busy) {
+        DrawRectangleRec(expBtn, LIGHTGRAY);
+        sprintf(message, "Exporting... %lld rows", (long long)atomic_load(&store->exportRowsWritten));
+    } else if (CheckCollisionPointRec(GetMousePosition(), expBtn)) {
         DrawRectangleRec(expBtn, DARKGREEN);
         if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-            exportToCSV(inventory, productCount);
-            sprintf(message, "Exported to inventory_export.csv");
+            ExportFilter filter = { typeFilter, lowStockOnly, atoi(minIdStr), atoi(maxIdStr) };
+            waiting = exportStart(store, store->csvPath, &filter);
+            if (!waiting) sprintf(message, "Could not start export!");
         }
     } else DrawRectangleRec(expBtn, GREEN);
     DrawText("EXPORT NOW", 330, 258, 18, WHITE);
+    if (waiting && !busy) {
+        waiting = 0;
+        if (atomic_load(&store->exportLastResult) == 1) {
+            sprintf(message, "Exported %lld rows to inventory_export.csv", (long long)atomic_load(&store->exportRowsWritten));
+        } else sprintf(message, "Export failed!");
+    }
+
+    // Bulk onboarding reads the same format from CSVIMPORTFILE (admin only)
+    Rectangle impBtn = {280, 310, 240, 50};
+    if (currentUser.role != ADMIN) {
+        DrawRectangleRec(impBtn, LIGHTGRAY);
+        DrawText("IMPORT CSV", 330, 328, 18, GRAY);
+    } else {
+        if (CheckCollisionPointRec(GetMousePosition(), impBtn)) {
+            DrawRectangleRec(impBtn, DARKBLUE);
+            if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && !busy) {
+                ImportReport report;
+                if (!importCSV(store, CSVIMPORTFILE, &report)) {
+                    if (report.outOfMemory > 0) sprintf(message, "Out of memory: %lld rows not imported", report.outOfMemory);
+                    else sprintf(message, "Could not import %s", CSVIMPORTFILE);
+                } else {
+                    sprintf(message, "Imported %lld products, skipped %lld rows", report.imported,
+                            report.malformed + report.duplicates + report.existing);
+                }
+            }
+        } else DrawRectangleRec(impBtn, BLUE);
+        DrawText("IMPORT CSV", 330, 328, 18, WHITE);
+    }
+    DrawText("Imports " CSVIMPORTFILE, 290, 365, 14, GRAY);
 
-    Rectangle backBtn = {320, 310, 160, 40};
+    Rectangle backBtn = {320, 400, 160, 40};
     if (CheckCollisionPointRec(GetMousePosition(), backBtn)) {
         DrawRectangleRec(backBtn, DARKGRAY);
         if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) { currentScreen = MAIN_MENU; message[0] = '\0'; }
     } else DrawRectangleRec(backBtn, GRAY);
-    DrawText("BACK", 375, 323, 18, WHITE);
-    DrawText(message, 200, 400, 16, GREEN);
+    DrawText("BACK", 375, 413, 18, WHITE);
+    DrawText(message, 200, 470, 16, GREEN);
+}
+
+// ---------------- Network Server ----------------
+// --serve makes this process the single owner of the inventory and serves
+// it to shop-floor stations over loopback TCP or a Unix domain socket.
+// One epoll loop handles every connection. Clients may pipeline: all
+// complete frames in a read are executed in order, and their responses
+// are queued and written back as the socket allows. A client that sends
+// without reading stops being read (and its frames executed) once
+// SERVER_MAX_PENDING reply bytes are waiting, until the socket drains; a
+// reply that can't be queued at all closes the connection, since the
+// client would otherwise wait forever for that tag.
+//
+// Frames are little-endian:
+//   request:  u32 length | u8 op     | u32 tag | payload   (length counts bytes after itself)
+//   response: u32 length | u8 status | u32 tag | payload   (tag echoed back)
+// Payloads:
+//   LOGIN    u8 userLen, user, u8 passLen, pass
+//   ADD      i32 id, i32 qty, f32 price, u8 type, u8 nameLen, name[, i32 reorderLevel]  (admin)
+//   SEARCH   i32 id            -> i32 id, i32 qty, f32 price, u8 type, u8 nameLen, name
+//   UPDATE / SALE / PURCHASE   i32 id, i32 qty
+//   DELETE   i32 id                                                    (admin)
+//   EXPORT   (none)            -> i32 products written to CSVFILE
+//   LOGOUT   (none)
+//   SET_REORDER  i32 id, i32 level
+// Every op except LOGIN needs a logged-in session (authenticateUser).
+
+typedef enum {
+    OP_LOGIN = 1,
+    OP_ADD,
+    OP_SEARCH,
+    OP_UPDATE,
+    OP_SALE,
+    OP_PURCHASE,
+    OP_DELETE,
+    OP_EXPORT,
+    OP_LOGOUT,
+    OP_SET_REORDER
+} ServerOp;
+
+typedef enum {
+    ST_OK,
+    ST_NOT_FOUND,
+    ST_INSUFFICIENT_STOCK,
+    ST_INVALID_QTY,
+    ST_EXISTS,
+    ST_NOT_AUTHENTICATED,
+    ST_FORBIDDEN,
+    ST_BAD_REQUEST
+} ServerStatus;
+
+#ifdef __linux__
+
+typedef struct {
+    int fd;
+    int loggedIn;
+    User user;
+    char* in;
+    size_t inLen, inCap;
+    char* out;
+    size_t outLen, outOff, outCap;
+    int broken;         // A reply could not be queued
+} Connection;
+
+volatile sig_atomic_t serverStop = 0;
+
+void onServerSignal(int sig) {
+    (void)sig;
+    serverStop = 1;
+}
+
+int ensureBuffer(char** buf, size_t* cap, size_t needed) {
+    if (needed <= *cap) return 1;
+    size_t newCap = *cap ? *cap : 4096;
+    while (newCap < needed) newCap *= 2;
+    char* grown = realloc(*buf, newCap);
+    if (grown == NULL) return 0;
+    *buf = grown;
+    *cap = newCap;
+    return 1;
+}
+
+// Cursor over a request payload; reads fail (ok = 0) instead of overrunning.
+typedef struct {
+    const unsigned char* p;
+    size_t left;
+    int ok;
+} Reader;
+
+int readI32(Reader* r) {
+    int v = 0;
+    if (r->left < 4) { r->ok = 0; return 0; }
+    memcpy(&v, r->p, 4);
+    r->p += 4; r->left -= 4;
+    return v;
+}
+
+float readF32(Reader* r) {
+    float v = 0;
+    if (r->left < 4) { r->ok = 0; return 0; }
+    memcpy(&v, r->p, 4);
+    r->p += 4; r->left -= 4;
+    return v;
+}
+
+// Reads a u8-length-prefixed string into out (NUL-terminated).
+void readStr(Reader* r, char* out, size_t size) {
+    out[0] = '\0';
+    if (r->left < 1) { r->ok = 0; return; }
+    size_t len = *r->p++;
+    r->left--;
+    if (len > r->left || len >= size) { r->ok = 0; return; }
+    memcpy(out, r->p, len);
+    out[len] = '\0';
+    r->p += len; r->left -= len;
+}
+
+// Queues one response frame on the connection (marks it broken if out of memory).
+void queueResponse(Connection* c, ServerStatus status, unsigned int tag, const void* payload, size_t len) {
+    unsigned int frameLen = (unsigned int)(1 + 4 + len);
+    if (!ensureBuffer(&c->out, &c->outCap, c->outLen + 4 + frameLen)) {
+        c->broken = 1;
+        return;
+    }
+    char* w = c->out + c->outLen;
+    memcpy(w, &frameLen, 4);
+    w[4] = (char)status;
+    memcpy(w + 5, &tag, 4);
+    if (len) memcpy(w + 9, payload, len);
+    c->outLen += 4 + frameLen;
+}
+
+ServerStatus fromTxn(TxnResult r) {
+    switch (r) {
+        case TXN_OK: return ST_OK;
+        case TXN_NOT_FOUND: return ST_NOT_FOUND;
+        case TXN_INSUFFICIENT_STOCK: return ST_INSUFFICIENT_STOCK;
+        default: return ST_INVALID_QTY;
+    }
+}
+
+void handleRequest(Connection* c, unsigned char op, unsigned int tag, const unsigned char* payload, size_t len) {
+    Reader r = { payload, len, 1 };
+    unsigned char reply[128];
+    size_t replyLen = 0;
+    ServerStatus st = ST_OK;
+
+    if (op != OP_LOGIN && !c->loggedIn) {
+        queueResponse(c, ST_NOT_AUTHENTICATED, tag, NULL, 0);
+        return;
+    }
+    currentUser = c->user;     // Log entries are attributed to this session
+
+    switch (op) {
+        case OP_LOGIN: {
+            char user[MAX_USERNAME], pass[MAX_PASSWORD];
+            readStr(&r, user, sizeof(user));
+            readStr(&r, pass, sizeof(pass));
+            if (!r.ok) { st = ST_BAD_REQUEST; break; }
+            c->loggedIn = authenticateUser(store, user, pass);
+            if (c->loggedIn) c->user = currentUser;
+            st = c->loggedIn ? ST_OK : ST_NOT_AUTHENTICATED;
+            break;
+        }
+        case OP_ADD: {
+            int id = readI32(&r), qty = readI32(&r);
+            float price = readF32(&r);
+            int type = r.left ? *r.p : -1;
+            if (r.left) { r.p++; r.left--; }
+            char name[50];
+            readStr(&r, name, sizeof(name));
+            int level = r.left >= 4 ? readI32(&r) : LOW_STOCK_THRESHOLD;
+            if (!r.ok || id <= 0 || qty < 0 || !(price >= 0 && price <= MAX_PRICE) || level < 0 || name[0] == '\0' ||
+                (type != RAW_MATERIAL && type != FINISHED_GOOD)) st = ST_BAD_REQUEST;
+            else if (c->user.role != ADMIN) st = ST_FORBIDDEN;
+            else st = addProduct(store, id, name, qty, price, (ProductType)type, level) ? ST_OK : ST_EXISTS;
+            break;
+        }
+        case OP_SEARCH: {
+            int id = readI32(&r);
+            if (!r.ok) { st = ST_BAD_REQUEST; break; }
+            pthread_rwlock_rdlock(&store->inventoryLock);
+            Product* p = searchProduct(store, id);
+            if (p == NULL) st = ST_NOT_FOUND;
+            else {
+                int qty = __atomic_load_n(&p->quantity, __ATOMIC_ACQUIRE);
+                unsigned char nameLen = (unsigned char)strlen(p->name);
+                memcpy(reply, &p->id, 4);
+                memcpy(reply + 4, &qty, 4);
+                memcpy(reply + 8, &p->price, 4);
+                reply[12] = (unsigned char)p->type;
+                reply[13] = nameLen;
+                memcpy(reply + 14, p->name, nameLen);
+                replyLen = 14 + nameLen;
+            }
+            pthread_rwlock_unlock(&store->inventoryLock);
+            break;
+        }
+        case OP_UPDATE:
+        case OP_SALE:
+        case OP_PURCHASE: {
+            int id = readI32(&r), qty = readI32(&r);
+            if (!r.ok) { st = ST_BAD_REQUEST; break; }
+            TxnResult res = op == OP_UPDATE ? updateStock(store, id, qty)
+                          : op == OP_SALE ? processSale(store, id, qty)
+                          : processPurchase(store, id, qty);
+            st = fromTxn(res);
+            break;
+        }
+        case OP_DELETE: {
+            int id = readI32(&r);
+            if (!r.ok) { st = ST_BAD_REQUEST; break; }
+            if (c->user.role != ADMIN) { st = ST_FORBIDDEN; break; }
+            if (!deleteProduct(store, id)) st = ST_NOT_FOUND;
+            break;
+        }
+        case OP_EXPORT: {
+            exportToCSV(store);
+            memcpy(reply, &store->productCount, 4);
+            replyLen = 4;
+            break;
+        }
+        case OP_LOGOUT:
+            logEvent(store, LOG_LOGOUT, 0, 0, NULL);
+            c->loggedIn = 0;
+            break;
+        case OP_SET_REORDER: {
+            int id = readI32(&r), level = readI32(&r);
+            if (!r.ok) { st = ST_BAD_REQUEST; break; }
+            st = fromTxn(setReorderLevel(store, id, level));
+            break;
+        }
+        default:
+            st = ST_BAD_REQUEST;
+            break;
+    }
+    queueResponse(c, st, tag, reply, replyLen);
+}
+
+size_t pendingOutput(const Connection* c) {
+    return c->outLen - c->outOff;
+}
+
+// Executes the complete frames in the input buffer, stopping early while
+// too much output is pending. Returns 0 if the client sent something
+// unframeable or a reply was lost, and should be dropped.
+int processInput(Connection* c) {
+    size_t off = 0;
+    while (c->inLen - off >= 4 && pendingOutput(c) < SERVER_MAX_PENDING) {
+        unsigned int frameLen;
+        memcpy(&frameLen, c->in + off, 4);
+        if (frameLen < 5 || frameLen > SERVER_MAX_FRAME) return 0;
+        if (c->inLen - off - 4 < frameLen) break;
+
+        const unsigned char* f = (const unsigned char*)c->in + off + 4;
+        unsigned int tag;
+        memcpy(&tag, f + 1, 4);
+        handleRequest(c, f[0], tag, f + 5, frameLen - 5);
+        if (c->broken) return 0;
+        off += 4 + frameLen;
+    }
+    memmove(c->in, c->in + off, c->inLen - off);
+    c->inLen -= off;
+    return 1;
+}
+
+// Writes as much queued output as the socket takes. Returns 0 on error.
+int flushOutput(Connection* c) {
+    while (c->outOff < c->outLen) {
+        ssize_t n = send(c->fd, c->out + c->outOff, c->outLen - c->outOff, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return 0;
+            // Keep what is left at the front so the buffer doesn't creep
+            memmove(c->out, c->out + c->outOff, c->outLen - c->outOff);
+            c->outLen -= c->outOff;
+            c->outOff = 0;
+            return 1;
+        }
+        c->outOff += (size_t)n;
+    }
+    c->outOff = c->outLen = 0;
+    return 1;
+}
+
+// Executes buffered frames and writes replies until the input runs out of
+// complete frames or the output backs up. Returns 0 to drop the client.
+int serveConnection(Connection* c) {
+    for (;;) {
+        size_t before = c->inLen;
+        if (!processInput(c) || !flushOutput(c)) return 0;
+        if (c->inLen == before || pendingOutput(c) >= SERVER_MAX_PENDING) return 1;
+    }
+}
+
+void closeConnection(int epfd, Connection* c) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->in);
+    free(c->out);
+    free(c);
+}
+
+// `where` is a TCP port on 127.0.0.1, or a filesystem path for a Unix socket.
+int openListener(const char* where) {
+    int fd;
+    char* end;
+    long port = strtol(where, &end, 10);
+    if (*end == '\0' && port > 0 && port < 65536) {
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (fd < 0) return -1;
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((unsigned short)port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) { close(fd); return -1; }
+    } else {
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (fd < 0) return -1;
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", where);
+        unlink(where);
+        if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) { close(fd); return -1; }
+    }
+    if (listen(fd, 128) != 0) { close(fd); return -1; }
+    return fd;
+}
+
+int runServer(const char* where) {
+    int listener = openListener(where);
+    if (listener < 0) {
+        printf("Cannot listen on %s: %s\n", where, strerror(errno));
+        return 1;
+    }
+
+    loadInventory(store);
+    loggerStart(store);
+    metricsStartMs = nowMs();
+    signal(SIGINT, onServerSignal);
+    signal(SIGTERM, onServerSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    int epfd = epoll_create1(0);
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };   // NULL marks the listener
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listener, &ev);
+    printf("Serving %d products on %s (Ctrl+C to stop)\n", store->productCount, where);
+
+    struct epoll_event events[64];
+    while (!serverStop) {
+        int n = epoll_wait(epfd, events, 64, JOURNAL_COMMIT_MS / 4);
+        for (int i = 0; i < n; i++) {
+            Connection* c = events[i].data.ptr;
+            if (c == NULL) {
+                int fd;
+                while ((fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+                    int one = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));  // Fails harmlessly on Unix sockets
+                    Connection* nc = calloc(1, sizeof(Connection));
+                    if (nc == NULL) {
+                        close(fd);
+                        continue;
+                    }
+                    nc->fd = fd;
+                    struct epoll_event cev = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = nc };
+                    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &cev) != 0) {
+                        close(fd);
+                        free(nc);
+                    }
+                }
+                continue;
+            }
+
+            int alive = 1, peerClosed = 0;
+            if (events[i].events & EPOLLIN) {
+                // Read at most SERVER_MAX_PENDING ahead; level-triggered epoll brings us back for the rest
+                while (c->inLen < SERVER_MAX_PENDING) {
+                    if (!ensureBuffer(&c->in, &c->inCap, c->inLen + 4096)) { alive = 0; break; }
+                    ssize_t got = recv(c->fd, c->in + c->inLen, c->inCap - c->inLen, 0);
+                    if (got > 0) { c->inLen += (size_t)got; continue; }
+                    if (got == 0) peerClosed = 1;
+                    else if (errno != EAGAIN && errno != EWOULDBLOCK) alive = 0;
+                    break;
+                }
+            }
+            if (events[i].events & EPOLLERR) alive = 0;
+            if (alive) alive = serveConnection(c);
+            if (peerClosed || (events[i].events & EPOLLHUP)) alive = 0;   // After delivering what we could
+
+            if (!alive) {
+                closeConnection(epfd, c);
+                continue;
+            }
+            // Only ask for writability while output is backed up, and stop
+            // reading until it drains below the cap
+            int reading = pendingOutput(c) < SERVER_MAX_PENDING && c->inLen < SERVER_MAX_PENDING;
+            struct epoll_event mod = { .events = (reading ? EPOLLIN | EPOLLRDHUP : 0) | (c->outLen ? EPOLLOUT : 0), .data.ptr = c };
+            epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &mod);
+        }
+        journalTick(store);
+    }
+
+    printf("Shutting down\n");
+    close(listener);
+    close(epfd);
+    loggerShutdown(store);
+    journalCheckpoint(store);
+    if (!metricsDump(METRICSFILE)) printf("Error writing %s\n", METRICSFILE);
+    return 0;
+}
+
+#else
+
+int runServer(const char* where) {
+    (void)where;
+    printf("Server mode is only available on Linux builds.\n");
+    return 1;
+}
+
+#endif
+
+// ---------------- Command Line Modes ----------------
+// Run without opening a window when arguments are given.
+
+typedef enum {
+    BATCH_SALE,
+    BATCH_PURCHASE,
+    BATCH_UPDATE,
+    BATCH_REORDER,
+    BATCH_DELETE
+} BatchOp;
+
+// Parses "id,op,qty" where op is S/P/U/R/D (or sale/purchase/update/reorder/
+// delete). The qty of a delete line is ignored.
+int parseBatchLine(const char* line, const char* end, int* id, BatchOp* op, int* qty) {
+    const char* c = line;
+    if (!parseIntField(&c, end, id) || c >= end || *c++ != ',') return 0;
+    while (c < end && *c == ' ') c++;
+    if (c >= end) return 0;
+    switch (*c | 0x20) {
+        case 's': *op = BATCH_SALE; break;
+        case 'p': *op = BATCH_PURCHASE; break;
+        case 'u': *op = BATCH_UPDATE; break;
+        case 'r': *op = BATCH_REORDER; break;
+        case 'd': *op = BATCH_DELETE; break;
+        default: return 0;
+    }
+    while (c < end && *c != ',') c++;
+    if (c >= end) return 0;
+    c++;
+    if (!parseIntField(&c, end, qty)) return 0;
+    return c == end;
+}
+
+// Streams a transaction file through processSale/processPurchase/updateStock/
+// setReorderLevel/deleteProduct.
+// Journal records are committed once per `batchSize` lines instead of by the
+// usual group-commit timer, and folded into the snapshot once at the end.
+int runBatchFile(const char* path, int batchSize) {
+    FILE* fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (fp == NULL) {
+        printf("Error reading %s\n", path);
+        return 1;
+    }
+
+    strcpy(currentUser.username, "batch");
+    currentUser.role = STAFF;
+    loadInventory(store);
+    loggerStart(store);
+    store->journalAutoCommit = 0;
+
+    const size_t chunkSize = 1 << 20;
+    char* buf = malloc(chunkSize + LOG_LINE_LEN);
+    long long lineNo = 0, applied = 0, rejected = 0, inBatch = 0;
+    long long reasons[5] = {0};     // TxnResult counts, [4] = unparseable
+    size_t carry = 0;
+    double start = nowMs();
+    const char* reasonText[] = {"ok", "unknown product", "insufficient stock", "invalid quantity", "malformed line"};
+
+    for (;;) {
+        size_t got = fread(buf + carry, 1, chunkSize, fp);
+        size_t len = carry + got;
+        if (len == 0) break;
+        if (got == 0) buf[len++] = '\n';   // Last line without a newline
+
+        char* lineStart = buf;
+        char* end = buf + len;
+        char* nl;
+        while ((nl = memchr(lineStart, '\n', (size_t)(end - lineStart))) != NULL) {
+            char* lineEnd = nl;
+            if (lineEnd > lineStart && lineEnd[-1] == '\r') lineEnd--;
+            lineNo++;
+
+            if (lineEnd > lineStart && lineStart[0] != '#') {
+                int id, qty;
+                BatchOp op;
+                int r;
+                if (!parseBatchLine(lineStart, lineEnd, &id, &op, &qty)) r = 4;
+                else if (op == BATCH_SALE) r = processSale(store, id, qty);
+                else if (op == BATCH_PURCHASE) r = processPurchase(store, id, qty);
+                else if (op == BATCH_REORDER) r = setReorderLevel(store, id, qty);
+                else if (op == BATCH_DELETE) r = deleteProduct(store, id) ? TXN_OK : TXN_NOT_FOUND;
+                else r = updateStock(store, id, qty);
+
+                reasons[r]++;
+                if (r == TXN_OK) applied++;
+                else if (++rejected <= 20) {
+                    fprintf(stderr, "line %lld rejected (%s): %.*s\n", lineNo, reasonText[r],
+                            (int)(lineEnd - lineStart), lineStart);
+                }
+                if (++inBatch >= batchSize) {
+                    journalCommit(store);
+                    inBatch = 0;
+                }
+            }
+            lineStart = nl + 1;
+        }
+
+        carry = (size_t)(end - lineStart);
+        if (carry > LOG_LINE_LEN) {
+            // Absurdly long line: count it as rejected and drop it
+            lineNo++;
+            rejected++;
+            reasons[4]++;
+            carry = 0;
+        }
+        memmove(buf, lineStart, carry);
+        if (got == 0) break;
+    }
+    if (fp != stdin) fclose(fp);
+    free(buf);
+
+    journalCommit(store);
+    store->journalAutoCommit = 1;
+    journalCheckpoint(store);
+    double elapsed = (nowMs() - start) / 1000.0;
+    loggerShutdown(store);
+
+    if (rejected > 20) fprintf(stderr, "... %lld more rejected lines not shown\n", rejected - 20);
+    printf("Processed %lld lines in %.3f s (%.0f lines/s)\n", lineNo, elapsed, elapsed > 0 ? lineNo / elapsed : 0.0);
+    printf("Applied: %lld  Rejected: %lld\n", applied, rejected);
+    for (int i = 1; i < 5; i++) {
+        if (reasons[i]) printf("  %-20s %lld\n", reasonText[i], reasons[i]);
+    }
+    return rejected > 0 ? 2 : 0;
+}
+
+// --export-csv [file|-] [--type raw|finished] [--low-stock] [--ids A-B]
+int runCsvExport(int argc, char** argv) {
+    const char* path = CSVFILE;
+    ExportFilter filter = { -1, 0, 0, 0 };
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--type") == 0 && i + 1 < argc) {
+            char t = foldChar(argv[++i][0]);
+            filter.type = t == 'r' ? RAW_MATERIAL : t == 'f' ? FINISHED_GOOD : -2;
+        } else if (strcmp(argv[i], "--low-stock") == 0) {
+            filter.lowStockOnly = 1;
+        } else if (strcmp(argv[i], "--ids") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d-%d", &filter.minId, &filter.maxId) < 1) filter.type = -2;
+        } else if (argv[i][0] != '-' || strcmp(argv[i], "-") == 0) {
+            path = argv[i];
+        } else filter.type = -2;
+        if (filter.type == -2) {
+            printf("Bad export option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    // Keep stdout clean when it carries the CSV
+    int toStdout = strcmp(path, "-") == 0;
+    strcpy(currentUser.username, "export");
+    loadInventory(store);
+    loggerStart(store);
+    double start = nowMs();
+    long long rows = exportCSV(store, path, &filter);
+    double elapsed = (nowMs() - start) / 1000.0;
+    loggerShutdown(store);
+    if (rows < 0) {
+        fprintf(toStdout ? stderr : stdout, "Error exporting to %s\n", path);
+        return 1;
+    }
+    fprintf(toStdout ? stderr : stdout, "Exported %lld products to %s in %.3f s\n", rows, toStdout ? "stdout" : path, elapsed);
+    return 0;
+}
+
+// Bulk-loads products from a CSV file (see CSV Import) and reports what was skipped.
+int runCsvImport(const char* path) {
+    strcpy(currentUser.username, "import");
+    currentUser.role = ADMIN;
+    loadInventory(store);
+    loggerStart(store);
+
+    ImportReport report;
+    double start = nowMs();
+    int ok = importCSV(store, path, &report);
+    double elapsed = (nowMs() - start) / 1000.0;
+    loggerShutdown(store);
+    if (!ok) {
+        printf("Error importing %s\n", path);
+        if (report.outOfMemory > 0) printf("Imported: %lld  Lost (out of memory): %lld\n", report.imported, report.outOfMemory);
+        return 1;
+    }
+
+    long long skipped = report.malformed + report.duplicates + report.existing;
+    printf("Read %lld lines in %.3f s (%.0f lines/s)\n", report.lines, elapsed, elapsed > 0 ? report.lines / elapsed : 0.0);
+    printf("Imported: %lld  Skipped: %lld\n", report.imported, skipped);
+    if (report.malformed) printf("  %-20s %lld\n", "malformed row", report.malformed);
+    if (report.duplicates) printf("  %-20s %lld\n", "duplicate id in file", report.duplicates);
+    if (report.existing) printf("  %-20s %lld\n", "id already exists", report.existing);
+    return skipped > 0 ? 2 : 0;
+}
+
+// Company-wide stock report across warehouses/site1..N (see Warehouses):
+// per-site totals, company totals and the most critical low stock alerts,
+// all gathered from the sites in parallel.
+int runWarehouseReport(int count) {
+    Company* c = companyOpen(WAREHOUSE_DIR, count);
+    if (c == NULL) return 1;
+
+    StockStats total, sites[MAX_WAREHOUSES];
+    companyStats(c, &total, sites);
+    printf("%-8s %10s %14s %16s\n", "Site", "Products", "Units", "Value");
+    for (int k = 0; k < c->count; k++) {
+        const StockStats* s = &sites[k];
+        printf("site%-4d %10d %14lld %16.2f\n", k + 1, s->products, s->typeUnits[0] + s->typeUnits[1],
+               (s->typeValueCents[0] + s->typeValueCents[1]) / 100.0);
+    }
+    printf("%-8s %10d %14lld %16.2f\n", "Total", total.products, total.typeUnits[0] + total.typeUnits[1],
+           (total.typeValueCents[0] + total.typeValueCents[1]) / 100.0);
+
+    CompanyAlert alerts[10];
+    int alertTotal;
+    int shown = companyLowStock(c, alerts, 10, &alertTotal);
+    printf("\nLow stock alerts: %d\n", alertTotal);
+    for (int i = 0; i < shown; i++) {
+        printf("  site%d  ID %d: %d units (reorder level %d)\n", alerts[i].site, alerts[i].alert.id,
+               alerts[i].alert.quantity, alerts[i].alert.reorderLevel);
+    }
+    companyClose(c);
+    return 0;
+}
+
+// Moves stock between two sites: --transfer <from> <to> <id> <qty>.
+int runTransfer(int from, int to, int id, int qty) {
+    int count = warehouseCount(WAREHOUSE_DIR);
+    if (from < 1 || to < 1 || from > count || to > count || from == to) {
+        printf("Sites must be two different existing sites (1..%d)\n", count);
+        return 1;
+    }
+    Company* c = companyOpen(WAREHOUSE_DIR, count);
+    if (c == NULL) return 1;
+    strcpy(currentUser.username, "transfer");
+    currentUser.role = ADMIN;
+    TxnResult r = companyTransfer(c, from, to, id, qty);
+    if (r == TXN_OK) {
+        int perSite[MAX_WAREHOUSES];
+        companyStock(c, id, perSite);
+        printf("Moved %d units of product %d: site%d now has %d, site%d has %d\n",
+               qty, id, from, perSite[from - 1], to, perSite[to - 1]);
+    } else {
+        printf("Transfer failed: %s\n", txnResultMessage(r));
+    }
+    companyClose(c);
+    return r == TXN_OK ? 0 : 1;
+}
+
+// Parses "YYYY-MM-DD[ HH:MM[:SS]]" (local time) or plain epoch seconds into
+// ms since the epoch. A bare date means the end of that day.
+int parseTime(const char* text, long long* ms) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    int n = sscanf(text, "%d-%d-%d %d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec);
+    if (n >= 3) {
+        if (n == 3) {
+            tm.tm_hour = 23;
+            tm.tm_min = 59;
+            tm.tm_sec = 59;
+        }
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+        tm.tm_isdst = -1;
+        time_t t = mktime(&tm);
+        if (t == (time_t)-1) return 0;
+        *ms = (long long)t * 1000 + (n == 3 ? 999 : 0);
+        return 1;
+    }
+    char* end;
+    long long secs = strtoll(text, &end, 10);
+    if (end == text || *end != '\0') return 0;
+    *ms = secs * 1000;
+    return 1;
+}
+
+// Stock of one product as it was at a given time (see Stock Ledger).
+int runStockAt(int id, const char* when) {
+    long long t;
+    if (!parseTime(when, &t)) {
+        printf("Bad time: %s (use YYYY-MM-DD[ HH:MM[:SS]] or epoch seconds)\n", when);
+        return 1;
+    }
+    loadInventory(store);
+    int qty;
+    if (!ledgerQuantityAt(store, id, t, &qty)) {
+        printf("Product %d had no recorded stock at %s\n", id, when);
+        return 1;
+    }
+    printf("Product %d had %d units at %s\n", id, qty, when);
+    return 0;
+}
+
+// Net stock change of one product between two times.
+int runMovement(int id, const char* from, const char* to) {
+    long long t0, t1;
+    if (!parseTime(from, &t0) || !parseTime(to, &t1)) {
+        printf("Bad time (use YYYY-MM-DD[ HH:MM[:SS]] or epoch seconds)\n");
+        return 1;
+    }
+    loadInventory(store);
+    long long net = ledgerNetMovement(store, id, t0, t1);
+    printf("Product %d moved %+lld units between %s and %s\n", id, net, from, to);
+    return 0;
+}
+
+// Rebuilds the inventory from the activity log (see Activity Log Replay) and
+// writes it in the text format, for --import-text once it has been checked:
+// --replay-log [--at <time>] [--log file] [--out file].
+int runLogReplay(int argc, char** argv) {
+    const char* logPath = store->logPath;
+    const char* outPath = REPLAYFILE;
+    const char* at = NULL;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--at") == 0 && i + 1 < argc) at = argv[++i];
+        else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) logPath = argv[++i];
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) outPath = argv[++i];
+        else {
+            printf("Bad replay option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    long long untilMs = -1000;
+    if (at != NULL && !parseTime(at, &untilMs)) {
+        printf("Bad time: %s (use YYYY-MM-DD[ HH:MM[:SS]] or epoch seconds)\n", at);
+        return 1;
+    }
+
+    // Whatever still loads supplies the prices and types the log doesn't carry
+    loadInventory(store);
+    ReplayReport report;
+    double start = nowMs();
+    if (!replayActivityLog(store, logPath, untilMs / 1000, &report)) {
+        printf("Error replaying %s\n", logPath);
+        return 1;
+    }
+    double elapsed = (nowMs() - start) / 1000.0;
+    if (!saveTextInventory(store, outPath)) {
+        printf("Error writing %s\n", outPath);
+        return 1;
+    }
+    printf("Replayed %lld lines in %.3f s (%.0f lines/s): %lld stock changes, %d products%s%s\n",
+           report.lines, elapsed, elapsed > 0 ? report.lines / elapsed : 0.0, report.events, report.products,
+           at != NULL ? " as of " : "", at != NULL ? at : "");
+    if (report.later) printf("  %-36s %lld\n", "lines after that time", report.later);
+    if (report.malformed) printf("  %-36s %lld\n", "unrecognized lines", report.malformed);
+    if (report.unknownAdds) printf("  %-36s %lld\n", "adds logged without quantity (0 used)", report.unknownAdds);
+    if (report.partial) printf("  %-36s %lld\n", "products with no starting stock", report.partial);
+    printf("Written to %s (load it with --import-text %s)\n", outPath, outPath);
+    return 0;
+}
+
+// Shows a product's bill of materials: --bom <id>.
+int runBomShow(int id) {
+    loadInventory(store);
+    BomLine lines[256];
+    int count = bomCopy(store, id, lines, 256);
+    Product* p = searchProduct(store, id);
+    if (p == NULL) {
+        printf("Product %d not found\n", id);
+        return 1;
+    }
+    printf("%s (ID: %d), %d units in stock: %s\n", p->name, id, p->quantity,
+           count > 0 ? "one unit takes" : "no bill of materials");
+    for (int i = 0; i < count && i < 256; i++) {
+        Product* c = searchProduct(store, lines[i].component);
+        printf("  %6d x %-40s (ID: %d, %d in stock)\n", lines[i].qtyPer, c ? c->name : "(deleted)",
+               lines[i].component, c ? c->quantity : 0);
+    }
+    return 0;
+}
+
+// --bom-set <parent> <component> <qty>; qty 0 removes the line.
+int runBomSet(int parent, int component, int qtyPer) {
+    loadInventory(store);
+    if (!bomSet(store, parent, component, qtyPer)) return 1;
+    if (qtyPer > 0) printf("Product %d now takes %d x product %d\n", parent, qtyPer, component);
+    else printf("Product %d no longer takes product %d\n", parent, component);
+    return 0;
+}
+
+// Builds units of a product from its components: --produce <id> <qty>.
+int runProduce(int id, int qty) {
+    strcpy(currentUser.username, "production");
+    currentUser.role = STAFF;
+    loadInventory(store);
+    TxnResult r = produceProduct(store, id, qty);
+    journalCommit(store);
+    lotCheckpoint(store);
+    if (r != TXN_OK) {
+        printf("Production failed: %s\n", r == TXN_NOT_FOUND ? "product or bill of materials not found" : txnResultMessage(r));
+        return 1;
+    }
+    printf("Produced %d units of product %d (%d in stock)\n", qty, id, searchProduct(store, id)->quantity);
+    return 0;
+}
+
+// Receives a lot: --receive <id> <qty> <unit cost> [expiry date].
+int runReceive(int id, int qty, const char* cost, const char* expires) {
+    long long expiresMs = 0;
+    if (expires != NULL && !parseTime(expires, &expiresMs)) {
+        printf("Bad expiry date: %s (use YYYY-MM-DD)\n", expires);
+        return 1;
+    }
+    double unitCost = atof(cost);
+    if (unitCost < 0) {
+        printf("Bad unit cost: %s\n", cost);
+        return 1;
+    }
+    strcpy(currentUser.username, "receiving");
+    currentUser.role = STAFF;
+    loadInventory(store);
+    TxnResult r = processPurchaseLot(store, id, qty, (long long)(unitCost * 100.0 + 0.5), expiresMs);
+    journalCommit(store);
+    lotCheckpoint(store);
+    if (r != TXN_OK) {
+        printf("Receipt failed: %s\n", txnResultMessage(r));
+        return 1;
+    }
+    printf("Received %d units of product %d at %.2f each (%d in stock)\n", qty, id, unitCost, searchProduct(store, id)->quantity);
+    return 0;
+}
+
+// Lists a product's open lots in the order they will be used: --lots <id>.
+int runLots(int id) {
+    loadInventory(store);
+    Product* p = searchProduct(store, id);
+    if (p == NULL) {
+        printf("Product %d not found\n", id);
+        return 1;
+    }
+    StockLot lots[256];
+    int untracked;
+    int count = lotCopy(store, id, lots, 256, &untracked);
+    printf("%s (ID: %d), %d units in stock, %d in %d lots\n", p->name, id, p->quantity, p->quantity - untracked, count);
+    if (untracked > 0) printf("  %8d units without a lot, used first, at list price %.2f\n", untracked, p->price);
+    for (int i = 0; i < count && i < 256; i++) {
+        char received[32], expires[32] = "no expiry";
+        time_t t = (time_t)(lots[i].receivedMs / 1000);
+        strftime(received, sizeof(received), "%Y-%m-%d %H:%M", localtime(&t));
+        if (lots[i].expiresMs > 0) {
+            t = (time_t)(lots[i].expiresMs / 1000);
+            strftime(expires, sizeof(expires), "expires %Y-%m-%d", localtime(&t));
+        }
+        printf("  lot %-6d %8d units at %10.2f  received %s, %s\n", lots[i].lot, lots[i].qty,
+               lots[i].unitCostCents / 100.0, received, expires);
+    }
+    if (count > 256) printf("  ... and %d more\n", count - 256);
+    return 0;
+}
+
+// Stock valued at cost: --valuation.
+int runValuation() {
+    loadInventory(store);
+    LotValuation v;
+    lotValuation(store, &v);
+    printf("%-28s %12lld units %16.2f\n", "In lots (at their cost)", v.lotUnits, v.lotValueCents / 100.0);
+    printf("%-28s %12lld units %16.2f\n", "Without a lot (list price)", v.untrackedUnits, v.untrackedValueCents / 100.0);
+    printf("%-28s %12lld units %16.2f\n", "Total", v.lotUnits + v.untrackedUnits, v.valueCents / 100.0);
+    printf("%lld open lots\n", v.lots);
+    return 0;
+}
+
+// Material requirements for the "id,qty" orders in a file: --mrp <file|->.
+// Only items to build or short are listed, up to MRP_REPORT_LINES.
+#define MRP_REPORT_LINES 50
+
+int runMrp(const char* path) {
+    FILE* fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (fp == NULL) {
+        printf("Error reading %s\n", path);
+        return 1;
+    }
+    MrpOrder* orders = NULL;
+    int count = 0, capacity = 0;
+    long long lineNo = 0;
+    char line[128];
+    while (fgets(line, sizeof(line), fp)) {
+        lineNo++;
+        const char* c = line;
+        const char* end = line + strcspn(line, "\r\n");
+        MrpOrder o;
+        if (c == end || *c == '#') continue;
+        if (!parseIntField(&c, end, &o.id) || c >= end || *c++ != ',' || !parseIntField(&c, end, &o.qty) || c != end) {
+            fprintf(stderr, "line %lld: malformed order\n", lineNo);
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            MrpOrder* grown = realloc(orders, (size_t)capacity * sizeof(MrpOrder));
+            if (grown == NULL) break;
+            orders = grown;
+        }
+        orders[count++] = o;
+    }
+    if (fp != stdin) fclose(fp);
+
+    loadInventory(store);
+    MrpPlan plan;
+    double start = nowMs();
+    int ok = mrpPlan(store, orders, count, &plan);
+    double elapsed = nowMs() - start;
+    free(orders);
+    if (!ok) {
+        printf("Out of memory planning %d orders\n", count);
+        return 1;
+    }
+
+    printf("%-6s %-8s %-30s %12s %12s %12s %12s\n", "Level", "ID", "Name", "Needed", "From stock", "Produce", "Short");
+    int shown = 0;
+    for (int i = 0; i < plan.count; i++) {
+        const MrpLine* l = &plan.lines[i];
+        if (l->produce == 0 && l->shortage == 0) continue;
+        if (shown++ == MRP_REPORT_LINES) {
+            printf("... more lines not shown\n");
+            break;
+        }
+        Product* p = searchProduct(store, l->id);
+        printf("%-6d %-8d %-30.30s %12lld %12lld %12lld %12lld\n", l->level, l->id, p ? p->name : "(unknown)",
+               l->gross, l->fromStock, l->produce, l->shortage);
+    }
+    printf("%d orders, %d items over %d levels planned in %.2f ms: %d items short\n",
+           count, plan.count, plan.levels, elapsed, plan.shortItems);
+    int shortItems = plan.shortItems;
+    mrpFree(&plan);
+    return shortItems > 0 ? 2 : 0;
+}
+
+// Concurrency self-check: worker threads hammer a few products with random
+// sales and purchases while another thread keeps adding and deleting
+// products (forcing the store to grow and shift underneath them). Each
+// worker counts what it actually sold and bought; at the end every
+// product's quantity must equal start + bought - sold and never go negative.
+#define STRESS_PRODUCTS 8
+#define STRESS_START_QTY 1000
+
+typedef struct {
+    int ops;
+    unsigned int seed;
+    long long sold[STRESS_PRODUCTS];
+    long long bought[STRESS_PRODUCTS];
+    long long rejected;
+} StressWorker;
+
+atomic_int stressDone;
+
+void* stressWorkerMain(void* arg) {
+    StressWorker* w = arg;
+    unsigned int x = w->seed;
+    for (int i = 0; i < w->ops; i++) {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        int k = (int)(x % STRESS_PRODUCTS);
+        int qty = (int)((x >> 8) % 5) + 1;
+        if ((x >> 16) % 10 < 6) {
+            if (processSale(store, k + 1, qty) == TXN_OK) w->sold[k] += qty;
+            else w->rejected++;
+        } else {
+            if (processPurchase(store, k + 1, qty) == TXN_OK) w->bought[k] += qty;
+        }
+    }
+    return NULL;
+}
+
+void* stressChurnMain(void* arg) {
+    (void)arg;
+    int next = 1000000;
+    while (!atomic_load(&stressDone)) {
+        for (int i = 0; i < 64; i++) addProduct(store, next + i, "churn", 1, 1.0f, RAW_MATERIAL, LOW_STOCK_THRESHOLD);
+        for (int i = 0; i < 64; i++) deleteProduct(store, next + i);
+        next += 64;
+    }
+    return NULL;
+}
+
+int runStressTest(int threads, int opsPerThread) {
+    // Purely in memory: no snapshot, journal or activity log is touched
+    loggerConfig.enabled = 0;
+    releaseInventory(store);
+    for (int k = 0; k < STRESS_PRODUCTS; k++) {
+        char name[20];
+        sprintf(name, "stress-%d", k + 1);
+        addProduct(store, k + 1, name, STRESS_START_QTY, 1.0f, FINISHED_GOOD, LOW_STOCK_THRESHOLD);
+    }
+    alertRebuild(store);
+    statsRebuild(store);
+
+    StressWorker* workers = calloc((size_t)threads, sizeof(StressWorker));
+    pthread_t* tids = malloc((size_t)threads * sizeof(pthread_t));
+    pthread_t churn;
+    atomic_store(&stressDone, 0);
+
+    double start = nowMs();
+    pthread_create(&churn, NULL, stressChurnMain, NULL);
+    for (int t = 0; t < threads; t++) {
+        workers[t].ops = opsPerThread;
+        workers[t].seed = 2463534242U + (unsigned int)t * 7919U;
+        pthread_create(&tids[t], NULL, stressWorkerMain, &workers[t]);
+    }
+    for (int t = 0; t < threads; t++) pthread_join(tids[t], NULL);
+    double elapsed = (nowMs() - start) / 1000.0;
+    atomic_store(&stressDone, 1);
+    pthread_join(churn, NULL);
+
+    int ok = 1;
+    long long rejected = 0;
+    for (int t = 0; t < threads; t++) rejected += workers[t].rejected;
+    for (int k = 0; k < STRESS_PRODUCTS; k++) {
+        long long expected = STRESS_START_QTY;
+        for (int t = 0; t < threads; t++) expected += workers[t].bought[k] - workers[t].sold[k];
+        Product* p = searchProduct(store, k + 1);
+        if (p == NULL || p->quantity != expected || p->quantity < 0) {
+            printf("Product %d: quantity %d, expected %lld\n", k + 1, p ? p->quantity : -1, expected);
+            ok = 0;
+        }
+        // The alert heap must agree with the final quantities
+        if (p != NULL && (idMapGet(&store->alertSlots, p->id) >= 0) != (p->quantity < p->reorderLevel)) {
+            printf("Product %d: low stock alert out of date\n", k + 1);
+            ok = 0;
+        }
+    }
+    if (store->alertSize > STRESS_PRODUCTS) {
+        printf("%d stale low stock alerts\n", store->alertSize - STRESS_PRODUCTS);
+        ok = 0;
+    }
+    // ...and so must the running totals
+    StockStats stats;
+    QtyEntry maxQ, minQ;
+    statsRead(store, &stats, &maxQ, &minQ);
+    long long units = 0, inBuckets = 0;
+    int hi = -1, lo = -1;
+    for (int i = 0; i < store->productCount; i++) {
+        units += store->products[i].quantity;
+        if (hi < 0 || store->products[i].quantity > store->products[hi].quantity) hi = i;
+        if (lo < 0 || store->products[i].quantity < store->products[lo].quantity) lo = i;
+    }
+    for (int b = 0; b < STATS_BUCKETS; b++) inBuckets += stats.histogram[b];
+    if (stats.products != store->productCount || inBuckets != store->productCount ||
+        stats.typeUnits[0] + stats.typeUnits[1] != units ||
+        (hi >= 0 && (maxQ.quantity != store->products[hi].quantity || minQ.quantity != store->products[lo].quantity))) {
+        printf("Stock statistics out of date\n");
+        ok = 0;
+    }
+
+    long long total = (long long)threads * opsPerThread;
+    printf("%d threads x %d ops in %.3f s (%.0f ops/s), %lld sales rejected for stock\n",
+           threads, opsPerThread, elapsed, elapsed > 0 ? total / elapsed : 0.0, rejected);
+    printf("%s: stock %s conserved\n", ok ? "PASS" : "FAIL", ok ? "was" : "was NOT");
+    free(workers);
+    free(tids);
+    return ok ? 0 : 1;
+}
+
+void printUsage(const char* prog) {
+    printf("Usage: %s [command]\n", prog);
+    printf("  (no command)           Start the GUI\n");
+    printf("  --export-text [file]   Write the inventory in text format (default %s)\n", FILENAME);
+    printf("  --import-text [file]   Replace the inventory with a text-format file (default %s)\n", FILENAME);
+    printf("  --export-csv [file|-] [--type raw|finished] [--low-stock] [--ids A-B]\n");
+    printf("                         Write matching products as CSV (default %s, - = stdout)\n", CSVFILE);
+    printf("  --import-csv <file>    Add the products in a CSV file (the format Export CSV writes)\n");
+    printf("  --batch <file|-> [n]   Apply \"id,op,qty\" lines (op: S=sale, P=purchase, U=set stock,\n");
+    printf("                         R=set reorder level, D=delete), committing every n lines (default 10000)\n");
+    printf("  --stress [threads] [ops]  In-memory concurrency check (default 8 threads, 200000 ops each)\n");
+    printf("  --serve [port|path]    Serve the inventory over loopback TCP (default %d) or a Unix socket\n", SERVER_PORT);
+    printf("  --site N [command]     Work on warehouse N (%s/siteN) instead of the current directory\n", WAREHOUSE_DIR);
+    printf("  --warehouses [N]       Stock report across sites 1..N (default: every existing site)\n");
+    printf("  --transfer <from> <to> <id> <qty>  Move stock between two sites\n");
+    printf("  --stock-at <id> <time> Stock of a product at a past time (YYYY-MM-DD[ HH:MM[:SS]])\n");
+    printf("  --movement <id> <from> <to>  Net stock change of a product between two times\n");
+    printf("  --replay-log [--at <time>] [--log file] [--out file]\n");
+    printf("                         Rebuild the inventory from the activity log into %s\n", REPLAYFILE);
+    printf("  --bom <id>             Show what one unit of a product is made of\n");
+    printf("  --bom-set <id> <component> <qty>  Set (qty 0: remove) a bill of materials line\n");
+    printf("  --produce <id> <qty>   Build units of a product from the components in stock\n");
+    printf("  --mrp <file|->         Plan \"id,qty\" orders through the bills of materials and report shortages\n");
+    printf("  --receive <id> <qty> <unit cost> [expiry date]  Receive a purchase as a lot\n");
+    printf("  --lots <id>            Show a product's open lots, in the order they will be used\n");
+    printf("  --valuation            Value the stock at lot cost\n");
+}
+
+int runCommand(int argc, char** argv) {
+    const char* cmd = argv[1];
+    const char* file = argc > 2 ? argv[2] : FILENAME;
+
+    if (strcmp(cmd, "--export-text") == 0) {
+        loadInventory(store);
+        if (!saveTextInventory(store, file)) {
+            printf("Error writing %s\n", file);
+            return 1;
+        }
+        printf("Exported %d products to %s\n", store->productCount, file);
+        return 0;
+    }
+    if (strcmp(cmd, "--import-text") == 0) {
+        if (!loadTextInventory(store, file)) {
+            printf("Error reading %s\n", file);
+            return 1;
+        }
+        // The imported file is the new truth: snapshot it and drop the old journal
+        store->journalLsn = 0;
+        if (!saveInventory(store)) return 1;
+        journalReset(store);
+        printf("Imported %d products from %s\n", store->productCount, file);
+        return 0;
+    }
+
+    if (strcmp(cmd, "--export-csv") == 0) {
+        return runCsvExport(argc, argv);
+    }
+    if (strcmp(cmd, "--import-csv") == 0 && argc > 2) {
+        return runCsvImport(argv[2]);
+    }
+
+    if (strcmp(cmd, "--stress") == 0) {
+        int threads = argc > 2 ? atoi(argv[2]) : 8;
+        int ops = argc > 3 ? atoi(argv[3]) : 200000;
+        return runStressTest(threads > 0 ? threads : 8, ops > 0 ? ops : 200000);
+    }
+    if (strcmp(cmd, "--serve") == 0) {
+        char port[16];
+        sprintf(port, "%d", SERVER_PORT);
+        return runServer(argc > 2 ? argv[2] : port);
+    }
+    if (strcmp(cmd, "--warehouses") == 0) {
+        int count = argc > 2 ? atoi(argv[2]) : warehouseCount(WAREHOUSE_DIR);
+        if (count < 1 || count > MAX_WAREHOUSES) {
+            printf("No warehouses found (use --site N to set one up, at most %d)\n", MAX_WAREHOUSES);
+            return 1;
+        }
+        return runWarehouseReport(count);
+    }
+    if (strcmp(cmd, "--transfer") == 0 && argc > 5) {
+        return runTransfer(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]), atoi(argv[5]));
+    }
+    if (strcmp(cmd, "--stock-at") == 0 && argc > 3) {
+        return runStockAt(atoi(argv[2]), argv[3]);
+    }
+    if (strcmp(cmd, "--movement") == 0 && argc > 4) {
+        return runMovement(atoi(argv[2]), argv[3], argv[4]);
+    }
+    if (strcmp(cmd, "--replay-log") == 0) {
+        return runLogReplay(argc, argv);
+    }
+    if (strcmp(cmd, "--bom") == 0 && argc > 2) {
+        return runBomShow(atoi(argv[2]));
+    }
+    if (strcmp(cmd, "--bom-set") == 0 && argc > 4) {
+        return runBomSet(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]));
+    }
+    if (strcmp(cmd, "--produce") == 0 && argc > 3) {
+        return runProduce(atoi(argv[2]), atoi(argv[3]));
+    }
+    if (strcmp(cmd, "--mrp") == 0 && argc > 2) {
+        return runMrp(argv[2]);
+    }
+    if (strcmp(cmd, "--receive") == 0 && argc > 4) {
+        return runReceive(atoi(argv[2]), atoi(argv[3]), argv[4], argc > 5 ? argv[5] : NULL);
+    }
+    if (strcmp(cmd, "--lots") == 0 && argc > 2) {
+        return runLots(atoi(argv[2]));
+    }
+    if (strcmp(cmd, "--valuation") == 0) {
+        return runValuation();
+    }
+    if (strcmp(cmd, "--batch") == 0 && argc > 2) {
+        int batchSize = argc > 3 ? atoi(argv[3]) : 10000;
+        return runBatchFile(argv[2], batchSize > 0 ? batchSize : 10000);
+    }
+
+    printUsage(argv[0]);
+    return strcmp(cmd, "--help") == 0 ? 0 : 1;
 }
 
 // Main Loop
-int main(void) {
+int main(int argc, char** argv) {
+    // --site N: everything below (GUI or command) works on that warehouse
+    char siteDir[INVENTORY_PATH_LEN];
+    const char* dir = NULL;
+    if (argc > 2 && strcmp(argv[1], "--site") == 0) {
+        int site = atoi(argv[2]);
+        if (site < 1 || site > MAX_WAREHOUSES || !warehousePath(siteDir, WAREHOUSE_DIR, site)) {
+            printf("Error opening site %s\n", argv[2]);
+            return 1;
+        }
+        dir = siteDir;
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+    store = inventoryCreate(dir);
+    if (store == NULL) {
+        printf("Out of memory!\n");
+        return 1;
+    }
+    if (argc > 1) return runCommand(argc, argv);
+
     InitWindow(800, 600, "Inventory Management System");
     SetTargetFPS(60);
-    initializeSystem();
+    metricsStartMs = nowMs();
+    initializeSystem(store);
+    
+    screenCache = LoadRenderTexture(800, 600);
     
     while (!WindowShouldClose()) {
-        BeginDrawing();
-        switch (currentScreen) {
-            case LOGIN_SCREEN: drawLoginScreen(); break;
-            case MAIN_MENU: drawMainMenu(); break;
-            case ADD_PRODUCT: drawAddProductScreen(); break;
-            case VIEW_INVENTORY: drawViewInventoryScreen(); break;
-            case UPDATE_STOCK: drawUpdateStockScreen(); break;
-            case PROCESS_SALE: drawTransactionScreen("PROCESS SALE", processSale, PURPLE); break;
-            case PROCESS_PURCHASE: drawTransactionScreen("PROCESS PURCHASE", processPurchase, GREEN); break;
-            case DELETE_PRODUCT: drawDeleteScreen(); break;
-            case SEARCH_PRODUCT: drawSearchScreen(); break;
-            case VIEW_CHARTS: drawChartsScreen(); break;
-            case ACTIVITY_LOG_SCREEN: drawActivityLogScreen(); break;
-            case EXPORT_CSV_SCREEN: drawExportScreen(); break;
+        long long frameStart = metricStart();
+        int journalWaiting = journalTick(store);
+        if (screenNeedsDraw()) {
+            BeginTextureMode(screenCache);
+            switch (currentScreen) {
+                case LOGIN_SCREEN: drawLoginScreen(); break;
+                case MAIN_MENU: drawMainMenu(); break;
+                case ADD_PRODUCT: drawAddProductScreen(); break;
+                case VIEW_INVENTORY: drawViewInventoryScreen(); break;
+                case UPDATE_STOCK: drawUpdateStockScreen(); break;
+                case PROCESS_SALE: drawTransactionScreen("PROCESS SALE", processSale, PURPLE); break;
+                case PROCESS_PURCHASE: drawTransactionScreen("PROCESS PURCHASE", processPurchase, GREEN); break;
+                case DELETE_PRODUCT: drawDeleteScreen(); break;
+                case SEARCH_PRODUCT: drawSearchScreen(); break;
+                case VIEW_CHARTS: drawChartsScreen(); break;
+                case ACTIVITY_LOG_SCREEN: drawActivityLogScreen(); break;
+                case EXPORT_CSV_SCREEN: drawExportScreen(); break;
+                case METRICS_SCREEN: drawMetricsScreen(); break;
+            }
+            EndTextureMode();
+            screenCacheReady = 1;
+            metricRecord(METRIC_FRAME, frameStart);
         }
+        
+        BeginDrawing();
+        // Render textures are stored upside down, hence the negative height
+        DrawTextureRec(screenCache.texture, (Rectangle){ 0, 0, 800, -600 }, (Vector2){ 0, 0 }, WHITE);
         EndDrawing();
+        screenPace(journalWaiting);
     }
+    UnloadRenderTexture(screenCache);
     CloseWindow();
+    while (atomic_load(&store->exportBusy)) sleepMs(10);   // Let a background export finish
+    loggerShutdown(store);
+    journalCheckpoint(store);
+    if (!metricsDump(METRICSFILE)) printf("Error writing %s\n", METRICSFILE);
     return 0;
 }
\ No newline at end of file